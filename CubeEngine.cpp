@@ -0,0 +1,222 @@
+/*
+ * Command line front end of the native percentage cube engine (CubeEngine.h).
+ *
+ * Loads a delimited fact file and writes the pct_cube rows to stdout, one per
+ * line, in the format of vsql -At -F '|': the fields are separated by the
+ * delimiter, NULL is an empty field and the percentages are printed with 15
+ * significant digits like Vertica prints a FLOAT. So the output can be
+ * compared with the SQL path row for row:
+ *
+ *   vsql -At -F '|' -c 'SELECT * FROM pct_cube' | LC_ALL=C sort > sql.txt
+ *   ./CubeEngine --sorted facts.txt > native.txt
+ *   diff sql.txt native.txt
+ *
+ * Usage: ./CubeEngine [options] file
+ *   --columns=d0,d1,m  the dimension names then the measure name, d0, d1, ...
+ *                      and m (the FactTableBuilder names) by default.
+ *   --delimiter=C      the field delimiter, '|' by default.
+ *   --rowcount=N       only keep the groups whose cnt, and whose total's cnt,
+ *                      are greater than N.
+ *   --sumnull          sum with SUMNULL semantics instead of SUM.
+ *   --canonical        every (total-by set, break-down-by set) pair once.
+ *   --sorted           sort the rows in byte order (LC_ALL=C sort).
+ *
+ * The load and cube statistics go to stderr.
+ */
+#include "CubeEngine.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+using namespace CubeEngine;
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Formats every row as one line, then writes it out or keeps it to be sorted.
+class LineWriter
+{
+public:
+    LineWriter(char delimiter, bool sorted) : m_delimiter(delimiter), m_sorted(sorted), m_rowCount(0) { }
+
+    void row(const std::string &totalBy, const std::string &breakdownBy,
+             const std::vector<const std::string *> &values, double percentage, bool isNull) {
+        m_line.assign(totalBy);
+        m_line.push_back(m_delimiter);
+        m_line.append(breakdownBy);
+        for (size_t i = 0; i < values.size(); i++) {
+            m_line.push_back(m_delimiter);
+            if (values[i] != NULL) {
+                m_line.append(*values[i]);
+            }
+        }
+        m_line.push_back(m_delimiter);
+        if (! isNull) {
+            char buffer[32];
+            m_line.append(buffer, snprintf(buffer, sizeof(buffer), "%.15g", percentage));
+        }
+        m_line.push_back('\n');
+        if (m_sorted) {
+            m_lines.push_back(m_line);
+        }
+        else {
+            fwrite(m_line.data(), 1, m_line.size(), stdout);
+        }
+        m_rowCount++;
+    }
+
+    void finish() {
+        std::sort(m_lines.begin(), m_lines.end());
+        for (size_t i = 0; i < m_lines.size(); i++) {
+            fwrite(m_lines[i].data(), 1, m_lines[i].size(), stdout);
+        }
+        fflush(stdout);
+    }
+
+    size_t getRowCount() const { return m_rowCount; }
+
+private:
+    char m_delimiter;
+    bool m_sorted;
+    size_t m_rowCount;
+    std::string m_line;
+    std::vector<std::string> m_lines;
+};
+
+struct CubeStats {
+    size_t groupCount;
+    double computeSeconds;
+    double writeSeconds;
+};
+
+template <class Key>
+static CubeStats runCube(const FactTable &facts, const Options &options, LineWriter &writer) {
+    CubeStats retval;
+    double start = now();
+    Cube<Key> cube(facts, options);
+    cube.compute();
+    double computed = now();
+    cube.visitRows(writer);
+    writer.finish();
+    retval.groupCount = cube.getGroupCount();
+    retval.computeSeconds = computed - start;
+    retval.writeSeconds = now() - computed;
+    return retval;
+}
+
+static bool readFile(const char *path, std::vector<char> &data) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        perror(path);
+        return false;
+    }
+    char block[1 << 16];
+    size_t length;
+    while ((length = fread(block, 1, sizeof(block), file)) > 0) {
+        data.insert(data.end(), block, block + length);
+    }
+    fclose(file);
+    return true;
+}
+
+static std::vector<std::string> splitNames(const std::string &names) {
+    std::vector<std::string> retval;
+    size_t start = 0;
+    while (true) {
+        size_t comma = names.find(',', start);
+        retval.push_back(names.substr(start, comma == std::string::npos ? std::string::npos : comma - start));
+        if (comma == std::string::npos) {
+            return retval;
+        }
+        start = comma + 1;
+    }
+}
+
+static int usage(const char *program) {
+    fprintf(stderr, "Usage: %s [--columns=d0,d1,m] [--delimiter=C] [--rowcount=N] "
+            "[--sumnull] [--canonical] [--sorted] file\n", program);
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    Options options;
+    std::string columns;
+    char delimiter = '|';
+    bool sorted = false;
+    const char *path = NULL;
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strncmp(arg, "--columns=", 10) == 0) {
+            columns = arg + 10;
+        }
+        else if (strncmp(arg, "--delimiter=", 12) == 0 && strlen(arg + 12) == 1 && arg[12] != '\n') {
+            delimiter = arg[12];
+        }
+        else if (strncmp(arg, "--rowcount=", 11) == 0) {
+            options.rowCount = atoll(arg + 11);
+        }
+        else if (strcmp(arg, "--sumnull") == 0) {
+            options.sumNull = true;
+        }
+        else if (strcmp(arg, "--canonical") == 0) {
+            options.canonical = true;
+        }
+        else if (strcmp(arg, "--sorted") == 0) {
+            sorted = true;
+        }
+        else if (arg[0] != '-' && path == NULL) {
+            path = arg;
+        }
+        else {
+            return usage(argv[0]);
+        }
+    }
+    if (path == NULL) {
+        return usage(argv[0]);
+    }
+
+    std::vector<char> data;
+    if (! readFile(path, data)) {
+        return 1;
+    }
+    const char *begin = data.empty() ? NULL : &data[0];
+    const char *end = begin + data.size();
+    if (columns.empty()) {
+        // As many dimensions as delimiters on the first line.
+        const char *firstLineEnd = static_cast<const char *>(memchr(begin, '\n', data.size()));
+        size_t dimensionCount = std::count(begin, firstLineEnd == NULL ? end : firstLineEnd, delimiter);
+        for (size_t i = 0; i < dimensionCount; i++) {
+            columns += "d" + std::to_string(i) + ",";
+        }
+        columns += "m";
+    }
+    std::vector<std::string> names = splitNames(columns);
+    std::string measureName = names.back();
+    names.pop_back();
+
+    try {
+        double start = now();
+        FactTable facts(names, measureName);
+        facts.load(begin, end, delimiter);
+        double loaded = now();
+        LineWriter writer(delimiter, sorted);
+        CubeStats stats = KeyLayout(facts).getBitCount() <= 64 ? runCube<uint64_t>(facts, options, writer)
+                                                               : runCube<Key128>(facts, options, writer);
+
+        fprintf(stderr, "%zu rows loaded (%zu rejected) in %.3f s\n",
+                facts.getRowCount(), facts.getRejectedCount(), loaded - start);
+        fprintf(stderr, "%zu groups in %zu cuboids computed in %.3f s\n",
+                stats.groupCount, (size_t(1) << names.size()), stats.computeSeconds);
+        fprintf(stderr, "%zu pct_cube rows written in %.3f s\n", writer.getRowCount(), stats.writeSeconds);
+    } catch (std::exception &e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
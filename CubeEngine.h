@@ -0,0 +1,567 @@
+#ifndef CUBE_ENGINE_H
+#define CUBE_ENGINE_H
+
+#include "DelimitedScanner.h"
+#include <algorithm>
+#include <ctype.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * A native, in-memory percentage cube engine, for cubes of fact tables that
+ * fit in the memory of one machine. It does not need Vertica.
+ *
+ *   FactTable - the fact table as columns. The dimensions are dictionary
+ *               encoded, every distinct value gets a dense code, code 0 is
+ *               NULL. Loads the delimited fact files of fact_generator and
+ *               fact_parser: d0_group3|d1_group0|...|42, an empty field is
+ *               NULL.
+ *
+ *   Cube      - hash-aggregates the finest cuboid from the fact table, then
+ *               every other cuboid from its smallest already computed parent,
+ *               and emits the pct_cube rows of every cuboid:
+ *               ("total by", "break down by", d1, ..., dN, m%).
+ *               The codes of a group are packed into one 64 or 128-bit key
+ *               (KeyLayout), so the cuboids are open-addressing tables on
+ *               integers and a roll-up masks the parent keys.
+ *
+ * The rows are the ones the SQL path inserts into pct_cube: one set for every
+ * order of a cuboid's dimensions and every (total by, break down by) split of
+ * it, or every split once with canonical. With a row count threshold, a group
+ * and its total both need cnt > threshold. As in SQL, SUM ignores NULLs and is
+ * NULL when the group has no value, SUMNULL is NULL as soon as the group has
+ * a NULL. A NULL dimension value is a value of its own, like in
+ * PERCENTAGE_CUBE(). The percentage is NULL when the total is 0.
+ */
+namespace CubeEngine {
+
+typedef uint32_t Code;
+
+static const Code NULL_CODE = 0;
+
+// Same rule as Column.getQuotedColumnName() on the Java side.
+inline std::string quoteColumnName(const std::string &name) {
+    for (size_t i = 0; i < name.size(); i++) {
+        char c = name[i];
+        if (! (isalnum(static_cast<unsigned char>(c)) || c == '_')) {
+            return "\"" + name + "\"";
+        }
+    }
+    return name;
+}
+
+// An open-addressing table of codes, the values are looked up in place without copying them first.
+class Dictionary
+{
+public:
+    Dictionary() : m_values(1), m_slots(16, NULL_CODE) { }
+
+    Code encode(const char *begin, const char *end) {
+        if (begin == end) {
+            return NULL_CODE;
+        }
+        size_t length = end - begin;
+        size_t mask = m_slots.size() - 1;
+        for (size_t slot = hash(begin, length) & mask; ; slot = (slot + 1) & mask) {
+            Code code = m_slots[slot];
+            if (code == NULL_CODE) {
+                code = m_values.size();
+                m_values.push_back(std::string(begin, end));
+                m_slots[slot] = code;
+                if (m_values.size() * 2 > m_slots.size()) {
+                    grow();
+                }
+                return code;
+            }
+            const std::string &value = m_values[code];
+            if (value.size() == length && memcmp(value.data(), begin, length) == 0) {
+                return code;
+            }
+        }
+    }
+
+    const std::string &decode(Code code) const { return m_values[code]; }
+
+    // The number of codes, NULL included.
+    size_t size() const { return m_values.size(); }
+
+private:
+    // FNV-1a.
+    static uint64_t hash(const char *pos, size_t length) {
+        uint64_t retval = 14695981039346656037ULL;
+        for (size_t i = 0; i < length; i++) {
+            retval = (retval ^ static_cast<unsigned char>(pos[i])) * 1099511628211ULL;
+        }
+        return retval ^ (retval >> 32);
+    }
+
+    void grow() {
+        std::vector<Code> slots(m_slots.size() * 2, NULL_CODE);
+        size_t mask = slots.size() - 1;
+        for (Code code = 1; code < m_values.size(); code++) {
+            size_t slot = hash(m_values[code].data(), m_values[code].size()) & mask;
+            while (slots[slot] != NULL_CODE) {
+                slot = (slot + 1) & mask;
+            }
+            slots[slot] = code;
+        }
+        m_slots.swap(slots);
+    }
+
+    std::vector<std::string> m_values;
+    std::vector<Code> m_slots;
+};
+
+class FactTable
+{
+public:
+    FactTable(const std::vector<std::string> &dimensionNames, const std::string &measureName)
+        : m_dimensionNames(dimensionNames), m_measureName(measureName),
+          m_dictionaries(dimensionNames.size()), m_codes(dimensionNames.size()), m_rejectedCount(0) { }
+
+    // Appends the records of [begin, end), one per line. Like COPY, a record with the wrong
+    // number of fields or a measure that is not a number is rejected and counted.
+    void load(const char *begin, const char *end, char delimiter) {
+        DelimitedScanner::FindEitherFunction findEither = DelimitedScanner::getFindEither();
+        size_t dimensionCount = m_dimensionNames.size();
+        std::vector<Code> codes(dimensionCount);
+        const char *pos = begin;
+        while (pos < end) {
+            const char *record = pos;
+            bool rejected = false;
+            for (size_t i = 0; i < dimensionCount; i++) {
+                const char *fieldEnd = findEither(pos, end, delimiter, '\n');
+                if (fieldEnd == end || *fieldEnd == '\n') {
+                    rejected = true;
+                    break;
+                }
+                codes[i] = m_dictionaries[i].encode(pos, fieldEnd);
+                pos = fieldEnd + 1;
+            }
+            const char *recordEnd = rejected ? NULL : findEither(pos, end, delimiter, '\n');
+            if (rejected || (recordEnd < end && *recordEnd != '\n')) {
+                recordEnd = static_cast<const char *>(memchr(record, '\n', end - record));
+                pos = recordEnd == NULL ? end : recordEnd + 1;
+                m_rejectedCount++;
+                continue;
+            }
+            const char *valueEnd = recordEnd;
+            if (valueEnd > pos && valueEnd[-1] == '\r') {
+                valueEnd--;
+            }
+            double measure = 0;
+            bool isNull = pos == valueEnd;
+            if (! isNull && ! parseDouble(pos, valueEnd, measure)) {
+                pos = recordEnd + (recordEnd < end ? 1 : 0);
+                m_rejectedCount++;
+                continue;
+            }
+            for (size_t i = 0; i < dimensionCount; i++) {
+                m_codes[i].push_back(codes[i]);
+            }
+            m_measures.push_back(measure);
+            m_measureNulls.push_back(isNull ? 1 : 0);
+            pos = recordEnd + (recordEnd < end ? 1 : 0);
+        }
+    }
+
+    size_t getDimensionCount() const { return m_dimensionNames.size(); }
+    const std::string &getDimensionName(size_t i) const { return m_dimensionNames[i]; }
+    const std::string &getMeasureName() const { return m_measureName; }
+    const Dictionary &getDictionary(size_t i) const { return m_dictionaries[i]; }
+    const std::vector<Code> &getCodes(size_t i) const { return m_codes[i]; }
+    const std::vector<double> &getMeasures() const { return m_measures; }
+    const std::vector<char> &getMeasureNulls() const { return m_measureNulls; }
+    size_t getRowCount() const { return m_measures.size(); }
+    size_t getRejectedCount() const { return m_rejectedCount; }
+
+private:
+    // strtod() needs a terminated string, copy the field onto the stack.
+    static bool parseDouble(const char *begin, const char *end, double &value) {
+        char buffer[64];
+        size_t length = end - begin;
+        if (length >= sizeof(buffer)) {
+            return false;
+        }
+        memcpy(buffer, begin, length);
+        buffer[length] = '\0';
+        char *parsedEnd;
+        errno = 0;
+        value = strtod(buffer, &parsedEnd);
+        return parsedEnd == buffer + length && errno != ERANGE;
+    }
+
+    std::vector<std::string> m_dimensionNames;
+    std::string m_measureName;
+    std::vector<Dictionary> m_dictionaries;
+    std::vector<std::vector<Code> > m_codes;
+    std::vector<double> m_measures;
+    std::vector<char> m_measureNulls;
+    size_t m_rejectedCount;
+};
+
+// The aggregate of one group. The sum only covers the values, count covers the rows.
+struct Cell {
+    Cell() : count(0), valueCount(0), sum(0) { }
+
+    void add(const Cell &other) {
+        count += other.count;
+        valueCount += other.valueCount;
+        sum += other.sum;
+    }
+
+    // SUM or SUMNULL of the group, returns false if it is NULL.
+    bool getSum(bool sumNull, double &value) const {
+        value = sum;
+        return sumNull ? valueCount == count : valueCount > 0;
+    }
+
+    int64_t count;
+    int64_t valueCount;
+    double sum;
+};
+
+// A 128-bit key, for when the codes of all the dimensions do not fit in 64 bits.
+typedef unsigned __int128 Key128;
+
+// The fmix64 finalizer of MurmurHash3, masked keys have runs of zero bits.
+inline uint64_t hashKey(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+inline uint64_t hashKey(Key128 key) {
+    return hashKey(static_cast<uint64_t>(key) ^ hashKey(static_cast<uint64_t>(key >> 64)));
+}
+
+/*
+ * Where the code of every dimension goes in a group key: dimension i takes
+ * the bits [offset, offset + width) with the fewest bits that hold all of its
+ * codes, NULL included. A cuboid keeps the bits of its dimensions and zeroes
+ * the others, so the key of a group in a coarser cuboid is the key in the
+ * finer one with more bits masked out.
+ */
+class KeyLayout
+{
+public:
+    explicit KeyLayout(const FactTable &facts) : m_bitCount(0) {
+        for (size_t i = 0; i < facts.getDimensionCount(); i++) {
+            int width = 1;
+            while ((uint64_t(1) << width) < facts.getDictionary(i).size()) {
+                width++;
+            }
+            m_offsets.push_back(m_bitCount);
+            m_widths.push_back(width);
+            m_bitCount += width;
+        }
+    }
+
+    // The key width needed by all the dimensions together.
+    int getBitCount() const { return m_bitCount; }
+
+    template <class Key>
+    Key getCodeBits(size_t dimension, Code code) const { return static_cast<Key>(code) << m_offsets[dimension]; }
+
+    template <class Key>
+    Code getCode(size_t dimension, Key key) const {
+        return static_cast<Code>(key >> m_offsets[dimension]) & ((Code(1) << m_widths[dimension]) - 1);
+    }
+
+    // The bits of the dimensions in the cuboid mask.
+    template <class Key>
+    Key getKeyMask(uint64_t cuboidMask) const {
+        Key retval = 0;
+        for (size_t i = 0; i < m_offsets.size(); i++) {
+            if (cuboidMask & (uint64_t(1) << i)) {
+                retval |= ((Key(1) << m_widths[i]) - 1) << m_offsets[i];
+            }
+        }
+        return retval;
+    }
+
+private:
+    std::vector<int> m_offsets;
+    std::vector<int> m_widths;
+    int m_bitCount;
+};
+
+// One cuboid: its groups in an open-addressing table on the packed keys, linear probing.
+template <class Key>
+struct Cuboid {
+    Cuboid() : mask(0), keyMask(0), slots(16, 0) { }
+
+    // Sizes the table for groupCount groups without growing.
+    void reserve(size_t groupCount) {
+        size_t slotCount = 16;
+        while (slotCount < groupCount * 2) {
+            slotCount *= 2;
+        }
+        if (slotCount > slots.size()) {
+            rehash(slotCount);
+        }
+    }
+
+    size_t findOrAdd(Key key) {
+        size_t slotMask = slots.size() - 1;
+        for (size_t slot = hashKey(key) & slotMask; ; slot = (slot + 1) & slotMask) {
+            uint32_t group = slots[slot];
+            if (group == 0) {
+                keys.push_back(key);
+                cells.push_back(Cell());
+                slots[slot] = cells.size();
+                if (cells.size() * 2 > slots.size()) {
+                    rehash(slots.size() * 2);
+                }
+                return cells.size() - 1;
+            }
+            if (keys[group - 1] == key) {
+                return group - 1;
+            }
+        }
+    }
+
+    const Cell &find(Key key) const {
+        size_t slotMask = slots.size() - 1;
+        size_t slot = hashKey(key) & slotMask;
+        while (keys[slots[slot] - 1] != key) {
+            slot = (slot + 1) & slotMask;
+        }
+        return cells[slots[slot] - 1];
+    }
+
+    void rehash(size_t slotCount) {
+        slots.assign(slotCount, 0);
+        size_t slotMask = slotCount - 1;
+        for (size_t g = 0; g < keys.size(); g++) {
+            size_t slot = hashKey(keys[g]) & slotMask;
+            while (slots[slot] != 0) {
+                slot = (slot + 1) & slotMask;
+            }
+            slots[slot] = g + 1;
+        }
+    }
+
+    uint64_t mask;
+    Key keyMask;
+    std::vector<size_t> dimensions;
+    std::vector<Key> keys;
+    std::vector<Cell> cells;
+    // Group index + 1, 0 is an empty slot.
+    std::vector<uint32_t> slots;
+};
+
+struct Options {
+    Options() : rowCount(0), sumNull(false), canonical(false) { }
+    int64_t rowCount;
+    bool sumNull;
+    bool canonical;
+};
+
+/*
+ * Key is uint64_t or Key128, wide enough for KeyLayout::getBitCount():
+ *
+ *   if (KeyLayout(facts).getBitCount() <= 64) Cube<uint64_t> ... else Cube<Key128> ...
+ */
+template <class Key>
+class Cube
+{
+public:
+    // Every cuboid is kept in memory, 2^N of them.
+    static const size_t MAX_DIMENSIONS = 30;
+
+    Cube(const FactTable &facts, const Options &options)
+        : m_facts(facts), m_options(options), m_layout(facts) {
+        if (facts.getDimensionCount() < 1 || facts.getDimensionCount() > MAX_DIMENSIONS) {
+            throw std::runtime_error("The cube engine expects 1 to 30 dimensions");
+        }
+        if (m_layout.getBitCount() > static_cast<int>(sizeof(Key) * 8)) {
+            throw std::runtime_error("The dimension codes need " + std::to_string(m_layout.getBitCount()) +
+                                     " bits, more than the group key holds");
+        }
+        for (size_t i = 0; i < facts.getDimensionCount(); i++) {
+            m_dimensionNames.push_back(quoteColumnName(facts.getDimensionName(i)));
+        }
+    }
+
+    // Aggregates every cuboid, the finest one from the facts, the others from their smallest parent.
+    void compute() {
+        size_t dimensionCount = m_facts.getDimensionCount();
+        uint64_t fullMask = (uint64_t(1) << dimensionCount) - 1;
+        m_cuboids.assign(fullMask + 1, Cuboid<Key>());
+        for (uint64_t mask = 0; mask <= fullMask; mask++) {
+            m_cuboids[mask].mask = mask;
+            m_cuboids[mask].keyMask = m_layout.template getKeyMask<Key>(mask);
+            for (size_t i = 0; i < dimensionCount; i++) {
+                if (mask & (uint64_t(1) << i)) {
+                    m_cuboids[mask].dimensions.push_back(i);
+                }
+            }
+        }
+
+        // The keys are packed a column at a time, a block of rows at a time.
+        Cuboid<Key> &finest = m_cuboids[fullMask];
+        const std::vector<double> &measures = m_facts.getMeasures();
+        const std::vector<char> &measureNulls = m_facts.getMeasureNulls();
+        size_t rowCount = m_facts.getRowCount();
+        Key keys[BLOCK_ROWS];
+        for (size_t start = 0; start < rowCount; start += BLOCK_ROWS) {
+            size_t count = std::min<size_t>(BLOCK_ROWS, rowCount - start);
+            std::fill(keys, keys + count, Key(0));
+            for (size_t i = 0; i < dimensionCount; i++) {
+                const Code *codes = &m_facts.getCodes(i)[start];
+                for (size_t r = 0; r < count; r++) {
+                    keys[r] |= m_layout.template getCodeBits<Key>(i, codes[r]);
+                }
+            }
+            for (size_t r = 0; r < count; r++) {
+                Cell &cell = finest.cells[finest.findOrAdd(keys[r])];
+                cell.count++;
+                if (! measureNulls[start + r]) {
+                    cell.valueCount++;
+                    cell.sum += measures[start + r];
+                }
+            }
+        }
+
+        // Coarser cuboids have smaller masks, their parents are done by the time they are reached.
+        for (uint64_t mask = fullMask; mask-- > 0; ) {
+            const Cuboid<Key> *parent = NULL;
+            for (size_t i = 0; i < dimensionCount; i++) {
+                uint64_t parentMask = mask | (uint64_t(1) << i);
+                if (parentMask != mask &&
+                        (parent == NULL || m_cuboids[parentMask].cells.size() < parent->cells.size())) {
+                    parent = &m_cuboids[parentMask];
+                }
+            }
+            rollUp(*parent, m_cuboids[mask]);
+        }
+    }
+
+    size_t getGroupCount() const {
+        size_t retval = 0;
+        for (size_t c = 0; c < m_cuboids.size(); c++) {
+            retval += m_cuboids[c].cells.size();
+        }
+        return retval;
+    }
+
+    /*
+     * Calls visitor.row(totalBy, breakDownBy, values, percentage, isNull) for every pct_cube row.
+     * values holds one pointer per dimension, NULL when the dimension is "ALL" or the value is NULL.
+     */
+    template <class Visitor>
+    void visitRows(Visitor &visitor) const {
+        for (uint64_t mask = 1; mask < m_cuboids.size(); mask++) {
+            const Cuboid<Key> &cuboid = m_cuboids[mask];
+            const std::vector<size_t> &selected = cuboid.dimensions;
+            if (m_options.canonical) {
+                // Every (total-by set, break-down-by set) pair once, both lists in the dimension order.
+                uint64_t totalByMask = mask;
+                do {
+                    totalByMask = (totalByMask - 1) & mask;
+                    std::vector<size_t> order;
+                    for (size_t i = 0; i < selected.size(); i++) {
+                        if (totalByMask & (uint64_t(1) << selected[i])) {
+                            order.push_back(selected[i]);
+                        }
+                    }
+                    size_t totalByKeyCount = order.size();
+                    for (size_t i = 0; i < selected.size(); i++) {
+                        if (! (totalByMask & (uint64_t(1) << selected[i]))) {
+                            order.push_back(selected[i]);
+                        }
+                    }
+                    visitSplit(visitor, cuboid, m_cuboids[totalByMask],
+                               joinNames(order, 0, totalByKeyCount),
+                               joinNames(order, totalByKeyCount, order.size()));
+                } while (totalByMask != 0);
+                continue;
+            }
+            // Exhaust all the possible orders of the selected dimensions, and every split of
+            // each order into (total by, break down by).
+            std::vector<size_t> permutation(selected);
+            do {
+                uint64_t totalByMask = 0;
+                for (size_t totalByKeyCount = 0; totalByKeyCount < selected.size(); totalByKeyCount++) {
+                    if (totalByKeyCount > 0) {
+                        totalByMask |= uint64_t(1) << permutation[totalByKeyCount - 1];
+                    }
+                    visitSplit(visitor, cuboid, m_cuboids[totalByMask],
+                               joinNames(permutation, 0, totalByKeyCount),
+                               joinNames(permutation, totalByKeyCount, permutation.size()));
+                }
+            } while (std::next_permutation(permutation.begin(), permutation.end()));
+        }
+    }
+
+private:
+    static const size_t BLOCK_ROWS = 1024;
+
+    // A child key is the parent key with the child's "ALL" dimensions masked out.
+    static void rollUp(const Cuboid<Key> &parent, Cuboid<Key> &child) {
+        child.reserve(parent.cells.size());
+        for (size_t g = 0; g < parent.cells.size(); g++) {
+            child.cells[child.findOrAdd(parent.keys[g] & child.keyMask)].add(parent.cells[g]);
+        }
+    }
+
+    std::string joinNames(const std::vector<size_t> &dimensions, size_t first, size_t last) const {
+        std::string names;
+        for (size_t i = first; i < last; i++) {
+            if (i > first) {
+                names.append(",");
+            }
+            names.append(m_dimensionNames[dimensions[i]]);
+        }
+        return names;
+    }
+
+    // The rows of the cuboid's groups for one (total by, break down by) split.
+    template <class Visitor>
+    void visitSplit(Visitor &visitor, const Cuboid<Key> &cuboid, const Cuboid<Key> &totals,
+                    const std::string &totalBy, const std::string &breakdownBy) const {
+        std::vector<const std::string *> values(m_facts.getDimensionCount(), NULL);
+        for (size_t g = 0; g < cuboid.cells.size(); g++) {
+            const Cell &cell = cuboid.cells[g];
+            Key key = cuboid.keys[g];
+            const Cell &total = totals.find(key & totals.keyMask);
+            if (m_options.rowCount > 0 && (cell.count <= m_options.rowCount || total.count <= m_options.rowCount)) {
+                continue;
+            }
+            for (size_t i = 0; i < cuboid.dimensions.size(); i++) {
+                size_t dimension = cuboid.dimensions[i];
+                Code code = m_layout.getCode(dimension, key);
+                values[dimension] = code == NULL_CODE ? NULL : &m_facts.getDictionary(dimension).decode(code);
+            }
+            double sum, totalSum;
+            bool hasSum = cell.getSum(m_options.sumNull, sum);
+            bool hasTotal = total.getSum(m_options.sumNull, totalSum);
+            if (hasSum && hasTotal && totalSum != 0) {
+                visitor.row(totalBy, breakdownBy, values, sum / totalSum, false);
+            }
+            else {
+                visitor.row(totalBy, breakdownBy, values, 0, true);
+            }
+        }
+    }
+
+    const FactTable &m_facts;
+    Options m_options;
+    KeyLayout m_layout;
+    std::vector<std::string> m_dimensionNames;
+    std::vector<Cuboid<Key> > m_cuboids;
+};
+
+} // namespace CubeEngine
+
+#endif
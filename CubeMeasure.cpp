@@ -0,0 +1,161 @@
+#include "Vertica.h"
+#include "SumWithNull.h"
+#include <stdio.h>
+
+using namespace Vertica;
+
+/*
+ * CUBE_MEASURE(m) computes COUNT(*) and SUMNULL(m) with a single aggregate
+ * state, so GROUP BY CUBE(...) only keeps and updates one state per group.
+ *
+ * The intermediate state is (count, sum). A NULL input poisons the sum the
+ * same way SUMNULL does (sum becomes vfloat_null) while the count keeps going.
+ *
+ * A Vertica aggregate can only return one value, so terminate() packs both
+ * results into a VARCHAR "<count>|<sum>", where <sum> is empty if the sum is
+ * NULL and is printed with 17 significant digits so it parses back to the
+ * exact same FLOAT. PercentageCubeAggregateAction splits it with SPLIT_PART().
+ */
+class CubeMeasure : public AggregateFunction
+{
+    virtual void initAggregate(ServerInterface &srvInterface,
+                               IntermediateAggs &aggs) {
+        try {
+            aggs.getIntRef(0) = 0;
+            aggs.getFloatRef(1) = 0;
+        } catch (std::exception &e) {
+            // Standard exception. Quit.
+            vt_report_error(0, "Exception while initializing intermediate aggregates: [%s]", e.what());
+        }
+    }
+
+    void aggregate(ServerInterface &srvInterface,
+                   BlockReader &argReader,
+                   IntermediateAggs &aggs)
+    {
+        try {
+            vint &count = aggs.getIntRef(0);
+            vfloat &sum = aggs.getFloatRef(1);
+            do {
+                count++;
+                if (! vfloatIsNull(sum)) {
+                    const vfloat &input = argReader.getFloatRef(0);
+                    sum = vfloatIsNull(input) ? vfloat_null : sum + input;
+                }
+            } while (argReader.next());
+        } catch (std::exception &e) {
+            // Standard exception. Quit.
+            vt_report_error(0, "Exception while processing aggregate: [%s]", e.what());
+        }
+    }
+
+    void aggregateBlock(ServerInterface &srvInterface,
+                        BlockReader &argReader,
+                        int rowCount,
+                        IntermediateAggs &aggs)
+    {
+        try {
+            aggs.getIntRef(0) += rowCount;
+            vfloat &sum = aggs.getFloatRef(1);
+            if (vfloatIsNull(sum)) {
+                return;
+            }
+            if (! SumWithNullKernel::sumBlock(argReader.getFloatPtr(0), rowCount, sum)) {
+                sum = vfloat_null;
+            }
+        } catch (std::exception &e) {
+            // Standard exception. Quit.
+            vt_report_error(0, "Exception while processing aggregate: [%s]", e.what());
+        }
+    }
+
+    virtual void combine(ServerInterface &srvInterface,
+                         IntermediateAggs &aggs,
+                         MultipleIntermediateAggs &aggsOther)
+    {
+        try {
+            vint &myCount = aggs.getIntRef(0);
+            vfloat &mySum = aggs.getFloatRef(1);
+
+            // Combine all the other intermediate aggregates
+            do {
+                myCount += aggsOther.getIntRef(0);
+                if (! vfloatIsNull(mySum)) {
+                    const vfloat &otherSum = aggsOther.getFloatRef(1);
+                    mySum = vfloatIsNull(otherSum) ? vfloat_null : mySum + otherSum;
+                }
+            } while (aggsOther.next());
+        } catch (std::exception &e) {
+            // Standard exception. Quit.
+            vt_report_error(0, "Exception while combining intermediate aggregates: [%s]", e.what());
+        }
+    }
+
+    virtual void terminate(ServerInterface &srvInterface,
+                           BlockWriter &resWriter,
+                           IntermediateAggs &aggs)
+    {
+        try {
+            const vint &count = aggs.getIntRef(0);
+            const vfloat &sum = aggs.getFloatRef(1);
+            char buffer[OUTPUT_LENGTH + 1];
+            int length;
+            if (vfloatIsNull(sum)) {
+                length = snprintf(buffer, sizeof(buffer), "%lld|", count);
+            }
+            else {
+                length = snprintf(buffer, sizeof(buffer), "%lld|%.17g", count, sum);
+            }
+            resWriter.getStringRef().copy(buffer, length);
+        } catch (std::exception &e) {
+            // Standard exception. Quit.
+            vt_report_error(0, "Exception while computing aggregate output: [%s]", e.what());
+        }
+    }
+
+    InlineBlockAggregate()
+
+public:
+    // 20 digits of count, the separator and up to 24 characters of %.17g.
+    static const int OUTPUT_LENGTH = 64;
+};
+
+
+/*
+ * This class provides the meta-data associated with the aggregate function
+ * shown above, as well as a way of instantiating objects of the class.
+ */
+class CubeMeasureFactory : public AggregateFunctionFactory
+{
+    virtual void getPrototype(ServerInterface &srvInterface,
+                              ColumnTypes &argTypes,
+                              ColumnTypes &returnType)
+    {
+        argTypes.addFloat();
+        returnType.addVarchar();
+    }
+
+    // Provide return type length/scale/precision information (given the input
+    // type length/scale/precision), as well as column names
+    virtual void getReturnType(ServerInterface &srvInterface,
+                               const SizedColumnTypes &inputTypes,
+                               SizedColumnTypes &outputTypes)
+    {
+        outputTypes.addVarchar(CubeMeasure::OUTPUT_LENGTH);
+    }
+
+    virtual void getIntermediateTypes(ServerInterface &srvInterface,
+                                      const SizedColumnTypes &inputTypes,
+                                      SizedColumnTypes &intermediateTypeMetaData)
+    {
+        intermediateTypeMetaData.addInt("cnt");
+        intermediateTypeMetaData.addFloat("sum");
+    }
+
+    // Create an instance of the AggregateFunction
+    virtual AggregateFunction *createAggregateFunction(ServerInterface &srvInterface)
+    { return vt_createFuncObject<CubeMeasure>(srvInterface.allocator); }
+
+};
+
+RegisterFactory(CubeMeasureFactory);
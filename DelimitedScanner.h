@@ -0,0 +1,89 @@
+#ifndef DELIMITED_SCANNER_H
+#define DELIMITED_SCANNER_H
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define DELIMITED_SCANNER_HAS_SIMD 1
+#endif
+
+/*
+ * Byte scanners for delimited text.
+ *
+ * findEither() returns the first byte of [pos, end) that is either a or b
+ * (a field delimiter or the record terminator), or end if there is none.
+ * The SIMD versions compare 16 (SSE2) or 32 (AVX2) bytes at a time and
+ * finish the tail with the scalar loop, they never read past end.
+ */
+namespace DelimitedScanner {
+
+typedef const char *(*FindEitherFunction)(const char *pos, const char *end, char a, char b);
+
+inline const char *findEitherScalar(const char *pos, const char *end, char a, char b) {
+    for (; pos < end; pos++) {
+        if (*pos == a || *pos == b) {
+            return pos;
+        }
+    }
+    return end;
+}
+
+#ifdef DELIMITED_SCANNER_HAS_SIMD
+// SSE2 is part of x86-64, no runtime check is needed.
+inline const char *findEitherSSE2(const char *pos, const char *end, char a, char b) {
+    const __m128i va = _mm_set1_epi8(a);
+    const __m128i vb = _mm_set1_epi8(b);
+    for (; end - pos >= 16; pos += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pos));
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, va), _mm_cmpeq_epi8(chunk, vb)));
+        if (mask != 0) {
+            return pos + __builtin_ctz(mask);
+        }
+    }
+    return findEitherScalar(pos, end, a, b);
+}
+
+__attribute__((target("avx2")))
+inline const char *findEitherAVX2(const char *pos, const char *end, char a, char b) {
+    const __m256i va = _mm256_set1_epi8(a);
+    const __m256i vb = _mm256_set1_epi8(b);
+    for (; end - pos >= 32; pos += 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pos));
+        uint32_t mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, va),
+                                                             _mm256_cmpeq_epi8(chunk, vb)));
+        if (mask != 0) {
+            return pos + __builtin_ctz(mask);
+        }
+    }
+    return findEitherSSE2(pos, end, a, b);
+}
+#endif
+
+inline bool hasAVX2() {
+#ifdef DELIMITED_SCANNER_HAS_SIMD
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+// Picks the widest scanner the CPU supports.
+inline FindEitherFunction getFindEither() {
+#ifdef DELIMITED_SCANNER_HAS_SIMD
+    return hasAVX2() ? findEitherAVX2 : findEitherSSE2;
+#else
+    return findEitherScalar;
+#endif
+}
+
+// Returns the last c in [begin, end), or NULL if there is none.
+inline const char *findLast(const char *begin, const char *end, char c) {
+    return static_cast<const char *>(memrchr(begin, c, end - begin));
+}
+
+} // namespace DelimitedScanner
+
+#endif
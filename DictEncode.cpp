@@ -0,0 +1,100 @@
+#include "Vertica.h"
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace Vertica;
+
+/*
+ * INSERT INTO dict_d
+ *     SELECT DICT_ENCODE(code, value) OVER ()
+ *     FROM (SELECT code, value FROM dict_d UNION ALL SELECT DISTINCT NULL, d FROM t) s;
+ *
+ * Extends the dictionary table of a VARCHAR dimension with the values it
+ * does not have a code for yet. The input is the current dictionary (the
+ * rows with a code) and the candidate values (the rows with a NULL code), in
+ * any order. The new values get the dense codes that follow the
+ * largest code of the dictionary, in byte order so that the same input
+ * always gives the same codes. Only the new (code, value) pairs are emitted,
+ * the codes already handed out never change, so tables encoded earlier stay
+ * valid. NULL values are skipped, they are encoded as a NULL code.
+ *
+ * The whole dictionary is one partition (OVER ()), it only holds the
+ * distinct values of one dimension.
+ */
+class DictEncode : public TransformFunction
+{
+    virtual void processPartition(ServerInterface &srvInterface,
+                                  PartitionReader &inputReader,
+                                  PartitionWriter &outputWriter)
+    {
+        try {
+            std::set<std::string> known;
+            std::vector<std::string> candidates;
+            vint maxCode = 0;
+            do {
+                const VString &value = inputReader.getStringRef(1);
+                if (value.isNull()) {
+                    continue;
+                }
+                const vint &code = inputReader.getIntRef(0);
+                if (code == vint_null) {
+                    candidates.push_back(value.str());
+                }
+                else {
+                    known.insert(value.str());
+                    maxCode = std::max(maxCode, code);
+                }
+            } while (inputReader.next());
+
+            std::sort(candidates.begin(), candidates.end());
+            for (size_t i = 0; i < candidates.size(); i++) {
+                const std::string &value = candidates[i];
+                if ((i > 0 && candidates[i - 1] == value) || known.count(value) > 0) {
+                    continue;
+                }
+                outputWriter.setInt(0, ++maxCode);
+                outputWriter.getStringRef(1).copy(value);
+                outputWriter.next();
+            }
+        } catch (std::exception &e) {
+            // Standard exception. Quit.
+            vt_report_error(0, "Exception while processing partition: [%s]", e.what());
+        }
+    }
+};
+
+
+/*
+ * This class provides the meta-data associated with the transform function
+ * shown above, as well as a way of instantiating objects of the class.
+ */
+class DictEncodeFactory : public TransformFunctionFactory
+{
+    virtual void getPrototype(ServerInterface &srvInterface,
+                              ColumnTypes &argTypes,
+                              ColumnTypes &returnType)
+    {
+        argTypes.addInt();
+        argTypes.addVarchar();
+        returnType.addInt();
+        returnType.addVarchar();
+    }
+
+    // The values keep the length of the dictionary's value column.
+    virtual void getReturnType(ServerInterface &srvInterface,
+                               const SizedColumnTypes &inputTypes,
+                               SizedColumnTypes &outputTypes)
+    {
+        outputTypes.addInt("code");
+        outputTypes.addVarchar(inputTypes.getColumnType(1).getStringLength(), "value");
+    }
+
+    // Create an instance of the TransformFunction
+    virtual TransformFunction *createTransformFunction(ServerInterface &srvInterface)
+    { return vt_createFuncObject<DictEncode>(srvInterface.allocator); }
+
+};
+
+RegisterFactory(DictEncodeFactory);
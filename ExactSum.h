@@ -0,0 +1,152 @@
+#ifndef EXACT_SUM_H
+#define EXACT_SUM_H
+
+#include "Vertica.h"
+#include <math.h>
+#include <string.h>
+
+using namespace Vertica;
+
+/*
+ * An exact accumulator of FLOAT values, for the aggregates whose result must
+ * not depend on the order the server combines their partial states in.
+ *
+ * Every finite double is an integer multiple of 2^-1074, the smallest
+ * subnormal. The accumulator holds the exact sum in those units, as a two's
+ * complement integer in the words of a NUMERIC(PRECISION, 0): most
+ * significant word first, the layout Basics::BigInt works on. The largest
+ * double is below 2^1024, so the sum of 2^63 of them needs 1024 + 1074 + 63
+ * bits plus a sign bit, the WORD_COUNT words hold 2240. Adding is exact, so it
+ * is associative and commutative, and only the final conversion to a double
+ * rounds, to nearest.
+ *
+ * Infinities and NaNs cannot be held in the integer, they are recorded in a
+ * separate set of flags and win over the finite sum like they do in IEEE
+ * arithmetic.
+ */
+namespace ExactSum {
+
+// A NUMERIC of PRECISION digits takes WORD_COUNT words (getNumericWordCount()).
+static const int PRECISION = 660;
+static const int WORD_COUNT = 35;
+// The exponent of the unit of the accumulator, 2^-1074.
+static const int UNIT_EXPONENT = -1074;
+
+enum Flags {
+    SEEN_NAN = 1,
+    SEEN_POSITIVE_INFINITY = 2,
+    SEEN_NEGATIVE_INFINITY = 4
+};
+
+// Adds one non-NULL value to the words.
+inline void add(uint64 *words, vint &flags, vfloat value) {
+    uint64 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    bool negative = (bits >> 63) != 0;
+    int exponent = static_cast<int>((bits >> 52) & 0x7ff);
+    uint64 mantissa = bits & ((uint64(1) << 52) - 1);
+    if (exponent == 0x7ff) {
+        flags |= mantissa != 0 ? SEEN_NAN : (negative ? SEEN_NEGATIVE_INFINITY : SEEN_POSITIVE_INFINITY);
+        return;
+    }
+    // value = mantissa * 2^(shift - 1074), subnormals included.
+    int shift = 0;
+    if (exponent > 0) {
+        mantissa |= uint64(1) << 52;
+        shift = exponent - 1;
+    }
+    if (mantissa == 0) {
+        return;
+    }
+
+    // The shifted mantissa spans two words, carries and borrows ripple up from there.
+    int low = WORD_COUNT - 1 - shift / 64;
+    unsigned __int128 part = static_cast<unsigned __int128>(mantissa) << (shift % 64);
+    uint64 partLow = static_cast<uint64>(part);
+    uint64 partHigh = static_cast<uint64>(part >> 64);
+    if (! negative) {
+        uint64 word = words[low] + partLow;
+        uint64 carry = word < partLow;
+        words[low] = word;
+        word = words[low - 1] + partHigh;
+        uint64 nextCarry = word < partHigh;
+        word += carry;
+        nextCarry |= word < carry;
+        words[low - 1] = word;
+        for (int i = low - 2; nextCarry && i >= 0; i--) {
+            nextCarry = ++words[i] == 0;
+        }
+    }
+    else {
+        uint64 borrow = words[low] < partLow;
+        words[low] -= partLow;
+        uint64 word = words[low - 1];
+        uint64 nextBorrow = word < partHigh;
+        word -= partHigh;
+        nextBorrow |= word < borrow;
+        words[low - 1] = word - borrow;
+        for (int i = low - 2; nextBorrow && i >= 0; i--) {
+            nextBorrow = words[i]-- == 0;
+        }
+    }
+}
+
+// Adds another accumulator to the words.
+inline void merge(uint64 *words, vint &flags, const uint64 *otherWords, vint otherFlags) {
+    Basics::BigInt::accumulateNN(words, otherWords, WORD_COUNT);
+    flags |= otherFlags;
+}
+
+// The sum rounded to the nearest double, or the infinity or NaN it was poisoned with.
+inline vfloat toFloat(const uint64 *words, vint flags) {
+    bool positiveInfinity = (flags & SEEN_POSITIVE_INFINITY) != 0;
+    bool negativeInfinity = (flags & SEEN_NEGATIVE_INFINITY) != 0;
+    if ((flags & SEEN_NAN) != 0 || (positiveInfinity && negativeInfinity)) {
+        return vfloat_NaN;
+    }
+    if (positiveInfinity) {
+        return INFINITY;
+    }
+    if (negativeInfinity) {
+        return -INFINITY;
+    }
+
+    uint64 magnitude[WORD_COUNT];
+    memcpy(magnitude, words, sizeof(magnitude));
+    bool negative = Basics::BigInt::isNeg(magnitude, WORD_COUNT);
+    if (negative) {
+        Basics::BigInt::invertSign(magnitude, WORD_COUNT);
+    }
+    int top = 0;
+    while (top < WORD_COUNT && magnitude[top] == 0) {
+        top++;
+    }
+    if (top == WORD_COUNT) {
+        return 0;
+    }
+
+    // The 64 leading bits, the lowest one ORed with all the bits below them so that
+    // the conversion to double rounds the whole integer to nearest, not the truncation.
+    int leadingZeros = __builtin_clzll(magnitude[top]);
+    int bitLength = (WORD_COUNT - top) * 64 - leadingZeros;
+    uint64 leading = magnitude[top] << leadingZeros;
+    uint64 sticky = 0;
+    if (top + 1 < WORD_COUNT) {
+        if (leadingZeros > 0) {
+            leading |= magnitude[top + 1] >> (64 - leadingZeros);
+        }
+        sticky = magnitude[top + 1] << leadingZeros;
+        for (int i = top + 2; i < WORD_COUNT; i++) {
+            sticky |= magnitude[i];
+        }
+    }
+    leading |= sticky != 0;
+    // A sum of more than 53 bits is at least 2^-1021, a normal double, so ldexp() does not round again.
+    // A shorter one is exact.
+    vfloat retval = ldexp(static_cast<vfloat>(leading), bitLength - 64 + UNIT_EXPONENT);
+    return negative ? -retval : retval;
+}
+
+} // namespace ExactSum
+
+#endif
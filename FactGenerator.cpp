@@ -0,0 +1,299 @@
+#include "Vertica.h"
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace Vertica;
+
+/*
+ * COPY t WITH SOURCE fact_generator(rows=N, cardinalities='c0,...,cD-1',
+ *                                   nullpct=P, seed=S, skew=Z)
+ *        DELIMITER '|' NULL ''
+ *
+ * Generates a synthetic fact table with the schema of FactTableBuilder:
+ * D VARCHAR dimensions d0, ..., dD-1 whose values are "d<i>_group<g>", with
+ * g in [0, ci), followed by a FLOAT measure m, an integer in [0, 100) that
+ * is NULL with a probability of P%. The rows are written as delimited text
+ * for the default parser.
+ *
+ * The rows are cut into fixed blocks and every block has its own random
+ * stream, derived from the seed and the block number. The blocks are spread
+ * over all the nodes and over the load threads of every node, and the data
+ * does not depend on how they are spread: the same parameters always give
+ * the same table.
+ *
+ * Parameters:
+ *   rows (INTEGER)          - number of rows to generate.
+ *   cardinalities (VARCHAR) - comma-separated group count of every dimension.
+ *   nullpct (INTEGER)       - percentage of NULL measures, 0 by default.
+ *   seed (INTEGER)          - seed of the random streams, 0 by default.
+ *   skew (FLOAT)            - when positive, the groups of a dimension follow
+ *                             a Zipf distribution with this exponent (group 0
+ *                             is the most frequent), uniform by default.
+ */
+
+static const vint ROWS_PER_BLOCK = 65536;
+
+struct GeneratorParameters {
+    vint rows;
+    std::vector<vint> cardinalities;
+    vint nullPct;
+    vint seed;
+    vfloat skew;
+};
+
+static void readGeneratorParameters(ServerInterface &srvInterface, GeneratorParameters &parameters)
+{
+    ParamReader params = srvInterface.getParamReader();
+    parameters.rows = params.containsParameter("rows") ? params.getIntRef("rows") : 0;
+    parameters.nullPct = params.containsParameter("nullpct") ? params.getIntRef("nullpct") : 0;
+    parameters.seed = params.containsParameter("seed") ? params.getIntRef("seed") : 0;
+    parameters.skew = params.containsParameter("skew") ? params.getFloatRef("skew") : 0;
+    parameters.cardinalities.clear();
+    if (params.containsParameter("cardinalities")) {
+        std::string list = params.getStringRef("cardinalities").str();
+        size_t start = 0;
+        while (start <= list.size()) {
+            size_t end = list.find(',', start);
+            if (end == std::string::npos) {
+                end = list.size();
+            }
+            std::string item = list.substr(start, end - start);
+            char *parsedEnd;
+            long long cardinality = strtoll(item.c_str(), &parsedEnd, 10);
+            if (item.empty() || *parsedEnd != '\0' || cardinality <= 0) {
+                vt_report_error(0, "FactGenerator expects positive integer cardinalities, got [%s]", item.c_str());
+            }
+            parameters.cardinalities.push_back(cardinality);
+            start = end + 1;
+        }
+    }
+
+    if (parameters.rows < 0) {
+        vt_report_error(0, "FactGenerator expects a non-negative rows parameter");
+    }
+    if (parameters.cardinalities.empty()) {
+        vt_report_error(0, "FactGenerator expects the cardinality of at least one dimension");
+    }
+    if (parameters.nullPct < 0 || parameters.nullPct > 100) {
+        vt_report_error(0, "FactGenerator expects a nullpct parameter between 0 and 100");
+    }
+    if (vfloatIsNull(parameters.skew) || parameters.skew < 0) {
+        vt_report_error(0, "FactGenerator expects a non-negative skew parameter");
+    }
+}
+
+// SplitMix64, small and fast, and any 64-bit state is a good seed.
+class RandomStream
+{
+public:
+    explicit RandomStream(uint64_t seed) : m_state(seed) { }
+
+    uint64_t next() {
+        uint64_t z = (m_state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    // Uniform in [0, bound), by multiply-shift rather than modulo.
+    uint64_t nextBelow(uint64_t bound) {
+        return static_cast<uint64_t>((static_cast<unsigned __int128>(next()) * bound) >> 64);
+    }
+
+    // Uniform in [0, 1).
+    double nextDouble() {
+        return (next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+private:
+    uint64_t m_state;
+};
+
+class FactGenerator : public UDSource
+{
+public:
+    FactGenerator(vint firstBlock, vint lastBlock)
+        : m_firstBlock(firstBlock), m_lastBlock(lastBlock), m_random(0) { }
+
+    virtual void setup(ServerInterface &srvInterface)
+    {
+        try {
+            readGeneratorParameters(srvInterface, m_parameters);
+            size_t dimensionCount = m_parameters.cardinalities.size();
+            m_labels.resize(dimensionCount);
+            m_cdfs.resize(dimensionCount);
+            m_maxRowLength = 4; // the measure and the newline.
+            char label[64];
+            for (size_t i = 0; i < dimensionCount; i++) {
+                vint cardinality = m_parameters.cardinalities[i];
+                m_labels[i].reserve(cardinality);
+                for (vint g = 0; g < cardinality; g++) {
+                    snprintf(label, sizeof(label), "d%zu_group%lld|", i, static_cast<long long>(g));
+                    m_labels[i].push_back(label);
+                }
+                m_maxRowLength += m_labels[i].back().size();
+                if (m_parameters.skew > 0) {
+                    // Cumulative Zipf weights 1 / (g + 1)^skew, normalized to 1.
+                    m_cdfs[i].resize(cardinality);
+                    double total = 0;
+                    for (vint g = 0; g < cardinality; g++) {
+                        total += pow(static_cast<double>(g + 1), -m_parameters.skew);
+                        m_cdfs[i][g] = total;
+                    }
+                    for (vint g = 0; g < cardinality; g++) {
+                        m_cdfs[i][g] /= total;
+                    }
+                }
+            }
+            m_block = m_firstBlock;
+            m_row = m_blockEnd = 0;
+            if (m_block < m_lastBlock) {
+                startBlock();
+            }
+        } catch (std::exception &e) {
+            // Standard exception. Quit.
+            vt_report_error(0, "Exception while setting up the fact generator: [%s]", e.what());
+        }
+    }
+
+    virtual StreamState process(ServerInterface &srvInterface, DataBuffer &output)
+    {
+        try {
+            size_t dimensionCount = m_labels.size();
+            while (m_row < m_blockEnd || (++m_block < m_lastBlock && startBlock())) {
+                if (output.size - output.offset < m_maxRowLength) {
+                    if (output.offset == 0) {
+                        vt_report_error(0, "FactGenerator needs a buffer of at least %zu bytes", m_maxRowLength);
+                    }
+                    return OUTPUT_NEEDED;
+                }
+                char *pos = output.buf + output.offset;
+                for (size_t i = 0; i < dimensionCount; i++) {
+                    const std::string &label = m_labels[i][pickGroup(i)];
+                    memcpy(pos, label.data(), label.size());
+                    pos += label.size();
+                }
+                // Draw both numbers for every row, so NULLs do not shift the stream.
+                uint64_t isNull = m_random.nextBelow(100) < static_cast<uint64_t>(m_parameters.nullPct);
+                uint64_t value = m_random.nextBelow(100);
+                if (! isNull) {
+                    if (value >= 10) {
+                        *pos++ = '0' + value / 10;
+                    }
+                    *pos++ = '0' + value % 10;
+                }
+                *pos++ = '\n';
+                output.offset = pos - output.buf;
+                m_row++;
+            }
+        } catch (std::exception &e) {
+            // Standard exception. Quit.
+            vt_report_error(0, "Exception while generating facts: [%s]", e.what());
+        }
+        return DONE;
+    }
+
+private:
+    // Positions the stream at the start of m_block, returns false past the last row.
+    bool startBlock()
+    {
+        m_row = m_block * ROWS_PER_BLOCK;
+        m_blockEnd = std::min(m_row + ROWS_PER_BLOCK, m_parameters.rows);
+        m_random = RandomStream(static_cast<uint64_t>(m_parameters.seed) * 0x100000001B3ULL
+                                + static_cast<uint64_t>(m_block));
+        // Skip the first output, it is correlated with the seed.
+        m_random.next();
+        return m_row < m_blockEnd;
+    }
+
+    vint pickGroup(size_t i)
+    {
+        if (m_cdfs[i].empty()) {
+            return m_random.nextBelow(m_parameters.cardinalities[i]);
+        }
+        const std::vector<double> &cdf = m_cdfs[i];
+        size_t g = std::upper_bound(cdf.begin(), cdf.end(), m_random.nextDouble()) - cdf.begin();
+        return std::min(g, cdf.size() - 1);
+    }
+
+    GeneratorParameters m_parameters;
+    std::vector<std::vector<std::string> > m_labels; // "d<i>_group<g>|" of every group.
+    std::vector<std::vector<double> > m_cdfs;        // only with a skew.
+    size_t m_maxRowLength;
+    vint m_firstBlock;
+    vint m_lastBlock;
+    vint m_block;
+    vint m_row;
+    vint m_blockEnd;
+    RandomStream m_random;
+};
+
+
+/*
+ * This class provides the meta-data associated with the source shown above,
+ * as well as a way of instantiating objects of the class.
+ */
+class FactGeneratorFactory : public SourceFactory
+{
+    // Validate the parameters once, and run on every node.
+    virtual void plan(ServerInterface &srvInterface,
+                      NodeSpecifyingPlanContext &planCtxt)
+    {
+        GeneratorParameters parameters;
+        readGeneratorParameters(srvInterface, parameters);
+        planCtxt.setTargetNodes(planCtxt.getClusterNodes());
+    }
+
+    // One source per load thread, every source takes a contiguous run of blocks.
+    virtual std::vector<UDSource *> prepareUDSourcesExecutor(ServerInterface &srvInterface,
+                                                             ExecutorPlanContext &planCtxt)
+    {
+        GeneratorParameters parameters;
+        readGeneratorParameters(srvInterface, parameters);
+        const std::vector<std::string> &nodes = planCtxt.getTargetNodes();
+        std::vector<std::string>::const_iterator node =
+                std::find(nodes.begin(), nodes.end(), srvInterface.getCurrentNodeName());
+        if (node == nodes.end()) {
+            vt_report_error(0, "FactGenerator is not planned to run on node %s",
+                            srvInterface.getCurrentNodeName().c_str());
+        }
+        vint nodeIndex = node - nodes.begin();
+        vint threadCount = std::max<vint>(1, planCtxt.getMaxAllowedThreads());
+        vint sourceCount = static_cast<vint>(nodes.size()) * threadCount;
+        vint blockCount = (parameters.rows + ROWS_PER_BLOCK - 1) / ROWS_PER_BLOCK;
+
+        std::vector<UDSource *> retval;
+        for (vint t = 0; t < threadCount; t++) {
+            vint source = nodeIndex * threadCount + t;
+            vint firstBlock = blockCount * source / sourceCount;
+            vint lastBlock = blockCount * (source + 1) / sourceCount;
+            if (firstBlock < lastBlock) {
+                retval.push_back(vt_createFuncObject<FactGenerator>(srvInterface.allocator,
+                                                                    firstBlock, lastBlock));
+            }
+        }
+        if (retval.empty()) {
+            // Nothing to generate on this node.
+            retval.push_back(vt_createFuncObject<FactGenerator>(srvInterface.allocator, 0, 0));
+        }
+        return retval;
+    }
+
+    virtual void getParameterType(ServerInterface &srvInterface,
+                                  SizedColumnTypes &parameterTypes)
+    {
+        parameterTypes.addInt("rows");
+        parameterTypes.addVarchar(65000, "cardinalities");
+        parameterTypes.addInt("nullpct");
+        parameterTypes.addInt("seed");
+        parameterTypes.addFloat("skew");
+    }
+};
+
+RegisterFactory(FactGeneratorFactory);
@@ -0,0 +1,68 @@
+#include "Vertica.h"
+#include "FactParser.h"
+#include <string>
+
+using namespace Vertica;
+
+/*
+ * COPY t FROM 'file' WITH PARSER fact_parser(delimiter='|')
+ *
+ * Loads delimited fact files (see FactParser.h) with a chunker, so one file
+ * is parsed by several threads at once.
+ *
+ * Parameters:
+ *   delimiter (VARCHAR) - the one-byte field delimiter, '|' by default.
+ */
+
+static char readDelimiter(ServerInterface &srvInterface)
+{
+    ParamReader params = srvInterface.getParamReader();
+    if (! params.containsParameter("delimiter")) {
+        return '|';
+    }
+    std::string delimiter = params.getStringRef("delimiter").str();
+    if (delimiter.size() != 1 || delimiter[0] == '\n' || delimiter[0] == '\r') {
+        vt_report_error(0, "FactParser expects a one-byte delimiter other than a line break");
+    }
+    return delimiter[0];
+}
+
+
+/*
+ * This class provides the meta-data associated with the parser and chunker
+ * shown in FactParser.h, as well as a way of instantiating objects of the
+ * classes.
+ */
+class FactParserFactory : public ParserFactory
+{
+    virtual void plan(ServerInterface &srvInterface,
+                      PerColumnParamReader &perColumnParamReader,
+                      PlanContext &planCtxt)
+    {
+        readDelimiter(srvInterface);
+    }
+
+    virtual UDParser *prepare(ServerInterface &srvInterface,
+                              PerColumnParamReader &perColumnParamReader,
+                              PlanContext &planCtxt,
+                              const SizedColumnTypes &returnType)
+    {
+        return vt_createFuncObject<FactParser>(srvInterface.allocator, readDelimiter(srvInterface));
+    }
+
+    virtual UDChunker *prepareChunker(ServerInterface &srvInterface,
+                                      PerColumnParamReader &perColumnParamReader,
+                                      PlanContext &planCtxt,
+                                      const SizedColumnTypes &returnType)
+    {
+        return vt_createFuncObject<FactChunker>(srvInterface.allocator);
+    }
+
+    virtual void getParameterType(ServerInterface &srvInterface,
+                                  SizedColumnTypes &parameterTypes)
+    {
+        parameterTypes.addVarchar(1, "delimiter");
+    }
+};
+
+RegisterFactory(FactParserFactory);
@@ -0,0 +1,225 @@
+#ifndef FACT_PARSER_H
+#define FACT_PARSER_H
+
+#include "Vertica.h"
+#include "DelimitedScanner.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace Vertica;
+
+/*
+ * Parser and chunker for delimited fact files, one record per line:
+ *
+ *   d0_group3|d1_group0|...|42
+ *
+ * The fields are matched to the table columns by position. VARCHAR and CHAR
+ * fields are copied straight from the input buffer into the row writer,
+ * FLOAT and INTEGER fields are converted in place. An empty field is NULL.
+ * A record with the wrong number of fields, or with a number that cannot be
+ * converted, is rejected.
+ *
+ * The chunker cuts the input after the last record terminator of every
+ * buffer, so that the chunks can be parsed by several threads at once.
+ */
+
+class FactParser : public UDParser
+{
+public:
+    FactParser(char delimiter,
+               DelimitedScanner::FindEitherFunction findEither = DelimitedScanner::getFindEither())
+        : m_delimiter(delimiter), m_findEither(findEither) { }
+
+    virtual void setup(ServerInterface &srvInterface, SizedColumnTypes &returnType)
+    {
+        m_columnTypes.clear();
+        for (size_t i = 0; i < returnType.getColumnCount(); i++) {
+            const VerticaType &type = returnType.getColumnType(i);
+            if (type.isStringType()) {
+                m_columnTypes.push_back(STRING_FIELD);
+            }
+            else if (type.isFloat()) {
+                m_columnTypes.push_back(FLOAT_FIELD);
+            }
+            else if (type.isInt()) {
+                m_columnTypes.push_back(INTEGER_FIELD);
+            }
+            else {
+                vt_report_error(0, "FactParser cannot load column %zu of type %s",
+                                i, type.getTypeStr());
+            }
+        }
+    }
+
+    virtual StreamState process(ServerInterface &srvInterface, DataBuffer &input, InputState inputState)
+    {
+        try {
+            const char *end = input.buf + input.size;
+            const char *record = input.buf + input.offset;
+            // Without more input, an unterminated last record is complete.
+            bool lastBuffer = inputState == END_OF_FILE || inputState == END_OF_CHUNK;
+            size_t columnCount = m_columnTypes.size();
+            while (record < end) {
+                const char *pos = record;
+                const char *reason = NULL;
+                size_t i = 0;
+                for (; i < columnCount; i++) {
+                    const char *fieldEnd = m_findEither(pos, end, m_delimiter, '\n');
+                    if (fieldEnd == end && ! lastBuffer) {
+                        // Wait for the rest of the record.
+                        input.offset = record - input.buf;
+                        return INPUT_NEEDED;
+                    }
+                    bool recordEnds = fieldEnd == end || *fieldEnd == '\n';
+                    if (recordEnds != (i == columnCount - 1)) {
+                        reason = recordEnds ? "Too few fields" : "Too many fields";
+                        break;
+                    }
+                    const char *valueEnd = fieldEnd;
+                    if (recordEnds && valueEnd > pos && valueEnd[-1] == '\r') {
+                        valueEnd--;
+                    }
+                    if (! setField(i, pos, valueEnd)) {
+                        reason = "Invalid number";
+                        break;
+                    }
+                    pos = fieldEnd + (fieldEnd < end ? 1 : 0);
+                }
+                if (reason != NULL) {
+                    const char *recordEnd = static_cast<const char *>(memchr(pos, '\n', end - pos));
+                    if (recordEnd == NULL && ! lastBuffer) {
+                        input.offset = record - input.buf;
+                        return INPUT_NEEDED;
+                    }
+                    recordEnd = recordEnd == NULL ? end : recordEnd;
+                    m_rejectedReason = reason;
+                    m_rejectedData = record;
+                    m_rejectedLength = recordEnd - record;
+                    input.offset = recordEnd + (recordEnd < end ? 1 : 0) - input.buf;
+                    return REJECT;
+                }
+                writer->next();
+                record = pos;
+            }
+            input.offset = input.size;
+            return inputState == END_OF_FILE ? DONE : INPUT_NEEDED;
+        } catch (std::exception &e) {
+            // Standard exception. Quit.
+            vt_report_error(0, "Exception while parsing facts: [%s]", e.what());
+        }
+        return DONE;
+    }
+
+    virtual RejectedRecord getRejectedRecord()
+    {
+        return RejectedRecord(m_rejectedReason, m_rejectedData, m_rejectedLength);
+    }
+
+private:
+    enum FieldType { STRING_FIELD, FLOAT_FIELD, INTEGER_FIELD };
+
+    // Converts [begin, end) into column i of the current row, returns false if it is not a number.
+    bool setField(size_t i, const char *begin, const char *end)
+    {
+        if (begin == end) {
+            writer->setNull(i);
+            return true;
+        }
+        switch (m_columnTypes[i]) {
+        case STRING_FIELD:
+            writer->getStringRef(i).copy(begin, end - begin);
+            return true;
+        case FLOAT_FIELD: {
+            vint integer;
+            vfloat value;
+            // Integers of up to 15 digits are exact as doubles, anything else goes through strtod().
+            if (end - begin <= 15 && parseInteger(begin, end, integer)) {
+                value = static_cast<vfloat>(integer);
+            }
+            else if (! parseDouble(begin, end, value)) {
+                return false;
+            }
+            writer->setFloat(i, value);
+            return true;
+        }
+        default: {
+            vint value;
+            if (! parseInteger(begin, end, value)) {
+                return false;
+            }
+            writer->setInt(i, value);
+            return true;
+        }
+        }
+    }
+
+    static bool parseInteger(const char *begin, const char *end, vint &value)
+    {
+        bool negative = *begin == '-';
+        if (negative || *begin == '+') {
+            begin++;
+        }
+        if (begin == end) {
+            return false;
+        }
+        uint64 magnitude = 0;
+        for (; begin < end; begin++) {
+            unsigned digit = static_cast<unsigned char>(*begin) - '0';
+            if (digit > 9 || magnitude > (static_cast<uint64>(vint_null) - 1 - digit) / 10) {
+                return false;
+            }
+            magnitude = magnitude * 10 + digit;
+        }
+        // vint_null is the smallest vint, so the range is symmetric.
+        value = negative ? -static_cast<vint>(magnitude) : static_cast<vint>(magnitude);
+        return true;
+    }
+
+    // strtod() needs a terminated string, copy the field onto the stack.
+    static bool parseDouble(const char *begin, const char *end, vfloat &value)
+    {
+        char buffer[64];
+        size_t length = end - begin;
+        if (length >= sizeof(buffer)) {
+            return false;
+        }
+        memcpy(buffer, begin, length);
+        buffer[length] = '\0';
+        char *parsedEnd;
+        errno = 0;
+        value = strtod(buffer, &parsedEnd);
+        return parsedEnd == buffer + length && errno != ERANGE;
+    }
+
+    char m_delimiter;
+    DelimitedScanner::FindEitherFunction m_findEither;
+    std::vector<FieldType> m_columnTypes;
+    std::string m_rejectedReason;
+    const char *m_rejectedData;
+    size_t m_rejectedLength;
+};
+
+class FactChunker : public UDChunker
+{
+public:
+    virtual StreamState process(ServerInterface &srvInterface, DataBuffer &input, InputState inputState)
+    {
+        if (inputState == END_OF_FILE) {
+            input.offset = input.size;
+            return DONE;
+        }
+        const char *lastTerminator = DelimitedScanner::findLast(input.buf + input.offset,
+                                                                input.buf + input.size, '\n');
+        if (lastTerminator == NULL) {
+            // Not even one whole record, leave the offset alone to get a larger buffer.
+            return INPUT_NEEDED;
+        }
+        input.offset = lastTerminator + 1 - input.buf;
+        return CHUNK_ALIGNED;
+    }
+};
+
+#endif
@@ -0,0 +1,277 @@
+/*
+ * Local benchmark for the FactParser UDParser and its FactChunker.
+ *
+ * Reads a delimited fact file into memory and feeds it to the parser in
+ * DataBuffers the way COPY does, into a UDxHarness BlockStreamWriter:
+ *
+ *   stream  - one parser over consecutive buffers of the whole file, the
+ *             partial record at the end of a buffer is carried over.
+ *   chunked - the chunker cuts the buffers on record boundaries and the
+ *             chunks are parsed by T threads, one parser each.
+ *
+ * Every mode runs with each delimiter scanner and reports rows/sec and MB/sec.
+ *
+ * Usage: ./FactParserBench [file] [threads] [repeats]
+ *   Without a file, writes FactParserBench.txt: 5M rows of 4 dimensions, in
+ *   the format of the fact_generator source.
+ */
+#include "Vertica.h"
+#include "FactParser.h"
+#include "UDxHarness.h"
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+using namespace Vertica;
+
+static const int ROWS_PER_BLOCK = 1024;
+static const int STRING_LENGTH = 80;
+static const size_t BUFFER_SIZE = 1 << 20;
+
+// The blocks are handed back to the bench instead of the server.
+class BenchStreamWriter : public UDxHarness::BlockStreamWriter
+{
+public:
+    BenchStreamWriter(const SizedColumnTypes &types)
+        : BlockStreamWriter(types, ROWS_PER_BLOCK), m_rows(0), m_measureSum(0) { }
+
+    vint m_rows;
+    vfloat m_measureSum;
+
+protected:
+    virtual void consumeBlock(std::vector<UDxHarness::Column> &columns, int rowCount)
+    {
+        const UDxHarness::Column &measures = columns.back();
+        for (int i = 0; i < rowCount; i++) {
+            if (! vfloatIsNull(measures.getFloat(i))) {
+                m_measureSum += measures.getFloat(i);
+            }
+        }
+        m_rows += rowCount;
+    }
+};
+
+struct Result {
+    Result() : rows(0), rejected(0), measureSum(0) { }
+    vint rows;
+    vint rejected;
+    vfloat measureSum;
+};
+
+static ServerInterface *newServerInterface()
+{
+    return new UDxHarness::HarnessServerInterface();
+}
+
+// Runs one parser over [begin, end), in buffers of at most BUFFER_SIZE bytes.
+static void parse(const char *begin, const char *end, size_t dimensionCount, bool chunk,
+                  DelimitedScanner::FindEitherFunction findEither, Result &result)
+{
+    ServerInterface *srvInterface = newServerInterface();
+    SizedColumnTypes returnType;
+    for (size_t i = 0; i < dimensionCount; i++) {
+        returnType.addVarchar(STRING_LENGTH);
+    }
+    returnType.addFloat();
+    BenchStreamWriter writer(returnType);
+    FactParser parser('|', findEither);
+    parser.setStreamWriter(&writer);
+    parser.setup(*srvInterface, returnType);
+
+    const char *start = begin;
+    StreamState state = INPUT_NEEDED;
+    while (state != DONE) {
+        DataBuffer input;
+        input.buf = const_cast<char *>(start);
+        input.size = std::min<size_t>(BUFFER_SIZE, end - start);
+        input.offset = 0;
+        InputState inputState = start + input.size == end ? (chunk ? END_OF_CHUNK : END_OF_FILE) : OK;
+        do {
+            state = parser.process(*srvInterface, input, inputState);
+            if (state == REJECT) {
+                result.rejected++;
+            }
+        } while (state == REJECT);
+        if (input.offset == 0 && inputState == OK) {
+            fprintf(stderr, "A record is longer than the buffer\n");
+            exit(1);
+        }
+        start += input.offset;
+        if (chunk && inputState == END_OF_CHUNK) {
+            break;
+        }
+    }
+    writer.flush();
+    result.rows += writer.m_rows;
+    result.measureSum += writer.m_measureSum;
+    delete srvInterface;
+}
+
+// Cuts [begin, end) into chunks with the chunker, fed with BUFFER_SIZE buffers.
+static std::vector<std::pair<const char *, const char *> > getChunks(const char *begin, const char *end)
+{
+    ServerInterface *srvInterface = newServerInterface();
+    FactChunker chunker;
+    std::vector<std::pair<const char *, const char *> > retval;
+    const char *start = begin;
+    while (true) {
+        DataBuffer input;
+        input.buf = const_cast<char *>(start);
+        input.size = std::min<size_t>(BUFFER_SIZE, end - start);
+        input.offset = 0;
+        InputState inputState = start + input.size == end ? END_OF_FILE : OK;
+        StreamState state = chunker.process(*srvInterface, input, inputState);
+        if (state == INPUT_NEEDED) {
+            fprintf(stderr, "A record is longer than the buffer\n");
+            exit(1);
+        }
+        if (input.offset > 0) {
+            retval.push_back(std::make_pair(start, start + input.offset));
+        }
+        start += input.offset;
+        if (state == DONE) {
+            break;
+        }
+    }
+    delete srvInterface;
+    return retval;
+}
+
+static Result runChunked(const std::vector<std::pair<const char *, const char *> > &chunks,
+                         size_t dimensionCount, int threadCount,
+                         DelimitedScanner::FindEitherFunction findEither)
+{
+    std::vector<Result> results(threadCount);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; t++) {
+        threads.push_back(std::thread([&, t]() {
+            for (size_t c = t; c < chunks.size(); c += threadCount) {
+                parse(chunks[c].first, chunks[c].second, dimensionCount, true, findEither, results[t]);
+            }
+        }));
+    }
+    Result retval;
+    for (int t = 0; t < threadCount; t++) {
+        threads[t].join();
+        retval.rows += results[t].rows;
+        retval.rejected += results[t].rejected;
+        retval.measureSum += results[t].measureSum;
+    }
+    return retval;
+}
+
+static void writeSampleFile(const char *path, int rows, int dimensionCount) {
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        perror(path);
+        exit(1);
+    }
+    srand(42);
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < dimensionCount; j++) {
+            fprintf(file, "d%d_group%d|", j, rand() % 10);
+        }
+        fprintf(file, "%d\n", rand() % 100);
+    }
+    fclose(file);
+}
+
+int main(int argc, char **argv) {
+    const char *path = argc > 1 ? argv[1] : "FactParserBench.txt";
+    int maxThreads = argc > 2 ? atoi(argv[2]) : 4;
+    int repeats = argc > 3 ? atoi(argv[3]) : 3;
+    if (maxThreads <= 0 || repeats <= 0) {
+        fprintf(stderr, "Usage: %s [file] [threads] [repeats]\n", argv[0]);
+        return 1;
+    }
+    if (argc <= 1) {
+        writeSampleFile(path, 5000000, 4);
+    }
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        perror(path);
+        return 1;
+    }
+    std::vector<char> data;
+    char block[1 << 16];
+    size_t length;
+    while ((length = fread(block, 1, sizeof(block), file)) > 0) {
+        data.insert(data.end(), block, block + length);
+    }
+    fclose(file);
+    if (data.empty()) {
+        fprintf(stderr, "%s is empty\n", path);
+        return 1;
+    }
+    const char *begin = &data[0];
+    const char *end = begin + data.size();
+    const char *firstLineEnd = static_cast<const char *>(memchr(begin, '\n', data.size()));
+    size_t dimensionCount = std::count(begin, firstLineEnd == NULL ? end : firstLineEnd, '|');
+
+    std::vector<std::pair<const char *, DelimitedScanner::FindEitherFunction> > scanners;
+    scanners.push_back(std::make_pair("scalar", DelimitedScanner::findEitherScalar));
+#ifdef DELIMITED_SCANNER_HAS_SIMD
+    scanners.push_back(std::make_pair("SSE2", DelimitedScanner::findEitherSSE2));
+    if (DelimitedScanner::hasAVX2()) {
+        scanners.push_back(std::make_pair("AVX2", DelimitedScanner::findEitherAVX2));
+    }
+#endif
+
+    double chunkStart = UDxHarness::now();
+    std::vector<std::pair<const char *, const char *> > chunks = getChunks(begin, end);
+    double chunkTime = UDxHarness::now() - chunkStart;
+
+    // Sanity check: every scanner and mode load the same rows.
+    Result expected;
+    parse(begin, end, dimensionCount, false, DelimitedScanner::findEitherScalar, expected);
+    for (size_t s = 0; s < scanners.size(); s++) {
+        Result stream;
+        parse(begin, end, dimensionCount, false, scanners[s].second, stream);
+        Result chunked = runChunked(chunks, dimensionCount, maxThreads, scanners[s].second);
+        if (stream.rows != expected.rows || chunked.rows != expected.rows ||
+                stream.measureSum != expected.measureSum || chunked.measureSum != expected.measureSum) {
+            fprintf(stderr, "%s: loaded %lld/%lld rows instead of %lld\n", scanners[s].first,
+                    (long long) stream.rows, (long long) chunked.rows, (long long) expected.rows);
+            return 1;
+        }
+    }
+
+    printf("%s: %.1f MB, %lld rows (%lld rejected), %zu dimensions, best of %d runs\n",
+           path, data.size() / 1e6, (long long) expected.rows, (long long) expected.rejected,
+           dimensionCount, repeats);
+    printf("chunker: %zu chunks, %.0f MB/sec\n", chunks.size(), data.size() / 1e6 / chunkTime);
+    printf("%-8s%-8s%8s%16s%12s\n", "mode", "scanner", "threads", "rows/sec", "MB/sec");
+    // 0 stands for the stream mode.
+    std::vector<int> threadCounts(1, 0);
+    for (int threads = 1; threads < maxThreads; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(maxThreads);
+    for (size_t t = 0; t < threadCounts.size(); t++) {
+        int threads = threadCounts[t];
+        for (size_t s = 0; s < scanners.size(); s++) {
+            double best = 1e30;
+            for (int r = 0; r < repeats; r++) {
+                double start = UDxHarness::now();
+                if (threads == 0) {
+                    Result result;
+                    parse(begin, end, dimensionCount, false, scanners[s].second, result);
+                }
+                else {
+                    runChunked(chunks, dimensionCount, threads, scanners[s].second);
+                }
+                double elapsed = UDxHarness::now() - start;
+                if (elapsed < best) {
+                    best = elapsed;
+                }
+            }
+            printf("%-8s%-8s%8d%16.0f%12.1f\n", threads == 0 ? "stream" : "chunked", scanners[s].first,
+                   threads == 0 ? 1 : threads, expected.rows / best, data.size() / 1e6 / best);
+        }
+    }
+    return 0;
+}
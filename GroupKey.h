@@ -0,0 +1,80 @@
+#ifndef GROUP_KEY_H
+#define GROUP_KEY_H
+
+#include "Vertica.h"
+#include <string.h>
+#include <string>
+
+using namespace Vertica;
+
+/*
+ * Helpers for grouping rows on a run of input columns whose types are only
+ * known at run time (the UDx prototypes use addAny()).
+ *
+ * The values are serialized into one byte string that can be compared and
+ * hashed as a whole. Fixed-length values are copied as they are stored,
+ * NULLs included, since Vertica represents those in-band. Strings are written
+ * as a NULL flag, a length and the bytes. The same string can be decoded back
+ * into an output row, column by column.
+ */
+namespace GroupKey {
+
+// Appends the value of column idx of the current row to key.
+inline void append(std::string &key, BlockReader &reader, size_t idx) {
+    const VerticaType &type = reader.getTypeMetaData().getColumnType(idx);
+    if (type.isStringType()) {
+        const VString &value = reader.getStringRef(idx);
+        char isNull = value.isNull() ? 1 : 0;
+        key.append(&isNull, 1);
+        if (! isNull) {
+            vsize length = value.length();
+            key.append(reinterpret_cast<const char *>(&length), sizeof(length));
+            key.append(value.data(), length);
+        }
+    }
+    else {
+        key.append(reader.getColPtr<char>(idx), type.getMaxSize());
+    }
+}
+
+// Appends the values of columns [first, last) of the current row to key.
+inline void appendColumns(std::string &key, BlockReader &reader, size_t first, size_t last) {
+    for (size_t i = first; i < last; i++) {
+        append(key, reader, i);
+    }
+}
+
+// Writes the value starting at pos into column idx of the current output row,
+// returns the position of the next value.
+template <class Writer>
+inline const char *write(const char *pos, Writer &writer, size_t idx) {
+    const VerticaType &type = writer.getTypeMetaData().getColumnType(idx);
+    if (type.isStringType()) {
+        char isNull = *pos++;
+        if (isNull) {
+            writer.getStringRef(idx).setNull();
+            return pos;
+        }
+        vsize length;
+        memcpy(&length, pos, sizeof(length));
+        pos += sizeof(length);
+        writer.getStringRef(idx).copy(pos, length);
+        return pos + length;
+    }
+    int size = type.getMaxSize();
+    memcpy(writer.template getColPtrForWrite<char>(idx), pos, size);
+    return pos + size;
+}
+
+// Writes a whole key into columns [first, first + number of values in key).
+template <class Writer>
+inline void writeColumns(const std::string &key, Writer &writer, size_t first, size_t last) {
+    const char *pos = key.data();
+    for (size_t i = first; i < last; i++) {
+        pos = write(pos, writer, i);
+    }
+}
+
+} // namespace GroupKey
+
+#endif
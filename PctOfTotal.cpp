@@ -0,0 +1,141 @@
+#include "Vertica.h"
+#include "GroupKey.h"
+#include "SumWithNull.h"
+#include <string>
+#include <vector>
+
+using namespace Vertica;
+
+/*
+ * PCT_OF_TOTAL(key1, ..., keyN, m) OVER (PARTITION BY <total by> ORDER BY <break down by>)
+ *
+ * Computes, in one pass over each partition, the total of m and the share of
+ * every distinct group of (key1, ..., keyN). It emits one row per group:
+ * key1, ..., keyN, pct_of_total. The keys are passed through with their input
+ * types and names, so callers usually pass the total-by keys followed by the
+ * break-down-by keys. Because the rows are ordered on the break-down-by keys,
+ * the rows of a group are adjacent. So only one entry per group is kept, and
+ * the partition is never re-read.
+ *
+ * Parameters:
+ *   rowcount (INTEGER) - when positive, drop the groups, or the whole
+ *                        partition, with no more than this many rows.
+ *   sumnull (BOOLEAN)  - sum with SUMNULL semantics, a NULL m makes the
+ *                        group (and the total) NULL. Otherwise NULLs are
+ *                        ignored like SUM() does, and a group of only
+ *                        NULLs sums to NULL.
+ *
+ * The percentage is NULL if either sum is NULL or the total is zero, the same
+ * as the SQL path's b.m / NULLIF(a.m, 0).
+ */
+class PctOfTotal : public TransformFunction
+{
+    struct Group {
+        Group(const std::string &key) : key(key), count(0), sum(0) { }
+        std::string key;
+        vint count;
+        vfloat sum;
+    };
+
+    virtual void setup(ServerInterface &srvInterface, const SizedColumnTypes &argTypes)
+    {
+        ParamReader params = srvInterface.getParamReader();
+        m_rowCount = params.containsParameter("rowcount") ? params.getIntRef("rowcount") : 0;
+        m_sumNull = params.containsParameter("sumnull") && params.getBoolRef("sumnull") == vbool_true;
+    }
+
+    virtual void processPartition(ServerInterface &srvInterface,
+                                  PartitionReader &inputReader,
+                                  PartitionWriter &outputWriter)
+    {
+        try {
+            size_t measureIdx = inputReader.getNumCols() - 1;
+            std::vector<Group> groups;
+            std::string key;
+            vint totalCount = 0;
+            vfloat total = 0;
+            do {
+                key.clear();
+                GroupKey::appendColumns(key, inputReader, 0, measureIdx);
+                if (groups.empty() || groups.back().key != key) {
+                    groups.push_back(Group(key));
+                }
+                Group &group = groups.back();
+                const vfloat &input = inputReader.getFloatRef(measureIdx);
+                SumWithNullKernel::accumulate(group.sum, group.count, input, m_sumNull);
+                SumWithNullKernel::accumulate(total, totalCount, input, m_sumNull);
+                group.count++;
+                totalCount++;
+            } while (inputReader.next());
+
+            if (m_rowCount > 0 && totalCount <= m_rowCount) {
+                return;
+            }
+            for (size_t i = 0; i < groups.size(); i++) {
+                const Group &group = groups[i];
+                if (m_rowCount > 0 && group.count <= m_rowCount) {
+                    continue;
+                }
+                GroupKey::writeColumns(group.key, outputWriter, 0, measureIdx);
+                if (vfloatIsNull(group.sum) || vfloatIsNull(total) || total == 0) {
+                    outputWriter.setNull(measureIdx);
+                }
+                else {
+                    outputWriter.setFloat(measureIdx, group.sum / total);
+                }
+                outputWriter.next();
+            }
+        } catch (std::exception &e) {
+            // Standard exception. Quit.
+            vt_report_error(0, "Exception while processing partition: [%s]", e.what());
+        }
+    }
+
+    vint m_rowCount;
+    bool m_sumNull;
+};
+
+
+/*
+ * This class provides the meta-data associated with the transform function
+ * shown above, as well as a way of instantiating objects of the class.
+ */
+class PctOfTotalFactory : public TransformFunctionFactory
+{
+    virtual void getPrototype(ServerInterface &srvInterface,
+                              ColumnTypes &argTypes,
+                              ColumnTypes &returnType)
+    {
+        argTypes.addAny();
+        returnType.addAny();
+    }
+
+    // The keys keep their types and names, the percentage is appended as pct_of_total.
+    virtual void getReturnType(ServerInterface &srvInterface,
+                               const SizedColumnTypes &inputTypes,
+                               SizedColumnTypes &outputTypes)
+    {
+        size_t columnCount = inputTypes.getColumnCount();
+        if (columnCount < 2 || ! inputTypes.getColumnType(columnCount - 1).isFloat()) {
+            vt_report_error(0, "PCT_OF_TOTAL expects one or more keys followed by a FLOAT measure");
+        }
+        for (size_t i = 0; i < columnCount - 1; i++) {
+            outputTypes.addArg(inputTypes.getColumnType(i), inputTypes.getColumnName(i));
+        }
+        outputTypes.addFloat("pct_of_total");
+    }
+
+    virtual void getParameterType(ServerInterface &srvInterface,
+                                  SizedColumnTypes &parameterTypes)
+    {
+        parameterTypes.addInt("rowcount");
+        parameterTypes.addBool("sumnull");
+    }
+
+    // Create an instance of the TransformFunction
+    virtual TransformFunction *createTransformFunction(ServerInterface &srvInterface)
+    { return vt_createFuncObject<PctOfTotal>(srvInterface.allocator); }
+
+};
+
+RegisterFactory(PctOfTotalFactory);
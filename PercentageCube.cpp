@@ -0,0 +1,396 @@
+#include "Vertica.h"
+#include "GroupKey.h"
+#include "SumWithNull.h"
+#include <algorithm>
+#include <ctype.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace Vertica;
+
+/*
+ * PERCENTAGE_CUBE(d1, ..., dN, m) OVER (PARTITION BEST)
+ *
+ * Evaluates the whole percentage cube with one distributed scan of the fact
+ * table, without materializing olap_cube:
+ *
+ *   Phase 1 (node-local): hash-aggregates every non-empty cuboid of the
+ *   node's fact segment into (cuboid, d1, ..., dN, cnt, m) partial rows. The
+ *   dimensions that are not in the cuboid are NULL.
+ *
+ *   Phase 2 (partitioned by cuboid): merges the partials of one cuboid,
+ *   rolls it up into each of its sub-cuboids to get the denominators, and
+ *   emits the pct_cube rows ("total by", "break down by", d1, ..., dN, m%).
+ *   The rows match what PercentageCubeAssembler generates for the GROUP BY
+ *   method: one set for every permutation of the cuboid's dimensions and
+ *   every (total by, break down by) split of it.
+ *
+ * The cuboid id is a bit mask, bit i set means di is not "ALL". It is an
+ * INTEGER, which caps N at 62 dimensions.
+ *
+ * Parameters (shared by both phases):
+ *   rowcount (INTEGER) - when positive, only keep the groups whose cnt, and
+ *                        whose total's cnt, are greater than this.
+ *   sumnull (BOOLEAN)  - sum with SUMNULL semantics instead of SUM. With
+ *                        SUM, a cell of only NULLs sums to NULL and its
+ *                        percentage is NULL, like the SQL path's.
+ *   canonical (BOOLEAN) - emit every (total-by set, break-down-by set) pair
+ *                         of a cuboid once, with both label lists in the
+ *                         dimension order, instead of every permutation.
+ */
+
+struct CubeCell {
+    CubeCell() : count(0), sum(0) { }
+    vint count;
+    vfloat sum;
+};
+
+typedef std::unordered_map<std::string, CubeCell> CubeCellMap;
+
+static void readCubeParameters(ServerInterface &srvInterface, vint &rowCount, bool &sumNull)
+{
+    ParamReader params = srvInterface.getParamReader();
+    rowCount = params.containsParameter("rowcount") ? params.getIntRef("rowcount") : 0;
+    sumNull = params.containsParameter("sumnull") && params.getBoolRef("sumnull") == vbool_true;
+}
+
+// Same rule as Column.getQuotedColumnName() on the Java side.
+static std::string quoteColumnName(const std::string &name)
+{
+    for (size_t i = 0; i < name.size(); i++) {
+        char c = name[i];
+        if (! (isalnum(static_cast<unsigned char>(c)) || c == '_')) {
+            return "\"" + name + "\"";
+        }
+    }
+    return name;
+}
+
+class PartialCube : public TransformFunction
+{
+    virtual void setup(ServerInterface &srvInterface, const SizedColumnTypes &argTypes)
+    {
+        // The row count threshold is applied after the merge, in the second phase.
+        vint rowCount;
+        readCubeParameters(srvInterface, rowCount, m_sumNull);
+    }
+
+    virtual void processPartition(ServerInterface &srvInterface,
+                                  PartitionReader &inputReader,
+                                  PartitionWriter &outputWriter)
+    {
+        try {
+            size_t dimensionCount = inputReader.getNumCols() - 1;
+            vint cuboidCount = vint(1) << dimensionCount;
+            CubeCellMap cells;
+            std::vector<std::string> values(dimensionCount);
+            std::string key;
+            do {
+                for (size_t i = 0; i < dimensionCount; i++) {
+                    values[i].clear();
+                    GroupKey::append(values[i], inputReader, i);
+                }
+                const vfloat &input = inputReader.getFloatRef(dimensionCount);
+                for (vint cuboid = 1; cuboid < cuboidCount; cuboid++) {
+                    key.assign(reinterpret_cast<const char *>(&cuboid), sizeof(cuboid));
+                    for (size_t i = 0; i < dimensionCount; i++) {
+                        if (cuboid & (vint(1) << i)) {
+                            key.append(values[i]);
+                        }
+                    }
+                    CubeCell &cell = cells[key];
+                    SumWithNullKernel::accumulate(cell.sum, cell.count, input, m_sumNull);
+                    cell.count++;
+                }
+            } while (inputReader.next());
+
+            for (CubeCellMap::const_iterator it = cells.begin(); it != cells.end(); ++it) {
+                const char *pos = it->first.data();
+                vint cuboid;
+                memcpy(&cuboid, pos, sizeof(cuboid));
+                pos += sizeof(cuboid);
+                outputWriter.setInt(0, cuboid);
+                for (size_t i = 0; i < dimensionCount; i++) {
+                    if (cuboid & (vint(1) << i)) {
+                        pos = GroupKey::write(pos, outputWriter, i + 1);
+                    }
+                    else {
+                        outputWriter.setNull(i + 1);
+                    }
+                }
+                outputWriter.setInt(dimensionCount + 1, it->second.count);
+                outputWriter.setFloat(dimensionCount + 2, it->second.sum);
+                outputWriter.next();
+            }
+        } catch (std::exception &e) {
+            // Standard exception. Quit.
+            vt_report_error(0, "Exception while building the partial cube: [%s]", e.what());
+        }
+    }
+
+    bool m_sumNull;
+};
+
+class CuboidPercentage : public TransformFunction
+{
+    // One group of the cuboid, its dimension values are kept one string per
+    // selected dimension so that they can be re-combined for any sub-cuboid.
+    struct Group {
+        std::vector<std::string> values;
+        CubeCell cell;
+    };
+
+    virtual void setup(ServerInterface &srvInterface, const SizedColumnTypes &argTypes)
+    {
+        readCubeParameters(srvInterface, m_rowCount, m_sumNull);
+        ParamReader params = srvInterface.getParamReader();
+        m_canonical = params.containsParameter("canonical") && params.getBoolRef("canonical") == vbool_true;
+        // Input is (cuboid, d1, ..., dN, cnt, m).
+        m_dimensionNames.clear();
+        for (size_t i = 1; i + 2 < argTypes.getColumnCount(); i++) {
+            m_dimensionNames.push_back(quoteColumnName(argTypes.getColumnName(i)));
+        }
+    }
+
+    std::string joinNames(const std::vector<size_t> &dimensions, size_t first, size_t last)
+    {
+        std::string names;
+        for (size_t i = first; i < last; i++) {
+            if (i > first) {
+                names.append(",");
+            }
+            names.append(m_dimensionNames[dimensions[i]]);
+        }
+        return names;
+    }
+
+    // The key of a group in the sub-cuboid made of the selected dimensions at the given positions.
+    static void subKey(std::string &key, const Group &group, vint positionMask)
+    {
+        key.clear();
+        for (size_t i = 0; i < group.values.size(); i++) {
+            if (positionMask & (vint(1) << i)) {
+                key.append(group.values[i]);
+            }
+        }
+    }
+
+    // Emits the pct_cube rows of the cuboid's groups for one (total by, break down by) split.
+    void emitSplit(PartitionWriter &outputWriter, vint cuboid, const std::vector<Group> &groups,
+                   CubeCellMap &totals, vint totalByMask,
+                   const std::string &totalBy, const std::string &breakdownBy)
+    {
+        size_t dimensionCount = m_dimensionNames.size();
+        size_t outputCount = dimensionCount + 3;
+        std::string key;
+        for (size_t g = 0; g < groups.size(); g++) {
+            const Group &group = groups[g];
+            subKey(key, group, totalByMask);
+            const CubeCell &total = totals[key];
+            if (m_rowCount > 0 && (group.cell.count <= m_rowCount || total.count <= m_rowCount)) {
+                continue;
+            }
+            outputWriter.getStringRef(0).copy(totalBy);
+            outputWriter.getStringRef(1).copy(breakdownBy);
+            size_t position = 0;
+            for (size_t i = 0; i < dimensionCount; i++) {
+                if (cuboid & (vint(1) << i)) {
+                    GroupKey::write(group.values[position++].data(), outputWriter, i + 2);
+                }
+                else {
+                    outputWriter.setNull(i + 2);
+                }
+            }
+            if (vfloatIsNull(group.cell.sum) || vfloatIsNull(total.sum) || total.sum == 0) {
+                outputWriter.setNull(outputCount - 1);
+            }
+            else {
+                outputWriter.setFloat(outputCount - 1, group.cell.sum / total.sum);
+            }
+            outputWriter.next();
+        }
+    }
+
+    virtual void processPartition(ServerInterface &srvInterface,
+                                  PartitionReader &inputReader,
+                                  PartitionWriter &outputWriter)
+    {
+        try {
+            size_t dimensionCount = m_dimensionNames.size();
+            vint cuboid = inputReader.getIntRef(0);
+            std::vector<size_t> selected;
+            for (size_t i = 0; i < dimensionCount; i++) {
+                if (cuboid & (vint(1) << i)) {
+                    selected.push_back(i);
+                }
+            }
+
+            // Merge the node-local partials of this cuboid.
+            std::unordered_map<std::string, size_t> groupIndex;
+            std::vector<Group> groups;
+            std::vector<std::string> values(selected.size());
+            std::string key;
+            do {
+                key.clear();
+                for (size_t i = 0; i < selected.size(); i++) {
+                    values[i].clear();
+                    GroupKey::append(values[i], inputReader, selected[i] + 1);
+                    key.append(values[i]);
+                }
+                std::pair<std::unordered_map<std::string, size_t>::iterator, bool> inserted =
+                        groupIndex.insert(std::make_pair(key, groups.size()));
+                if (inserted.second) {
+                    groups.push_back(Group());
+                    groups.back().values = values;
+                }
+                CubeCell &cell = groups[inserted.first->second].cell;
+                SumWithNullKernel::accumulate(cell.sum, cell.count, inputReader.getFloatRef(dimensionCount + 2),
+                                              m_sumNull);
+                cell.count += inputReader.getIntRef(dimensionCount + 1);
+            } while (inputReader.next());
+
+            // Roll the cuboid up into every proper sub-cuboid, these are the denominators.
+            // Sub-cuboids are identified by a mask over the positions in `selected`.
+            vint fullMask = (vint(1) << selected.size()) - 1;
+            std::vector<CubeCellMap> totals(fullMask);
+            for (vint mask = 0; mask < fullMask; mask++) {
+                for (size_t g = 0; g < groups.size(); g++) {
+                    subKey(key, groups[g], mask);
+                    CubeCell &total = totals[mask][key];
+                    SumWithNullKernel::accumulate(total.sum, total.count, groups[g].cell.sum, m_sumNull);
+                    total.count += groups[g].cell.count;
+                }
+            }
+
+            if (m_canonical) {
+                // Every (total-by set, break-down-by set) pair once, both lists in the dimension order.
+                for (vint totalByMask = 0; totalByMask < fullMask; totalByMask++) {
+                    std::vector<size_t> order;
+                    for (size_t i = 0; i < selected.size(); i++) {
+                        if (totalByMask & (vint(1) << i)) {
+                            order.push_back(selected[i]);
+                        }
+                    }
+                    size_t totalByKeyCount = order.size();
+                    for (size_t i = 0; i < selected.size(); i++) {
+                        if (! (totalByMask & (vint(1) << i))) {
+                            order.push_back(selected[i]);
+                        }
+                    }
+                    emitSplit(outputWriter, cuboid, groups, totals[totalByMask], totalByMask,
+                              joinNames(order, 0, totalByKeyCount),
+                              joinNames(order, totalByKeyCount, order.size()));
+                }
+                return;
+            }
+
+            // Exhaust all the possible orders of the selected dimensions, and every split of
+            // each order into (total by, break down by).
+            std::vector<size_t> permutation(selected);
+            do {
+                for (size_t totalByKeyCount = 0; totalByKeyCount < selected.size(); totalByKeyCount++) {
+                    vint totalByMask = 0;
+                    for (size_t i = 0; i < totalByKeyCount; i++) {
+                        size_t position = std::find(selected.begin(), selected.end(), permutation[i]) - selected.begin();
+                        totalByMask |= vint(1) << position;
+                    }
+                    emitSplit(outputWriter, cuboid, groups, totals[totalByMask], totalByMask,
+                              joinNames(permutation, 0, totalByKeyCount),
+                              joinNames(permutation, totalByKeyCount, permutation.size()));
+                }
+            } while (std::next_permutation(permutation.begin(), permutation.end()));
+        } catch (std::exception &e) {
+            // Standard exception. Quit.
+            vt_report_error(0, "Exception while computing cuboid percentages: [%s]", e.what());
+        }
+    }
+
+    vint m_rowCount;
+    bool m_sumNull;
+    bool m_canonical;
+    std::vector<std::string> m_dimensionNames;
+};
+
+class PartialCubePhase : public TransformFunctionPhase
+{
+    // (d1, ..., dN, m) -> (cuboid, d1, ..., dN, cnt, m), partitioned by cuboid for the next phase.
+    virtual void getReturnType(ServerInterface &srvInterface,
+                               const SizedColumnTypes &inputTypes,
+                               SizedColumnTypes &outputTypes)
+    {
+        size_t columnCount = inputTypes.getColumnCount();
+        if (columnCount < 2 || columnCount > 63 || ! inputTypes.getColumnType(columnCount - 1).isFloat()) {
+            vt_report_error(0, "PERCENTAGE_CUBE expects 1 to 62 dimensions followed by a FLOAT measure");
+        }
+        outputTypes.addIntPartitionColumn("cuboid");
+        for (size_t i = 0; i < columnCount - 1; i++) {
+            outputTypes.addArg(inputTypes.getColumnType(i), inputTypes.getColumnName(i));
+        }
+        outputTypes.addInt("cnt");
+        outputTypes.addFloat(inputTypes.getColumnName(columnCount - 1));
+    }
+
+    virtual TransformFunction *createTransformFunction(ServerInterface &srvInterface)
+    { return vt_createFuncObject<PartialCube>(srvInterface.allocator); }
+};
+
+class CuboidPercentagePhase : public TransformFunctionPhase
+{
+    // (cuboid, d1, ..., dN, cnt, m) -> ("total by", "break down by", d1, ..., dN, m%), the pct_cube schema.
+    virtual void getReturnType(ServerInterface &srvInterface,
+                               const SizedColumnTypes &inputTypes,
+                               SizedColumnTypes &outputTypes)
+    {
+        size_t columnCount = inputTypes.getColumnCount();
+        // The labels list at most all the dimension names.
+        int labelLength = 0;
+        for (size_t i = 1; i + 2 < columnCount; i++) {
+            labelLength += quoteColumnName(inputTypes.getColumnName(i)).size() + 1;
+        }
+        outputTypes.addVarchar(labelLength, "total by");
+        outputTypes.addVarchar(labelLength, "break down by");
+        for (size_t i = 1; i + 2 < columnCount; i++) {
+            outputTypes.addArg(inputTypes.getColumnType(i), inputTypes.getColumnName(i));
+        }
+        outputTypes.addFloat(inputTypes.getColumnName(columnCount - 1) + "%");
+    }
+
+    virtual TransformFunction *createTransformFunction(ServerInterface &srvInterface)
+    { return vt_createFuncObject<CuboidPercentage>(srvInterface.allocator); }
+};
+
+
+/*
+ * This class provides the meta-data associated with the multi-phase transform
+ * function shown above, as well as a way of instantiating its phases.
+ */
+class PercentageCubeFactory : public MultiPhaseTransformFunctionFactory
+{
+    virtual void getPrototype(ServerInterface &srvInterface,
+                              ColumnTypes &argTypes,
+                              ColumnTypes &returnType)
+    {
+        argTypes.addAny();
+        returnType.addAny();
+    }
+
+    virtual void getParameterType(ServerInterface &srvInterface,
+                                  SizedColumnTypes &parameterTypes)
+    {
+        parameterTypes.addInt("rowcount");
+        parameterTypes.addBool("sumnull");
+        parameterTypes.addBool("canonical");
+    }
+
+    virtual void getPhases(ServerInterface &srvInterface, std::vector<TransformFunctionPhase *> &phases)
+    {
+        phases.push_back(&m_partialCubePhase);
+        phases.push_back(&m_cuboidPercentagePhase);
+    }
+
+    PartialCubePhase m_partialCubePhase;
+    CuboidPercentagePhase m_cuboidPercentagePhase;
+};
+
+RegisterFactory(PercentageCubeFactory);
@@ -1,4 +1,6 @@
 #include "Vertica.h"
+#include "SumWithNull.h"
+#include "ExactSum.h"
 #include <time.h> 
 #include <sstream>
 #include <iostream>
@@ -41,6 +43,27 @@ class SumWithNull : public AggregateFunction
         }
     }
 
+    // Block-at-a-time path: the rowCount values of one group are summed straight
+    // out of the block by the SIMD kernel instead of through getFloatRef()/next().
+    void aggregateBlock(ServerInterface &srvInterface,
+                        BlockReader &argReader,
+                        int rowCount,
+                        IntermediateAggs &aggs)
+    {
+        try {
+            vfloat &sum = aggs.getFloatRef(0);
+            if (vfloatIsNull(sum)) {
+                return;
+            }
+            if (! SumWithNullKernel::sumBlock(argReader.getFloatPtr(0), rowCount, sum)) {
+                sum = vfloat_null;
+            }
+        } catch (std::exception &e) {
+            // Standard exception. Quit.
+            vt_report_error(0, "Exception while processing aggregate: [%s]", e.what());
+        }
+    }
+
     virtual void combine(ServerInterface &srvInterface, 
                          IntermediateAggs &aggs, 
                          MultipleIntermediateAggs &aggsOther)
@@ -81,7 +104,7 @@ class SumWithNull : public AggregateFunction
         }
     }
 
-    InlineAggregate()
+    InlineBlockAggregate()
 };
 
 
@@ -122,3 +145,352 @@ class SumWithNullFactory : public AggregateFunctionFactory
 };
 
 RegisterFactory(SumWithNullFactory);
+
+
+/*
+ * SUMNULL_EXACT(m): SUMNULL() whose result does not depend on how the server
+ * splits and combines the partial states. The state is the exact sum
+ * (ExactSum.h) in a NUMERIC, so the same rows always give the same bits,
+ * whatever the thread count or the combine order.
+ */
+class SumWithNullExact : public AggregateFunction
+{
+    virtual void initAggregate(ServerInterface &srvInterface,
+                               IntermediateAggs &aggs) {
+        try {
+            aggs.getNumericRef(0).setZero();
+            aggs.getIntRef(1) = 0;
+        } catch (std::exception &e) {
+            // Standard exception. Quit.
+            vt_report_error(0, "Exception while initializing intermediate aggregates: [%s]", e.what());
+        }
+    }
+
+    void aggregate(ServerInterface &srvInterface,
+                   BlockReader &argReader,
+                   IntermediateAggs &aggs)
+    {
+        try {
+            VNumeric &sum = aggs.getNumericRef(0);
+            if (sum.isNull()) {
+                return;
+            }
+            vint &flags = aggs.getIntRef(1);
+            do {
+                const vfloat &input = argReader.getFloatRef(0);
+                if (vfloatIsNull(input)) {
+                    sum.setNull();
+                    return;
+                }
+                ExactSum::add(sum.words, flags, input);
+            } while (argReader.next());
+        } catch (std::exception &e) {
+            // Standard exception. Quit.
+            vt_report_error(0, "Exception while processing aggregate: [%s]", e.what());
+        }
+    }
+
+    void aggregateBlock(ServerInterface &srvInterface,
+                        BlockReader &argReader,
+                        int rowCount,
+                        IntermediateAggs &aggs)
+    {
+        try {
+            VNumeric &sum = aggs.getNumericRef(0);
+            if (sum.isNull()) {
+                return;
+            }
+            vint &flags = aggs.getIntRef(1);
+            const vfloat *values = argReader.getFloatPtr(0);
+            for (int i = 0; i < rowCount; i++) {
+                if (SumWithNullKernel::isNullBits(values + i)) {
+                    sum.setNull();
+                    return;
+                }
+                ExactSum::add(sum.words, flags, values[i]);
+            }
+        } catch (std::exception &e) {
+            // Standard exception. Quit.
+            vt_report_error(0, "Exception while processing aggregate: [%s]", e.what());
+        }
+    }
+
+    virtual void combine(ServerInterface &srvInterface,
+                         IntermediateAggs &aggs,
+                         MultipleIntermediateAggs &aggsOther)
+    {
+        try {
+            VNumeric &mySum = aggs.getNumericRef(0);
+            if (mySum.isNull()) {
+                return;
+            }
+            vint &myFlags = aggs.getIntRef(1);
+            do {
+                const VNumeric &otherSum = aggsOther.getNumericRef(0);
+                if (otherSum.isNull()) {
+                    mySum.setNull();
+                    return;
+                }
+                ExactSum::merge(mySum.words, myFlags, otherSum.words, aggsOther.getIntRef(1));
+            } while (aggsOther.next());
+        } catch (std::exception &e) {
+            // Standard exception. Quit.
+            vt_report_error(0, "Exception while combining intermediate aggregates: [%s]", e.what());
+        }
+    }
+
+    virtual void terminate(ServerInterface &srvInterface,
+                           BlockWriter &resWriter,
+                           IntermediateAggs &aggs)
+    {
+        try {
+            const VNumeric &sum = aggs.getNumericRef(0);
+            if (sum.isNull()) {
+                resWriter.setFloat(vfloat_null);
+            }
+            else {
+                resWriter.setFloat(ExactSum::toFloat(sum.words, aggs.getIntRef(1)));
+            }
+        } catch (std::exception &e) {
+            // Standard exception. Quit.
+            vt_report_error(0, "Exception while computing aggregate output: [%s]", e.what());
+        }
+    }
+
+    InlineBlockAggregate()
+};
+
+
+/*
+ * This class provides the meta-data associated with the aggregate function
+ * shown above, as well as a way of instantiating objects of the class.
+ */
+class SumWithNullExactFactory : public AggregateFunctionFactory
+{
+    virtual void getPrototype(ServerInterface &srvInterface,
+                              ColumnTypes &argTypes,
+                              ColumnTypes &returnType)
+    {
+        argTypes.addFloat();
+        returnType.addFloat();
+    }
+
+    virtual void getReturnType(ServerInterface &srvInterface,
+                               const SizedColumnTypes &inputTypes,
+                               SizedColumnTypes &outputTypes)
+    {
+        outputTypes.addFloat();
+    }
+
+    // The exact sum, then the infinities and NaNs seen (ExactSum::Flags).
+    virtual void getIntermediateTypes(ServerInterface &srvInterface,
+                                      const SizedColumnTypes &inputTypes,
+                                      SizedColumnTypes &intermediateTypeMetaData)
+    {
+        intermediateTypeMetaData.addNumeric(ExactSum::PRECISION, 0);
+        intermediateTypeMetaData.addInt();
+    }
+
+    // Create an instance of the AggregateFunction
+    virtual AggregateFunction *createAggregateFunction(ServerInterface &srvInterface)
+    { return vt_createFuncObject<SumWithNullExact>(srvInterface.allocator); }
+
+};
+
+RegisterFactory(SumWithNullExactFactory);
+
+
+/*
+ * SUMNULL(INTEGER) and SUMNULL(NUMERIC(p, s)), the same NULL semantics over
+ * exact integer arithmetic. The running sum is a NUMERIC wider than the input
+ * (SumWithNullKernel::accumulateWords()), so the partial sums cannot overflow
+ * however many rows they add up, and no value goes through a double. An
+ * INTEGER is a one-word NUMERIC to SumWithNullKernel::sumWordsBlock(), NULL
+ * included, so Input only provides the conversion of the sum to the result:
+ *
+ *     static void write(BlockWriter &resWriter, const VNumeric &sum);
+ */
+template <class Input>
+class SumWithNullWide : public AggregateFunction
+{
+    virtual void initAggregate(ServerInterface &srvInterface,
+                               IntermediateAggs &aggs) {
+        try {
+            aggs.getNumericRef(0).setZero();
+        } catch (std::exception &e) {
+            // Standard exception. Quit.
+            vt_report_error(0, "Exception while initializing intermediate aggregates: [%s]", e.what());
+        }
+    }
+
+    void aggregateBlock(ServerInterface &srvInterface,
+                        BlockReader &argReader,
+                        int rowCount,
+                        IntermediateAggs &aggs)
+    {
+        try {
+            VNumeric &sum = aggs.getNumericRef(0);
+            if (sum.isNull()) {
+                return;
+            }
+            const VNumeric *first = argReader.getNumericPtr(0);
+            if (! SumWithNullKernel::sumWordsBlock(reinterpret_cast<const char *>(first->words), first->nwds,
+                                                   argReader.getColStride(0), rowCount, sum.words, sum.nwds)) {
+                sum.setNull();
+            }
+        } catch (std::exception &e) {
+            // Standard exception. Quit.
+            vt_report_error(0, "Exception while processing aggregate: [%s]", e.what());
+        }
+    }
+
+    virtual void combine(ServerInterface &srvInterface,
+                         IntermediateAggs &aggs,
+                         MultipleIntermediateAggs &aggsOther)
+    {
+        try {
+            VNumeric &mySum = aggs.getNumericRef(0);
+            if (mySum.isNull()) {
+                return;
+            }
+            do {
+                const VNumeric &otherSum = aggsOther.getNumericRef(0);
+                if (otherSum.isNull()) {
+                    mySum.setNull();
+                    return;
+                }
+                Basics::BigInt::accumulateNN(mySum.words, otherSum.words, mySum.nwds);
+            } while (aggsOther.next());
+        } catch (std::exception &e) {
+            // Standard exception. Quit.
+            vt_report_error(0, "Exception while combining intermediate aggregates: [%s]", e.what());
+        }
+    }
+
+    virtual void terminate(ServerInterface &srvInterface,
+                           BlockWriter &resWriter,
+                           IntermediateAggs &aggs)
+    {
+        try {
+            const VNumeric &sum = aggs.getNumericRef(0);
+            Input::write(resWriter, sum);
+        } catch (std::exception &e) {
+            // Standard exception. Quit.
+            vt_report_error(0, "Exception while computing aggregate output: [%s]", e.what());
+        }
+    }
+
+    InlineStridedAggregate()
+};
+
+// The INTEGERs are summed in two words, the result has to fit back in an INTEGER like SUM() does.
+struct IntegerInput {
+    static const int SUM_PRECISION = 37;
+
+    static void write(BlockWriter &resWriter, const VNumeric &sum) {
+        if (sum.isNull()) {
+            resWriter.setInt(vint_null);
+            return;
+        }
+        vint value = static_cast<vint>(sum.words[sum.nwds - 1]);
+        bool fits = value != vint_null;
+        for (int i = 0; i < sum.nwds - 1; i++) {
+            fits = fits && sum.words[i] == (value < 0 ? ~uint64(0) : 0);
+        }
+        if (! fits) {
+            vt_report_error(0, "SUMNULL() result is out of the INTEGER range");
+        }
+        resWriter.setInt(value);
+    }
+};
+
+// The sum keeps the scale of the NUMERIC(p, s) input, with EXTRA_DIGITS more digits of precision.
+struct NumericInput {
+    static const int EXTRA_DIGITS = 19;
+    static const int MAX_PRECISION = 1024;
+
+    static void write(BlockWriter &resWriter, const VNumeric &sum) {
+        resWriter.getNumericRef().copy(&sum);
+    }
+
+    static void addSumType(const SizedColumnTypes &inputTypes, SizedColumnTypes &types) {
+        const VerticaType &type = inputTypes.getColumnType(0);
+        int precision = type.getNumericPrecision() + EXTRA_DIGITS;
+        types.addNumeric(precision < MAX_PRECISION ? precision : MAX_PRECISION, type.getNumericScale());
+    }
+};
+
+
+/*
+ * This class provides the meta-data associated with SUMNULL(INTEGER), as
+ * well as a way of instantiating objects of the class.
+ */
+class SumWithNullIntegerFactory : public AggregateFunctionFactory
+{
+    virtual void getPrototype(ServerInterface &srvInterface,
+                              ColumnTypes &argTypes,
+                              ColumnTypes &returnType)
+    {
+        argTypes.addInt();
+        returnType.addInt();
+    }
+
+    virtual void getReturnType(ServerInterface &srvInterface,
+                               const SizedColumnTypes &inputTypes,
+                               SizedColumnTypes &outputTypes)
+    {
+        outputTypes.addInt();
+    }
+
+    virtual void getIntermediateTypes(ServerInterface &srvInterface,
+                                      const SizedColumnTypes &inputTypes,
+                                      SizedColumnTypes &intermediateTypeMetaData)
+    {
+        intermediateTypeMetaData.addNumeric(IntegerInput::SUM_PRECISION, 0);
+    }
+
+    // Create an instance of the AggregateFunction
+    virtual AggregateFunction *createAggregateFunction(ServerInterface &srvInterface)
+    { return vt_createFuncObject<SumWithNullWide<IntegerInput> >(srvInterface.allocator); }
+
+};
+
+RegisterFactory(SumWithNullIntegerFactory);
+
+
+/*
+ * This class provides the meta-data associated with SUMNULL(NUMERIC), as
+ * well as a way of instantiating objects of the class.
+ */
+class SumWithNullNumericFactory : public AggregateFunctionFactory
+{
+    virtual void getPrototype(ServerInterface &srvInterface,
+                              ColumnTypes &argTypes,
+                              ColumnTypes &returnType)
+    {
+        argTypes.addNumeric();
+        returnType.addNumeric();
+    }
+
+    // The result is as wide as the running sum.
+    virtual void getReturnType(ServerInterface &srvInterface,
+                               const SizedColumnTypes &inputTypes,
+                               SizedColumnTypes &outputTypes)
+    {
+        NumericInput::addSumType(inputTypes, outputTypes);
+    }
+
+    virtual void getIntermediateTypes(ServerInterface &srvInterface,
+                                      const SizedColumnTypes &inputTypes,
+                                      SizedColumnTypes &intermediateTypeMetaData)
+    {
+        NumericInput::addSumType(inputTypes, intermediateTypeMetaData);
+    }
+
+    // Create an instance of the AggregateFunction
+    virtual AggregateFunction *createAggregateFunction(ServerInterface &srvInterface)
+    { return vt_createFuncObject<SumWithNullWide<NumericInput> >(srvInterface.allocator); }
+
+};
+
+RegisterFactory(SumWithNullNumericFactory);
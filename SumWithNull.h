@@ -0,0 +1,229 @@
+#ifndef SUM_WITH_NULL_H
+#define SUM_WITH_NULL_H
+
+#include "Vertica.h"
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define SUMNULL_HAS_AVX2_KERNEL 1
+#endif
+
+using namespace Vertica;
+
+/*
+ * Block-at-a-time kernels shared by the SUMNULL style aggregates.
+ *
+ * Each kernel adds `count` densely packed FLOAT values to `sum` and returns
+ * false as soon as it sees a NULL, in which case the content of `sum` is
+ * undefined and the caller is expected to poison its state with vfloat_null.
+ * Vertica encodes a NULL FLOAT as one specific NaN bit pattern (vfn.vi), so
+ * NULLs are detected with an integer compare instead of vfloatIsNull().
+ */
+namespace SumWithNullKernel {
+
+inline bool isNullBits(const vfloat *value) {
+    vint bits;
+    memcpy(&bits, value, sizeof(bits));
+    return bits == vfn.vi;
+}
+
+inline bool sumBlockScalar(const vfloat *values, int count, vfloat &sum) {
+    for (int i = 0; i < count; i++) {
+        if (isNullBits(values + i)) {
+            return false;
+        }
+        sum += values[i];
+    }
+    return true;
+}
+
+#ifdef SUMNULL_HAS_AVX2_KERNEL
+__attribute__((target("avx2")))
+inline bool sumBlockAVX2(const vfloat *values, int count, vfloat &sum) {
+    const __m256i nullBits = _mm256_set1_epi64x(vfn.vi);
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    int i = 0;
+    // 8 values per iteration: two 4-lane loads, one null test, two independent adds.
+    for (; i + 8 <= count; i += 8) {
+        __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + i));
+        __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(values + i + 4));
+        __m256i nulls = _mm256_or_si256(_mm256_cmpeq_epi64(lo, nullBits),
+                                        _mm256_cmpeq_epi64(hi, nullBits));
+        if (! _mm256_testz_si256(nulls, nulls)) {
+            return false;
+        }
+        acc0 = _mm256_add_pd(acc0, _mm256_castsi256_pd(lo));
+        acc1 = _mm256_add_pd(acc1, _mm256_castsi256_pd(hi));
+    }
+    acc0 = _mm256_add_pd(acc0, acc1);
+    __m128d pair = _mm_add_pd(_mm256_castpd256_pd128(acc0), _mm256_extractf128_pd(acc0, 1));
+    pair = _mm_add_sd(pair, _mm_unpackhi_pd(pair, pair));
+    sum += _mm_cvtsd_f64(pair);
+    return sumBlockScalar(values + i, count - i, sum);
+}
+#endif
+
+inline bool hasAVX2() {
+#ifdef SUMNULL_HAS_AVX2_KERNEL
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+// Picks the widest kernel the CPU supports.
+inline bool sumBlock(const vfloat *values, int count, vfloat &sum) {
+#ifdef SUMNULL_HAS_AVX2_KERNEL
+    if (hasAVX2()) {
+        return sumBlockAVX2(values, count, sum);
+    }
+#endif
+    return sumBlockScalar(values, count, sum);
+}
+
+// Adds one value (a row, or another partial sum) to sum. With sumNull, a NULL
+// poisons the sum like SUMNULL does, otherwise it is ignored like SUM does and
+// a NULL sum only means that no value was added yet.
+inline void accumulate(vfloat &sum, const vfloat &input, bool sumNull) {
+    if (vfloatIsNull(input)) {
+        if (sumNull) {
+            sum = vfloat_null;
+        }
+    }
+    else if (! vfloatIsNull(sum)) {
+        sum += input;
+    }
+    else if (! sumNull) {
+        sum = input;
+    }
+}
+
+// Same as above for a sum of count values (or partial sums) so far. The first
+// one replaces the sum, so a group of only NULLs sums to NULL like SUM() does.
+inline void accumulate(vfloat &sum, vint count, const vfloat &input, bool sumNull) {
+    if (count == 0) {
+        sum = input;
+    }
+    else {
+        accumulate(sum, input, sumNull);
+    }
+}
+
+// Adds a NUMERIC of inputWords words to a wider one of sumWords words, both two's complement with
+// the most significant word first, so a sum can have more digits than the values it adds up.
+// The input is sign extended on the fly, the carry stops rippling as soon as there is nothing left to add.
+inline void accumulateWords(uint64 *sum, int sumWords, const uint64 *input, int inputWords) {
+    uint64 extension = static_cast<int64>(input[0]) < 0 ? ~uint64(0) : 0;
+    uint64 carry = 0;
+    for (int i = 1; i <= sumWords; i++) {
+        uint64 word = i <= inputWords ? input[inputWords - i] : extension;
+        if (i > inputWords && word == 0 && carry == 0) {
+            return;
+        }
+        uint64 result = sum[sumWords - i] + word;
+        uint64 nextCarry = result < word;
+        result += carry;
+        nextCarry |= result < carry;
+        sum[sumWords - i] = result;
+        carry = nextCarry;
+    }
+}
+
+// Adds rowCount values of inputWords words each, stride bytes apart, to sum with accumulateWords().
+// Returns false as soon as it sees a NULL, the smallest value: INT64_MIN then zero words.
+// One-word values (INTEGER, NUMERIC(18)) into a two-word sum are added up in a register.
+inline bool sumWordsBlock(const char *values, int inputWords, int stride, int rowCount,
+                          uint64 *sum, int sumWords) {
+    if (inputWords == 1 && sumWords == 2) {
+        __int128 total = 0;
+        for (int i = 0; i < rowCount; i++, values += stride) {
+            vint value;
+            memcpy(&value, values, sizeof(value));
+            if (value == vint_null) {
+                return false;
+            }
+            total += value;
+        }
+        uint64 words[2] = { static_cast<uint64>(static_cast<unsigned __int128>(total) >> 64),
+                            static_cast<uint64>(total) };
+        accumulateWords(sum, sumWords, words, 2);
+        return true;
+    }
+    for (int i = 0; i < rowCount; i++, values += stride) {
+        const uint64 *value = reinterpret_cast<const uint64 *>(values);
+        if (value[0] == static_cast<uint64>(vint_null) && Basics::BigInt::isNull(value, inputWords)) {
+            return false;
+        }
+        accumulateWords(sum, sumWords, value, inputWords);
+    }
+    return true;
+}
+
+} // namespace SumWithNullKernel
+
+/*
+ * InlineBlockAggregate() is used in place of InlineAggregate() by aggregate
+ * functions that also implement
+ *
+ *     void aggregateBlock(ServerInterface &srvInterface, BlockReader &argReader,
+ *                         int rowCount, IntermediateAggs &aggs);
+ *
+ * It is the same driver loop, except that groups whose first argument column
+ * is densely packed are handed to aggregateBlock() as a whole. Other groups
+ * still go through the row iterator in aggregate(). Note that
+ * BlockReader::getNumRows() is not reset by updateCols(), so the per-group
+ * row count has to be taken from rcounts here.
+ */
+#define InlineBlockAggregate() \
+    virtual void aggregateArrs(ServerInterface &srvInterface, void **dstTuples,\
+                               int doff, const void *arr, int stride, const void *rcounts,\
+                               int rcstride, int count, IntermediateAggs &intAggs,\
+                               std::vector<int> &intOffsets, BlockReader &arg_reader) {\
+        char *arg = const_cast<char*>(static_cast<const char*>(arr));\
+        const uint8 *rowCountPtr = static_cast<const uint8*>(rcounts);\
+        for (int i=0; i<count; ++i) {\
+            vpos rowCount = *reinterpret_cast<const vpos*>(rowCountPtr);\
+            char *aggPtr = static_cast<char *>(dstTuples[i]) + doff;\
+            updateCols(arg_reader, arg, rowCount, intAggs, aggPtr, intOffsets);\
+            if (arg_reader.getColStride(0) == sizeof(vfloat)) {\
+                aggregateBlock(srvInterface, arg_reader, rowCount, intAggs);\
+            }\
+            else {\
+                aggregate(srvInterface, arg_reader, intAggs);\
+            }\
+            arg += rowCount * stride;\
+            rowCountPtr += rcstride;\
+        }\
+    }\
+
+/*
+ * InlineStridedAggregate() hands every group to
+ *
+ *     void aggregateBlock(ServerInterface &srvInterface, BlockReader &argReader,
+ *                         int rowCount, IntermediateAggs &aggs);
+ *
+ * whatever the stride of its argument column, for the aggregates whose
+ * values are not packed densely, the NUMERICs, and that walk the column with
+ * getColStride() themselves.
+ */
+#define InlineStridedAggregate() \
+    virtual void aggregateArrs(ServerInterface &srvInterface, void **dstTuples,\
+                               int doff, const void *arr, int stride, const void *rcounts,\
+                               int rcstride, int count, IntermediateAggs &intAggs,\
+                               std::vector<int> &intOffsets, BlockReader &arg_reader) {\
+        char *arg = const_cast<char*>(static_cast<const char*>(arr));\
+        const uint8 *rowCountPtr = static_cast<const uint8*>(rcounts);\
+        for (int i=0; i<count; ++i) {\
+            vpos rowCount = *reinterpret_cast<const vpos*>(rowCountPtr);\
+            char *aggPtr = static_cast<char *>(dstTuples[i]) + doff;\
+            updateCols(arg_reader, arg, rowCount, intAggs, aggPtr, intOffsets);\
+            aggregateBlock(srvInterface, arg_reader, rowCount, intAggs);\
+            arg += rowCount * stride;\
+            rowCountPtr += rcstride;\
+        }\
+    }\
+
+#endif
@@ -0,0 +1,304 @@
+/*
+ * Local microbenchmark for the SUMNULL aggregation kernels.
+ *
+ * Feeds a dense FLOAT column through a BlockReader the same way
+ * AggregateFunction::aggregateArrs() does (one updateCols() per group), and
+ * reports rows/sec for the original row iterator and for the block kernels.
+ *
+ * Then runs the SUMNULL, SUMNULL_EXACT and CUBE_MEASURE UDxs themselves
+ * through the UDxHarness AggregateRunner, over 1 to T threads, and reports
+ * rows/sec, ns/row and allocation counts. SUMNULL_EXACT also runs on values
+ * of widely different magnitudes, where its result must still not depend on
+ * the thread count. The INTEGER and NUMERIC overloads of SUMNULL run on
+ * values whose sum overflows 64 bits.
+ *
+ * Usage: ./SumWithNullBench [rows] [repeats] [threads]
+ */
+#include "Vertica.h"
+#include "SumWithNull.h"
+#include "ExactSum.h"
+#include "UDxHarness.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace Vertica;
+using UDxHarness::AggregateRunner;
+using UDxHarness::Column;
+
+extern "C" UDXFactory *getSumWithNullFactory();
+extern "C" UDXFactory *getSumWithNullExactFactory();
+extern "C" UDXFactory *getSumWithNullIntegerFactory();
+extern "C" UDXFactory *getSumWithNullNumericFactory();
+extern "C" UDXFactory *getCubeMeasureFactory();
+
+// The pre-kernel SumWithNull::aggregate() loop.
+static void aggregateRowAtATime(BlockReader &argReader, vfloat &sum) {
+    if (vfloatIsNull(sum)) {
+        return;
+    }
+    do {
+        const vfloat &input = argReader.getFloatRef(0);
+        if (vfloatIsNull(input)) {
+            sum = vfloat_null;
+            return;
+        }
+        sum += input;
+    } while (argReader.next());
+}
+
+enum Method { ROW_ITERATOR, BLOCK_SCALAR, BLOCK_AVX2 };
+
+static const char *methodName(Method method) {
+    switch (method) {
+    case ROW_ITERATOR: return "row iterator";
+    case BLOCK_SCALAR: return "block scalar";
+    default:           return "block AVX2";
+    }
+}
+
+// Aggregates the whole column as a run of groups of groupSize rows each,
+// returning the total of all the group sums.
+static vfloat runOnce(Method method, Column &column, int groupSize) {
+    vfloat state = 0;
+    vfloat total = 0;
+    std::vector<Column *> columns(1, &column);
+    UDxHarness::ColumnReader reader(columns, 0, 0);
+    SizedColumnTypes stateTypes;
+    stateTypes.addFloat();
+    UDxHarness::TupleLayout layout(stateTypes);
+    UDxHarness::TupleAggs aggs(layout, reinterpret_cast<char *>(&state));
+    int rows = column.size();
+    for (int start = 0; start < rows; start += groupSize) {
+        int rowCount = rows - start < groupSize ? rows - start : groupSize;
+        state = 0;
+        AggregateFunction::updateCols(reader, column.getSlot(start), rowCount,
+                                      aggs, reinterpret_cast<char *>(&state), layout.offsets);
+        vfloat &sum = aggs.getFloatRef(0);
+        switch (method) {
+        case ROW_ITERATOR:
+            aggregateRowAtATime(reader, sum);
+            break;
+        case BLOCK_SCALAR:
+            if (! SumWithNullKernel::sumBlockScalar(reader.getFloatPtr(0), rowCount, sum)) {
+                sum = vfloat_null;
+            }
+            break;
+        case BLOCK_AVX2:
+#ifdef SUMNULL_HAS_AVX2_KERNEL
+            if (! SumWithNullKernel::sumBlockAVX2(reader.getFloatPtr(0), rowCount, sum)) {
+                sum = vfloat_null;
+            }
+#endif
+            break;
+        }
+        if (vfloatIsNull(sum)) {
+            return vfloat_null;
+        }
+        total += sum;
+    }
+    return total;
+}
+
+// Both outputs hold the same values, string outputs included.
+static bool sameOutput(const Column &a, const Column &b) {
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a.getType().isStringType()) {
+            if (a.isNullString(i) != b.isNullString(i) || a.getString(i) != b.getString(i)) {
+                return false;
+            }
+        }
+        else if (memcmp(a.getSlot(i), b.getSlot(i), a.getType().getMaxSize()) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Runs the UDx behind factory the way the server does, best of repeats runs.
+static bool benchUDx(const char *name, UDXFactory *factory, Column &column, int maxThreads, int repeats) {
+    SizedColumnTypes argTypes;
+    argTypes.addArg(column.getType());
+    AggregateRunner runner(*dynamic_cast<AggregateFunctionFactory *>(factory), argTypes);
+    std::vector<int> threadCounts;
+    for (int threads = 1; threads < maxThreads; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(maxThreads);
+    const size_t groupSizes[] = {16, 4096, column.size()};
+    for (size_t g = 0; g < sizeof(groupSizes) / sizeof(groupSizes[0]); g++) {
+        size_t groupCount = (column.size() - 1) / groupSizes[g] + 1;
+        Column expected(runner.getReturnType(), groupCount);
+        runner.run(column, groupSizes[g], 1, expected);
+        for (size_t t = 0; t < threadCounts.size(); t++) {
+            int threads = threadCounts[t];
+            Column output(runner.getReturnType(), groupCount);
+            AggregateRunner::Stats best;
+            for (int r = 0; r < repeats; r++) {
+                AggregateRunner::Stats stats = runner.run(column, groupSizes[g], threads, output);
+                if (r == 0 || stats.getSeconds() < best.getSeconds()) {
+                    best = stats;
+                }
+            }
+            // Sanity check: splitting the groups between threads does not change the result.
+            if (! sameOutput(output, expected)) {
+                fprintf(stderr, "%s: %d threads disagree with 1 thread for groups of %zu rows\n",
+                        name, threads, groupSizes[g]);
+                return false;
+            }
+            printf("%-14s%10zu%8d%16.0f%10.2f%10.0f%8.0f%8.0f%12zu%8zu\n", name, groupSizes[g], threads,
+                   best.getRowsPerSecond(), best.getNanosecondsPerRow(), best.aggregateSeconds * 1e3,
+                   best.combineSeconds * 1e3, best.terminateSeconds * 1e3, best.allocations,
+                   best.udxAllocations);
+        }
+    }
+    return true;
+}
+
+// Checks the sum of a NUMERIC(18, s) column, one word per value, against a 128-bit reference.
+static bool checkWideSum(const char *name, UDXFactory *factory, Column &column) {
+    SizedColumnTypes argTypes;
+    argTypes.addArg(column.getType());
+    AggregateRunner runner(*dynamic_cast<AggregateFunctionFactory *>(factory), argTypes);
+    Column output(runner.getReturnType(), 1);
+    runner.run(column, column.size(), 1, output);
+    __int128 expected = 0;
+    for (size_t i = 0; i < column.size(); i++) {
+        expected += column.getInt(i);
+    }
+    const uint64 *words = reinterpret_cast<const uint64 *>(output.getSlot(0));
+    __int128 actual = static_cast<__int128>((static_cast<unsigned __int128>(words[0]) << 64) | words[1]);
+    if (actual != expected) {
+        fprintf(stderr, "%s: wrong sum\n", name);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    int rows = argc > 1 ? atoi(argv[1]) : 20000000;
+    int repeats = argc > 2 ? atoi(argv[2]) : 5;
+    int maxThreads = argc > 3 ? atoi(argv[3]) : 4;
+    if (rows <= 0 || repeats <= 0 || maxThreads <= 0) {
+        fprintf(stderr, "Usage: %s [rows] [repeats] [threads]\n", argv[0]);
+        return 1;
+    }
+
+    Column column(VerticaType(Float8OID, -1), rows);
+    srand(42);
+    for (int i = 0; i < rows; i++) {
+        column.setFloat(i, rand() % 100);
+    }
+
+    std::vector<Method> methods;
+    methods.push_back(ROW_ITERATOR);
+    methods.push_back(BLOCK_SCALAR);
+    if (SumWithNullKernel::hasAVX2()) {
+        methods.push_back(BLOCK_AVX2);
+    }
+
+    // Sanity check: every method agrees on the sum and on NULL poisoning.
+    vfloat expected = runOnce(ROW_ITERATOR, column, rows);
+    for (size_t m = 0; m < methods.size(); m++) {
+        vfloat actual = runOnce(methods[m], column, rows);
+        if (fabs(actual - expected) > 1e-9 * fabs(expected)) {
+            fprintf(stderr, "%s: sum mismatch %f vs %f\n", methodName(methods[m]), actual, expected);
+            return 1;
+        }
+        vfloat saved = column.getFloat(rows / 2);
+        column.setFloat(rows / 2, vfloat_null);
+        bool poisoned = vfloatIsNull(runOnce(methods[m], column, rows));
+        column.setFloat(rows / 2, saved);
+        if (! poisoned) {
+            fprintf(stderr, "%s: NULL input did not poison the sum\n", methodName(methods[m]));
+            return 1;
+        }
+    }
+
+    // Sanity check: the exact sum only rounds once, at the end.
+    const vfloat cancelling[] = {1e300, 1.0, 3e-320, -1e300, 0x1p-1074, -INFINITY};
+    uint64 words[ExactSum::WORD_COUNT] = {0};
+    vint flags = 0;
+    for (int i = 0; i < 5; i++) {
+        ExactSum::add(words, flags, cancelling[i]);
+    }
+    if (ExactSum::toFloat(words, flags) != 1.0 || ExactSum::toFloat(words, flags | ExactSum::SEEN_NAN) == 1.0) {
+        fprintf(stderr, "ExactSum: wrong sum %.17g\n", ExactSum::toFloat(words, flags));
+        return 1;
+    }
+    ExactSum::add(words, flags, -1.0);
+    ExactSum::add(words, flags, -0x1p-1074);
+    if (ExactSum::toFloat(words, flags) != 3e-320) {
+        fprintf(stderr, "ExactSum: wrong subnormal sum %.17g\n", ExactSum::toFloat(words, flags));
+        return 1;
+    }
+    ExactSum::add(words, flags, cancelling[5]);
+    if (ExactSum::toFloat(words, flags) != -INFINITY) {
+        fprintf(stderr, "ExactSum: an infinity did not win over the finite sum\n");
+        return 1;
+    }
+
+    printf("%d rows, best of %d runs\n", rows, repeats);
+    printf("%10s  %-14s%16s%10s\n", "group size", "method", "rows/sec", "speedup");
+    const int groupSizes[] = {16, 256, 4096, rows};
+    for (size_t g = 0; g < sizeof(groupSizes) / sizeof(groupSizes[0]); g++) {
+        double baseline = 0;
+        for (size_t m = 0; m < methods.size(); m++) {
+            double best = 1e30;
+            volatile vfloat sink = 0;
+            for (int r = 0; r < repeats; r++) {
+                double start = UDxHarness::now();
+                sink = sink + runOnce(methods[m], column, groupSizes[g]);
+                double elapsed = UDxHarness::now() - start;
+                if (elapsed < best) {
+                    best = elapsed;
+                }
+            }
+            double rowsPerSec = rows / best;
+            if (m == 0) {
+                baseline = rowsPerSec;
+            }
+            printf("%10d  %-14s%16.0f%9.2fx\n", groupSizes[g], methodName(methods[m]),
+                   rowsPerSec, rowsPerSec / baseline);
+        }
+    }
+
+    printf("\nUDxs run through the harness, best of %d runs (times in ms)\n", repeats);
+    printf("%-14s%10s%8s%16s%10s%10s%8s%8s%12s%8s\n", "function", "group size", "threads", "rows/sec",
+           "ns/row", "aggregate", "combine", "term.", "allocations", "udx");
+    if (! benchUDx("SUMNULL", getSumWithNullFactory(), column, maxThreads, repeats) ||
+            ! benchUDx("SUMNULL_EXACT", getSumWithNullExactFactory(), column, maxThreads, repeats) ||
+            ! benchUDx("CUBE_MEASURE", getCubeMeasureFactory(), column, maxThreads, repeats)) {
+        return 1;
+    }
+
+    // Plain floating point sums of these depend on the order they are added in.
+    Column wide(VerticaType(Float8OID, -1), rows);
+    for (int i = 0; i < rows; i++) {
+        wide.setFloat(i, ldexp(rand() / (double) RAND_MAX - 0.5, rand() % 120 - 60));
+    }
+    if (! benchUDx("SUMNULL_EXACT", getSumWithNullExactFactory(), wide, maxThreads, repeats)) {
+        return 1;
+    }
+
+    // The NUMERIC(18, 2) values are large enough for their sums to need more than 64 bits,
+    // the INTEGER sums have to fit back in an INTEGER, so no INTEGER value exceeds INT64_MAX / rows.
+    Column integers(VerticaType(Int8OID, -1), rows);
+    Column numerics(VerticaType(NumericOID, VerticaType::makeNumericTypeMod(18, 2)), rows);
+    const vint integerBound = INT64_MAX / rows;
+    for (int i = 0; i < rows; i++) {
+        vint value = (static_cast<vint>(rand()) << 32 | rand()) % 999999999999999999LL;
+        integers.setInt(i, value % integerBound);
+        numerics.setInt(i, value);
+    }
+    if (! benchUDx("SUMNULL(INT)", getSumWithNullIntegerFactory(), integers, maxThreads, repeats) ||
+            ! benchUDx("SUMNULL(NUM)", getSumWithNullNumericFactory(), numerics, maxThreads, repeats) ||
+            ! checkWideSum("SUMNULL(NUMERIC)", getSumWithNullNumericFactory(), numerics)) {
+        return 1;
+    }
+    return 0;
+}
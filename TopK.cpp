@@ -0,0 +1,131 @@
+#include "Vertica.h"
+#include "GroupKey.h"
+#include <algorithm>
+#include <queue>
+#include <string>
+#include <vector>
+
+using namespace Vertica;
+
+/*
+ * TOP_K(c1, ..., cN, m USING PARAMETERS k=K) OVER (PARTITION BY ...)
+ *
+ * Emits the K rows with the largest m of every partition, largest first,
+ * in one pass and with a bounded min-heap of K rows per partition. The
+ * columns are passed through with their input types and names, NULL values
+ * of m rank below everything else.
+ */
+class TopK : public TransformFunction
+{
+    struct Entry {
+        Entry(vfloat value, const std::string &row) : value(value), row(row) { }
+        vfloat value;
+        std::string row;
+    };
+
+    // NULL ranks lowest, so the heap's top is the first row to evict.
+    struct RanksHigher {
+        bool operator()(const Entry &a, const Entry &b) const {
+            if (vfloatIsNull(a.value)) {
+                return false;
+            }
+            return vfloatIsNull(b.value) || a.value > b.value;
+        }
+    };
+
+    typedef std::priority_queue<Entry, std::vector<Entry>, RanksHigher> MinHeap;
+
+    virtual void setup(ServerInterface &srvInterface, const SizedColumnTypes &argTypes)
+    {
+        ParamReader params = srvInterface.getParamReader();
+        m_k = params.containsParameter("k") ? params.getIntRef("k") : 0;
+        if (m_k <= 0) {
+            vt_report_error(0, "TOP_K expects a positive k parameter");
+        }
+    }
+
+    virtual void processPartition(ServerInterface &srvInterface,
+                                  PartitionReader &inputReader,
+                                  PartitionWriter &outputWriter)
+    {
+        try {
+            size_t measureIdx = inputReader.getNumCols() - 1;
+            MinHeap heap;
+            RanksHigher ranksHigher;
+            std::string row;
+            do {
+                const vfloat &value = inputReader.getFloatRef(measureIdx);
+                // Only serialize the row if it makes it into the heap.
+                if (static_cast<vint>(heap.size()) == m_k) {
+                    if (! ranksHigher(Entry(value, std::string()), heap.top())) {
+                        continue;
+                    }
+                    heap.pop();
+                }
+                row.clear();
+                GroupKey::appendColumns(row, inputReader, 0, measureIdx);
+                heap.push(Entry(value, row));
+            } while (inputReader.next());
+
+            std::vector<Entry> result;
+            result.reserve(heap.size());
+            while (! heap.empty()) {
+                result.push_back(heap.top());
+                heap.pop();
+            }
+            for (std::vector<Entry>::reverse_iterator it = result.rbegin(); it != result.rend(); ++it) {
+                GroupKey::writeColumns(it->row, outputWriter, 0, measureIdx);
+                outputWriter.setFloat(measureIdx, it->value);
+                outputWriter.next();
+            }
+        } catch (std::exception &e) {
+            // Standard exception. Quit.
+            vt_report_error(0, "Exception while processing partition: [%s]", e.what());
+        }
+    }
+
+    vint m_k;
+};
+
+
+/*
+ * This class provides the meta-data associated with the transform function
+ * shown above, as well as a way of instantiating objects of the class.
+ */
+class TopKFactory : public TransformFunctionFactory
+{
+    virtual void getPrototype(ServerInterface &srvInterface,
+                              ColumnTypes &argTypes,
+                              ColumnTypes &returnType)
+    {
+        argTypes.addAny();
+        returnType.addAny();
+    }
+
+    // Every input column is passed through, the last one is the FLOAT to rank on.
+    virtual void getReturnType(ServerInterface &srvInterface,
+                               const SizedColumnTypes &inputTypes,
+                               SizedColumnTypes &outputTypes)
+    {
+        size_t columnCount = inputTypes.getColumnCount();
+        if (columnCount < 1 || ! inputTypes.getColumnType(columnCount - 1).isFloat()) {
+            vt_report_error(0, "TOP_K expects its last argument to be a FLOAT");
+        }
+        for (size_t i = 0; i < columnCount; i++) {
+            outputTypes.addArg(inputTypes.getColumnType(i), inputTypes.getColumnName(i));
+        }
+    }
+
+    virtual void getParameterType(ServerInterface &srvInterface,
+                                  SizedColumnTypes &parameterTypes)
+    {
+        parameterTypes.addInt("k");
+    }
+
+    // Create an instance of the TransformFunction
+    virtual TransformFunction *createTransformFunction(ServerInterface &srvInterface)
+    { return vt_createFuncObject<TopK>(srvInterface.allocator); }
+
+};
+
+RegisterFactory(TopKFactory);
@@ -0,0 +1,353 @@
+/*
+ * Local behavior checks for the transform UDxs.
+ *
+ * Runs PCT_OF_TOTAL, PERCENTAGE_CUBE (both phases, over several segments),
+ * TOP_K and DICT_ENCODE through the UDxHarness TransformRunner, in blocks of
+ * a few rows so that every partition spans several blocks, and compares
+ * their output with hand-computed rows:
+ *
+ *   PCT_OF_TOTAL    - NULL groups are kept, a group of only NULLs is NULL,
+ *                     sumnull poisons the total, rowcount drops the groups.
+ *   PERCENTAGE_CUBE - the canonical and the permuted label sets, and the
+ *                     (col1 | col2) split agrees with PCT_OF_TOTAL whatever
+ *                     the parameters.
+ *   TOP_K           - k rows out of ties, NULLs rank last.
+ *   DICT_ENCODE     - the codes do not depend on the input order, and the
+ *                     codes already handed out never change.
+ *
+ * Usage: ./TransformCheck
+ */
+#include "Vertica.h"
+#include "UDxHarness.h"
+#include <algorithm>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+using namespace Vertica;
+using UDxHarness::Column;
+using UDxHarness::HarnessParams;
+using UDxHarness::TransformRunner;
+
+extern "C" UDXFactory *getPctOfTotalFactory();
+extern "C" UDXFactory *getPercentageCubeFactory();
+extern "C" UDXFactory *getTopKFactory();
+extern "C" UDXFactory *getDictEncodeFactory();
+
+// Small enough for every partition to span several blocks.
+static const int BLOCK_ROWS = 2;
+
+static const int STRING_LENGTH = 8;
+
+// One row of the fact table T (col1 INTEGER, col2 VARCHAR, measure FLOAT), a NULL col2 pointer is a NULL.
+struct Fact {
+    vint col1;
+    const char *col2;
+    vfloat measure;
+};
+
+static SizedColumnTypes factTypes() {
+    SizedColumnTypes retval;
+    retval.addInt("col1");
+    retval.addVarchar(STRING_LENGTH, "col2");
+    retval.addFloat("measure");
+    return retval;
+}
+
+static std::vector<Column> factColumns(const Fact *facts, size_t count) {
+    SizedColumnTypes types = factTypes();
+    std::vector<Column> retval;
+    for (size_t i = 0; i < types.getColumnCount(); i++) {
+        retval.push_back(Column(types.getColumnType(i), count));
+    }
+    for (size_t i = 0; i < count; i++) {
+        retval[0].setInt(i, facts[i].col1);
+        if (facts[i].col2 == NULL) {
+            retval[1].setNullString(i);
+        }
+        else {
+            retval[1].setString(i, facts[i].col2);
+        }
+        retval[2].setFloat(i, facts[i].measure);
+    }
+    return retval;
+}
+
+static std::string formatValue(const Column &column, size_t row) {
+    char buffer[32];
+    switch (column.getType().getTypeOid()) {
+    case Int8OID:
+        if (column.getInt(row) == vint_null) {
+            return "NULL";
+        }
+        snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(column.getInt(row)));
+        return buffer;
+    case Float8OID:
+        if (vfloatIsNull(column.getFloat(row))) {
+            return "NULL";
+        }
+        snprintf(buffer, sizeof(buffer), "%g", column.getFloat(row));
+        return buffer;
+    default:
+        return column.isNullString(row) ? "NULL" : column.getString(row);
+    }
+}
+
+// Every row as its values separated by '|'.
+static std::vector<std::string> formatRows(const std::vector<Column> &columns) {
+    std::vector<std::string> retval(columns.empty() ? 0 : columns[0].size());
+    for (size_t row = 0; row < retval.size(); row++) {
+        for (size_t i = 0; i < columns.size(); i++) {
+            retval[row] += (i > 0 ? "|" : "") + formatValue(columns[i], row);
+        }
+    }
+    return retval;
+}
+
+static std::vector<std::string> sorted(std::vector<std::string> rows) {
+    std::sort(rows.begin(), rows.end());
+    return rows;
+}
+
+static bool check(const char *name, const std::vector<std::string> &actual,
+                  const std::vector<std::string> &expected) {
+    if (actual == expected) {
+        printf("%-60s ok\n", name);
+        return true;
+    }
+    fprintf(stderr, "%s: expected %zu rows, got %zu\n", name, expected.size(), actual.size());
+    for (size_t i = 0; i < std::max(actual.size(), expected.size()); i++) {
+        fprintf(stderr, "  %-30s %s\n", i < expected.size() ? expected[i].c_str() : "",
+                i < actual.size() ? actual[i].c_str() : "");
+    }
+    return false;
+}
+
+static std::vector<std::string> runPctOfTotal(const std::vector<Column> &facts, const HarnessParams &params) {
+    TransformRunner runner(*dynamic_cast<TransformFunctionFactory *>(getPctOfTotalFactory()), factTypes(),
+                           params);
+    std::vector<Column> output;
+    runner.run(facts, std::vector<size_t>(1, 0), output, BLOCK_ROWS);
+    return formatRows(output);
+}
+
+static std::vector<std::string> runPercentageCube(const std::vector<Column> &facts, size_t segmentCount,
+                                                  const HarnessParams &params) {
+    TransformRunner runner(*dynamic_cast<MultiPhaseTransformFunctionFactory *>(getPercentageCubeFactory()),
+                           factTypes(), params);
+    std::vector<Column> output;
+    runner.runSegmented(facts, segmentCount, output, BLOCK_ROWS);
+    return formatRows(output);
+}
+
+// The rows of one (total by, break down by) split, without the labels.
+static std::vector<std::string> getSplit(const std::vector<std::string> &rows, const std::string &totalBy,
+                                         const std::string &breakdownBy) {
+    std::string prefix = totalBy + "|" + breakdownBy + "|";
+    std::vector<std::string> retval;
+    for (size_t i = 0; i < rows.size(); i++) {
+        if (rows[i].compare(0, prefix.size(), prefix) == 0) {
+            retval.push_back(rows[i].substr(prefix.size()));
+        }
+    }
+    return retval;
+}
+
+// PARTITION BY col1 ORDER BY col2, the rows come sorted that way.
+static bool checkPctOfTotal() {
+    const Fact facts[] = {
+        {1, "a", 10}, {1, "b", vfloat_null}, {1, "b", vfloat_null}, {1, "c", 30},
+        {2, NULL, 10}, {2, "a", 5}, {2, "a", 5},
+    };
+    std::vector<Column> columns = factColumns(facts, sizeof(facts) / sizeof(facts[0]));
+
+    HarnessParams sum;
+    const char *sumRows[] = {"1|a|0.25", "1|b|NULL", "1|c|0.75", "2|NULL|0.5", "2|a|0.5"};
+    HarnessParams sumNull;
+    sumNull.addBool("sumnull", true);
+    const char *sumNullRows[] = {"1|a|NULL", "1|b|NULL", "1|c|NULL", "2|NULL|0.5", "2|a|0.5"};
+    HarnessParams rowCount;
+    rowCount.addInt("rowcount", 1);
+    const char *rowCountRows[] = {"1|b|NULL", "2|a|0.5"};
+    return check("PCT_OF_TOTAL: NULL groups, a group of NULLs is NULL", runPctOfTotal(columns, sum),
+                 std::vector<std::string>(sumRows, sumRows + 5)) &&
+           check("PCT_OF_TOTAL: sumnull", runPctOfTotal(columns, sumNull),
+                 std::vector<std::string>(sumNullRows, sumNullRows + 5)) &&
+           check("PCT_OF_TOTAL: rowcount", runPctOfTotal(columns, rowCount),
+                 std::vector<std::string>(rowCountRows, rowCountRows + 2));
+}
+
+static bool checkPercentageCube() {
+    const Fact facts[] = {{1, "x", 10}, {2, "x", 20}, {1, "y", 30}, {2, NULL, 40}};
+    std::vector<Column> columns = factColumns(facts, sizeof(facts) / sizeof(facts[0]));
+
+    // The NULL col2 group is kept, its rows look like the rows of the cuboids without col2.
+    const char *canonicalRows[] = {
+        "|col1|1|NULL|0.4", "|col1|2|NULL|0.6",
+        "|col2|NULL|NULL|0.4", "|col2|NULL|x|0.3", "|col2|NULL|y|0.3",
+        "|col1,col2|1|x|0.1", "|col1,col2|1|y|0.3", "|col1,col2|2|NULL|0.4", "|col1,col2|2|x|0.2",
+        "col1|col2|1|x|0.25", "col1|col2|1|y|0.75", "col1|col2|2|NULL|0.666667", "col1|col2|2|x|0.333333",
+        "col2|col1|1|x|0.333333", "col2|col1|1|y|1", "col2|col1|2|NULL|1", "col2|col1|2|x|0.666667",
+    };
+    std::vector<std::string> expected(canonicalRows, canonicalRows + sizeof(canonicalRows) / sizeof(canonicalRows[0]));
+    HarnessParams canonical;
+    canonical.addBool("canonical", true);
+    std::vector<std::string> canonicalOutput = sorted(runPercentageCube(columns, 3, canonical));
+    if (! check("PERCENTAGE_CUBE: canonical", canonicalOutput, sorted(expected))) {
+        return false;
+    }
+
+    // Every order of the break down by labels too, the canonical rows are among them.
+    const char *permutedRows[] = {
+        "|col2,col1|1|x|0.1", "|col2,col1|1|y|0.3", "|col2,col1|2|NULL|0.4", "|col2,col1|2|x|0.2",
+    };
+    expected.insert(expected.end(), permutedRows, permutedRows + 4);
+    HarnessParams permuted;
+    if (! check("PERCENTAGE_CUBE: every permutation", sorted(runPercentageCube(columns, 3, permuted)),
+                sorted(expected))) {
+        return false;
+    }
+
+    // A segment per row, or one for all the rows, merges into the same cube.
+    return check("PERCENTAGE_CUBE: one segment", sorted(runPercentageCube(columns, 1, canonical)),
+                 canonicalOutput) &&
+           check("PERCENTAGE_CUBE: a segment per row", sorted(runPercentageCube(columns, 4, canonical)),
+                 canonicalOutput);
+}
+
+// The (col1 | col2) split of the cube is PCT_OF_TOTAL PARTITION BY col1 of the col2 groups.
+static bool checkCubeAgreesWithPctOfTotal() {
+    const Fact facts[] = {
+        {1, NULL, 5}, {1, "a", 10}, {1, "a", vfloat_null}, {1, "b", 20},
+        {2, "a", vfloat_null}, {2, "a", vfloat_null}, {2, "b", 4}, {2, "b", 6}, {2, "c", 10},
+        {3, "a", 0}, {3, "b", 0},
+    };
+    std::vector<Column> columns = factColumns(facts, sizeof(facts) / sizeof(facts[0]));
+
+    std::vector<HarnessParams> params(4);
+    params[1].addBool("sumnull", true);
+    params[2].addInt("rowcount", 1);
+    params[3].addBool("sumnull", true);
+    params[3].addInt("rowcount", 1);
+    const char *names[] = {
+        "PERCENTAGE_CUBE agrees with PCT_OF_TOTAL",
+        "PERCENTAGE_CUBE agrees with PCT_OF_TOTAL: sumnull",
+        "PERCENTAGE_CUBE agrees with PCT_OF_TOTAL: rowcount",
+        "PERCENTAGE_CUBE agrees with PCT_OF_TOTAL: sumnull, rowcount",
+    };
+    for (size_t i = 0; i < params.size(); i++) {
+        std::vector<std::string> pctOfTotal = runPctOfTotal(columns, params[i]);
+        params[i].addBool("canonical", true);
+        std::vector<std::string> cube = getSplit(runPercentageCube(columns, 3, params[i]), "col1", "col2");
+        if (! check(names[i], sorted(cube), sorted(pctOfTotal))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// rows[i] if it is one of the choices, so that check() only reports the other rows.
+static std::string oneOf(const std::vector<std::string> &rows, size_t i, const char *const *choices, size_t count) {
+    std::string retval = "one of";
+    for (size_t c = 0; c < count; c++) {
+        if (i < rows.size() && rows[i] == choices[c]) {
+            return rows[i];
+        }
+        retval += std::string(" ") + choices[c];
+    }
+    return retval;
+}
+
+// PARTITION BY col1, the rank is on the measure.
+static bool checkTopK() {
+    const Fact facts[] = {
+        {1, "a", 5}, {1, "b", vfloat_null}, {1, "c", 7}, {1, "d", 7}, {1, "e", 7}, {1, "f", 3},
+        {2, "a", vfloat_null}, {2, "b", 1}, {2, "c", vfloat_null},
+        {3, "a", vfloat_null},
+    };
+    std::vector<Column> columns = factColumns(facts, sizeof(facts) / sizeof(facts[0]));
+    HarnessParams params;
+    params.addInt("k", 2);
+    TransformRunner runner(*dynamic_cast<TransformFunctionFactory *>(getTopKFactory()), factTypes(), params);
+    std::vector<Column> output;
+    runner.run(columns, std::vector<size_t>(1, 0), output, BLOCK_ROWS);
+    std::vector<std::string> rows = formatRows(output);
+
+    // Which two of the rows tied at 7 make it is up to the UDx, and which of the two NULLs.
+    const char *tied[] = {"1|c|7", "1|d|7", "1|e|7"};
+    const char *nulls[] = {"2|a|NULL", "2|c|NULL"};
+    std::vector<std::string> expected;
+    expected.push_back(oneOf(rows, 0, tied, 3));
+    expected.push_back(rows.size() > 1 && rows[1] == rows[0] ? "another row tied at 7" : oneOf(rows, 1, tied, 3));
+    expected.push_back("2|b|1");
+    expected.push_back(oneOf(rows, 3, nulls, 2));
+    expected.push_back("3|a|NULL");
+    return check("TOP_K: k rows out of ties, NULLs last", rows, expected);
+}
+
+struct Entry {
+    vint code;
+    const char *value;
+};
+
+static std::vector<std::string> runDictEncode(const Entry *entries, size_t count) {
+    SizedColumnTypes types;
+    types.addInt("code");
+    types.addVarchar(STRING_LENGTH, "value");
+    std::vector<Column> columns;
+    columns.push_back(Column(types.getColumnType(0), count));
+    columns.push_back(Column(types.getColumnType(1), count));
+    for (size_t i = 0; i < count; i++) {
+        columns[0].setInt(i, entries[i].code);
+        if (entries[i].value == NULL) {
+            columns[1].setNullString(i);
+        }
+        else {
+            columns[1].setString(i, entries[i].value);
+        }
+    }
+    TransformRunner runner(*dynamic_cast<TransformFunctionFactory *>(getDictEncodeFactory()), types);
+    std::vector<Column> output;
+    runner.run(columns, std::vector<size_t>(), output, BLOCK_ROWS);
+    return formatRows(output);
+}
+
+static bool checkDictEncode() {
+    const Entry first[] = {{vint_null, "b"}, {vint_null, "a"}, {vint_null, NULL}, {vint_null, "c"}, {vint_null, "a"}};
+    const Entry reordered[] = {{vint_null, "c"}, {vint_null, "a"}, {vint_null, "a"}, {vint_null, NULL}, {vint_null, "b"}};
+    const char *firstCodes[] = {"1|a", "2|b", "3|c"};
+    std::vector<std::string> expected(firstCodes, firstCodes + 3);
+    if (! check("DICT_ENCODE: dense codes in byte order", runDictEncode(first, 5), expected) ||
+            ! check("DICT_ENCODE: the codes do not depend on the input order", runDictEncode(reordered, 5),
+                    expected)) {
+        return false;
+    }
+
+    // The dictionary rows come in any order, mixed with the candidates.
+    const Entry second[] = {
+        {vint_null, "d"}, {2, "b"}, {vint_null, "a"}, {vint_null, NULL}, {3, "c"},
+        {vint_null, "b"}, {1, "a"}, {vint_null, "aa"},
+    };
+    const Entry secondReordered[] = {
+        {1, "a"}, {vint_null, "aa"}, {vint_null, "b"}, {3, "c"}, {vint_null, NULL},
+        {vint_null, "d"}, {vint_null, "a"}, {2, "b"},
+    };
+    const char *secondCodes[] = {"4|aa", "5|d"};
+    expected.assign(secondCodes, secondCodes + 2);
+    return check("DICT_ENCODE: only the new values, after the largest code", runDictEncode(second, 8), expected) &&
+           check("DICT_ENCODE: the new codes do not depend on the input order", runDictEncode(secondReordered, 8),
+                 expected);
+}
+
+int main(int argc, char **argv) {
+    try {
+        if (! checkPctOfTotal() || ! checkPercentageCube() || ! checkCubeAgreesWithPctOfTotal() ||
+                ! checkTopK() || ! checkDictEncode()) {
+            return 1;
+        }
+    } catch (std::exception &e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
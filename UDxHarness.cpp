@@ -0,0 +1,661 @@
+#include "UDxHarness.h"
+#include "GroupKey.h"
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <stdarg.h>
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <time.h>
+#include <unordered_map>
+
+// Defined in Vertica.cpp, the server calls it when it loads a UDx library.
+extern "C" void setup_global_function_pointers(VT_THROW_EXCEPTION throw_exception,
+                                               VT_THROW_INTERNAL_EXCEPTION throw_internal_exception,
+                                               VT_ERRMSG server_errmsg, ServerFunctions *fns);
+
+static std::atomic<size_t> allocationCount(0);
+
+// The operators are kept out of line, so that g++ does not see free() of a pointer from operator new.
+
+__attribute__((noinline))
+void *operator new(size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    void *retval = malloc(size == 0 ? 1 : size);
+    if (retval == NULL) {
+        throw std::bad_alloc();
+    }
+    return retval;
+}
+
+__attribute__((noinline))
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+__attribute__((noinline))
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+__attribute__((noinline))
+void operator delete[](void *p) noexcept
+{
+    free(p);
+}
+
+__attribute__((noinline))
+void operator delete(void *p, size_t size) noexcept
+{
+    free(p);
+}
+
+__attribute__((noinline))
+void operator delete[](void *p, size_t size) noexcept
+{
+    free(p);
+}
+
+namespace UDxHarness {
+
+// vt_report_error() and ereport() end up here, as a plain exception.
+static void throwException(int errcode, const std::string &message, const char *filename, int lineno)
+{
+    throw std::runtime_error(message);
+}
+
+static void throwInternalException(int errcode, const std::string &message, const std::string &info,
+                                   const char *filename, int lineno, const char *funcname)
+{
+    throw std::runtime_error(message);
+}
+
+static struct ErrorHandlers {
+    ErrorHandlers() { setup_global_function_pointers(throwException, throwInternalException, NULL, NULL); }
+} errorHandlers;
+
+static void logToStderr(ServerInterface *srvInterface, const char *format, va_list ap)
+{
+    vfprintf(stderr, format, ap);
+    fputc('\n', stderr);
+}
+
+static int getSlotSize(const VerticaType &type)
+{
+    return (type.getMaxSize() + 7) & ~7;
+}
+
+size_t getAllocationCount()
+{
+    return allocationCount.load(std::memory_order_relaxed);
+}
+
+double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+HarnessAllocator::~HarnessAllocator()
+{
+    for (size_t i = 0; i < m_blocks.size(); i++) {
+        free(m_blocks[i]);
+    }
+}
+
+void *HarnessAllocator::alloc(size_t size)
+{
+    void *retval = malloc(size == 0 ? 1 : size);
+    if (retval == NULL) {
+        throw std::bad_alloc();
+    }
+    m_blocks.push_back(retval);
+    m_allocationCount++;
+    return retval;
+}
+
+// The allocator is only handed out once both are constructed.
+HarnessServerInterface::HarnessServerInterface(const ParamReader &params)
+    : ServerInterface(&m_allocator, logToStderr, "UDxHarness", params)
+{
+}
+
+Column::Column(const VerticaType &type, size_t rows)
+    : m_type(type), m_rows(rows), m_stride(getSlotSize(type)), m_data(rows * m_stride)
+{
+}
+
+Column Column::floats(const std::vector<vfloat> &values)
+{
+    Column retval(VerticaType(Float8OID, -1), values.size());
+    for (size_t i = 0; i < values.size(); i++) {
+        retval.setFloat(i, values[i]);
+    }
+    return retval;
+}
+
+Column Column::ints(const std::vector<vint> &values)
+{
+    Column retval(VerticaType(Int8OID, -1), values.size());
+    for (size_t i = 0; i < values.size(); i++) {
+        retval.setInt(i, values[i]);
+    }
+    return retval;
+}
+
+Column Column::varchars(const std::vector<std::string> &values, int maxLength)
+{
+    Column retval(VerticaType(VarcharOID, maxLength + VARHDRSZ), values.size());
+    for (size_t i = 0; i < values.size(); i++) {
+        retval.setString(i, values[i]);
+    }
+    return retval;
+}
+
+bool Column::isNullString(size_t row) const
+{
+    return EE::isNullSV(getSlot(row));
+}
+
+std::string Column::getString(size_t row) const
+{
+    const char *slot = getSlot(row);
+    if (EE::isNullSV(slot)) {
+        return std::string();
+    }
+    return std::string(EE::cvalueSV(slot), EE::lenSV(slot));
+}
+
+// Strings are stored inline, right after the StringValue header.
+void Column::setString(size_t row, const std::string &value)
+{
+    if (value.size() > static_cast<size_t>(m_type.getStringLength(false))) {
+        vt_report_error(0, "String of %zu bytes does not fit in %s", value.size(), m_type.getTypeStr());
+    }
+    EE::setSV(getSlot(row), OutDA, value.data(), value.size());
+}
+
+void Column::setNullString(size_t row)
+{
+    EE::setNullSV(getSlot(row));
+}
+
+// Strings are inline, so the slots are copied as they are.
+void Column::append(const Column &other, size_t firstRow, size_t rowCount)
+{
+    if (other.m_type.getTypeOid() != m_type.getTypeOid() || other.m_stride != m_stride) {
+        vt_report_error(0, "Cannot append %s rows to %s rows", other.m_type.getTypeStr(), m_type.getTypeStr());
+    }
+    m_data.insert(m_data.end(), other.getSlot(firstRow), other.getSlot(firstRow) + rowCount * m_stride);
+    m_rows += rowCount;
+}
+
+ColumnReader::ColumnReader(std::vector<Column *> &columns, size_t firstRow, int rowCount)
+    : BlockReader(0, rowCount, NULL)
+{
+    for (size_t i = 0; i < columns.size(); i++) {
+        addCol(columns[i]->getSlot(firstRow), columns[i]->getStride(), columns[i]->getType());
+    }
+}
+
+TupleLayout::TupleLayout(const SizedColumnTypes &types) : types(types), size(0)
+{
+    for (size_t i = 0; i < types.getColumnCount(); i++) {
+        offsets.push_back(size);
+        size += getSlotSize(types.getColumnType(i));
+    }
+}
+
+TupleAggs::TupleAggs(const TupleLayout &layout, char *tuple)
+    : IntermediateAggs(layout.offsets.size()), m_layout(layout)
+{
+    for (size_t i = 0; i < layout.offsets.size(); i++) {
+        addCol(tuple + layout.offsets[i], layout.size, layout.types.getColumnType(i));
+    }
+}
+
+void TupleAggs::setTuple(char *tuple)
+{
+    for (size_t i = 0; i < m_layout.offsets.size(); i++) {
+        cols[i] = tuple + m_layout.offsets[i];
+    }
+}
+
+TupleRows::TupleRows(const TupleLayout &layout, char *firstTuple, int count)
+    : MultipleIntermediateAggs(layout.offsets.size())
+{
+    for (size_t i = 0; i < layout.offsets.size(); i++) {
+        addCol(firstTuple + layout.offsets[i], layout.size, layout.types.getColumnType(i));
+    }
+    this->count = count;
+    nrows = count;
+}
+
+static SizedColumnTypes describeIntermediate(AggregateFunctionFactory &factory,
+                                             const SizedColumnTypes &argTypes,
+                                             const ParamReader &params)
+{
+    HarnessServerInterface srvInterface(params);
+    SizedColumnTypes retval;
+    factory.getIntermediateTypes(srvInterface, argTypes, retval);
+    return retval;
+}
+
+static VerticaType describeReturn(AggregateFunctionFactory &factory, const SizedColumnTypes &argTypes,
+                                 const ParamReader &params)
+{
+    HarnessServerInterface srvInterface(params);
+    SizedColumnTypes returnTypes;
+    factory.getReturnType(srvInterface, argTypes, returnTypes);
+    if (returnTypes.getColumnCount() != 1) {
+        vt_report_error(0, "An aggregate returns one column, not %zu", returnTypes.getColumnCount());
+    }
+    return returnTypes.getColumnType(0);
+}
+
+AggregateRunner::AggregateRunner(AggregateFunctionFactory &factory, const SizedColumnTypes &argTypes,
+                                 const ParamReader &params)
+    : m_factory(factory), m_argTypes(argTypes), m_params(params),
+      m_layout(describeIntermediate(factory, argTypes, params)),
+      m_returnType(describeReturn(factory, argTypes, params))
+{
+}
+
+// One function object per slice, as the server has one per thread.
+void AggregateRunner::aggregateSlice(Column &input, size_t firstRow, size_t lastRow, size_t groupSize,
+                                     int blockRows, std::vector<char> &tuples, size_t &udxAllocations)
+{
+    HarnessServerInterface srvInterface(m_params);
+    AggregateFunction *function = m_factory.createAggregateFunction(srvInterface);
+    function->setup(srvInterface, m_argTypes);
+
+    size_t firstGroup = firstRow / groupSize;
+    size_t groupCount = (lastRow - 1) / groupSize + 1 - firstGroup;
+    tuples.assign(groupCount * m_layout.size, 0);
+    TupleAggs intAggs(m_layout, &tuples[0]);
+    for (size_t g = 0; g < groupCount; g++) {
+        intAggs.setTuple(&tuples[g * m_layout.size]);
+        function->initAggregate(srvInterface, intAggs);
+    }
+
+    std::vector<Column *> columns(1, &input);
+    ColumnReader argReader(columns, firstRow, 0);
+    std::vector<int> intOffsets(m_layout.offsets);
+    std::vector<void *> dstTuples;
+    std::vector<vpos> rowCounts;
+    for (size_t start = firstRow; start < lastRow; start += blockRows) {
+        size_t end = std::min(lastRow, start + blockRows);
+        // A block holds the end of a group, whole groups, then the start of the next one.
+        dstTuples.clear();
+        rowCounts.clear();
+        for (size_t row = start; row < end; ) {
+            size_t group = row / groupSize;
+            size_t groupEnd = std::min(end, (group + 1) * groupSize);
+            dstTuples.push_back(&tuples[(group - firstGroup) * m_layout.size]);
+            rowCounts.push_back(groupEnd - row);
+            row = groupEnd;
+        }
+        function->aggregateArrs(srvInterface, &dstTuples[0], 0, input.getSlot(start), input.getStride(),
+                                &rowCounts[0], sizeof(vpos), dstTuples.size(), intAggs, intOffsets,
+                                argReader);
+    }
+
+    function->destroy(srvInterface, m_argTypes);
+    function->~AggregateFunction();
+    udxAllocations += srvInterface.getAllocator().getAllocationCount();
+}
+
+AggregateRunner::Stats AggregateRunner::run(Column &input, size_t groupSize, int threadCount,
+                                            Column &output, int blockRows)
+{
+    size_t rows = input.size();
+    if (rows == 0 || groupSize == 0 || threadCount <= 0 || blockRows <= 0) {
+        vt_report_error(0, "Nothing to aggregate");
+    }
+    size_t groupCount = (rows - 1) / groupSize + 1;
+    if (output.size() < groupCount || output.getType().getTypeOid() != m_returnType.getTypeOid() ||
+            output.getStride() < getSlotSize(m_returnType)) {
+        vt_report_error(0, "The output needs %zu rows of %s", groupCount, m_returnType.getTypeStr());
+    }
+
+    Stats stats;
+    stats.rows = rows;
+    size_t allocationsBefore = getAllocationCount();
+    double start = now();
+
+    // Slice t holds rows [rows * t / threadCount, rows * (t + 1) / threadCount), empty slices are dropped.
+    std::vector<size_t> sliceStarts;
+    for (int t = 0; t < threadCount; t++) {
+        size_t first = rows * t / threadCount;
+        if (first < rows * (t + 1) / threadCount) {
+            sliceStarts.push_back(first);
+        }
+    }
+    sliceStarts.push_back(rows);
+    size_t sliceCount = sliceStarts.size() - 1;
+    std::vector<std::vector<char> > tuples(sliceCount);
+    std::vector<size_t> udxAllocations(sliceCount, 0);
+    std::vector<std::string> errors(sliceCount);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < sliceCount; t++) {
+        threads.push_back(std::thread([&, t]() {
+            try {
+                aggregateSlice(input, sliceStarts[t], sliceStarts[t + 1], groupSize, blockRows,
+                               tuples[t], udxAllocations[t]);
+            } catch (std::exception &e) {
+                errors[t] = e.what();
+            }
+        }));
+    }
+    for (size_t t = 0; t < sliceCount; t++) {
+        threads[t].join();
+    }
+    for (size_t t = 0; t < sliceCount; t++) {
+        stats.udxAllocations += udxAllocations[t];
+        if (! errors[t].empty()) {
+            vt_report_error(0, "Exception while aggregating: [%s]", errors[t].c_str());
+        }
+    }
+    double aggregated = now();
+    stats.aggregateSeconds = aggregated - start;
+
+    HarnessServerInterface srvInterface(m_params);
+    AggregateFunction *function = m_factory.createAggregateFunction(srvInterface);
+    function->setup(srvInterface, m_argTypes);
+
+    // Only the groups cut by a slice boundary have several states, combined two by two.
+    std::vector<char *> states;
+    std::vector<char *> finalStates(groupCount);
+    size_t firstSlice = 0;
+    for (size_t g = 0; g < groupCount; g++) {
+        while ((sliceStarts[firstSlice + 1] - 1) / groupSize < g) {
+            firstSlice++;
+        }
+        states.clear();
+        for (size_t t = firstSlice; t < sliceCount && sliceStarts[t] / groupSize <= g; t++) {
+            states.push_back(&tuples[t][(g - sliceStarts[t] / groupSize) * m_layout.size]);
+        }
+        for (size_t step = 1; step < states.size(); step *= 2) {
+            for (size_t i = 0; i + step < states.size(); i += 2 * step) {
+                TupleAggs aggs(m_layout, states[i]);
+                TupleRows others(m_layout, states[i + step], 1);
+                function->combine(srvInterface, aggs, others);
+            }
+        }
+        finalStates[g] = states[0];
+    }
+    double combined = now();
+    stats.combineSeconds = combined - aggregated;
+
+    BlockWriter writer(output.getSlot(0), output.getStride(), groupCount, NULL, m_returnType);
+    TupleAggs aggs(m_layout, finalStates[0]);
+    for (size_t g = 0; g < groupCount; g++) {
+        aggs.setTuple(finalStates[g]);
+        function->terminate(srvInterface, writer, aggs);
+        writer.next();
+    }
+    stats.terminateSeconds = now() - combined;
+
+    function->destroy(srvInterface, m_argTypes);
+    function->~AggregateFunction();
+    stats.udxAllocations += srvInterface.getAllocator().getAllocationCount();
+    stats.allocations = getAllocationCount() - allocationsBefore;
+    return stats;
+}
+
+BlockStreamWriter::BlockStreamWriter(const SizedColumnTypes &types, int rowsPerBlock)
+    : StreamWriter(0, NULL)
+{
+    for (size_t i = 0; i < types.getColumnCount(); i++) {
+        m_columns.push_back(Column(types.getColumnType(i), rowsPerBlock));
+    }
+    for (size_t i = 0; i < m_columns.size(); i++) {
+        addCol(m_columns[i].getSlot(0), m_columns[i].getStride(), m_columns[i].getType());
+    }
+    count = rowsPerBlock;
+}
+
+bool BlockStreamWriter::flush()
+{
+    consumeBlock(m_columns, index);
+    for (size_t i = 0; i < m_columns.size(); i++) {
+        cols[i] = m_columns[i].getSlot(0);
+    }
+    index = 0;
+    return true;
+}
+
+void HarnessParams::addInt(const std::string &name, vint value)
+{
+    m_values.push_back(value);
+    addParameter(name, reinterpret_cast<const char *>(&m_values.back()), VerticaType(Int8OID, -1));
+}
+
+void HarnessParams::addBool(const std::string &name, bool value)
+{
+    m_values.push_back(0);
+    *reinterpret_cast<vbool *>(&m_values.back()) = value ? vbool_true : vbool_false;
+    addParameter(name, reinterpret_cast<const char *>(&m_values.back()), VerticaType(BoolOID, -1));
+}
+
+ColumnPartitionReader::ColumnPartitionReader(const SizedColumnTypes &types, std::vector<Column> &columns,
+                                             size_t firstRow, size_t lastRow, int blockRows)
+    : PartitionReader(0), m_columns(columns), m_nextRow(firstRow), m_lastRow(lastRow), m_blockRows(blockRows)
+{
+    for (size_t i = 0; i < columns.size(); i++) {
+        addCol(columns[i].getSlot(0), columns[i].getStride(), columns[i].getType(), types.getColumnName(i));
+    }
+    nextBlock();
+}
+
+bool ColumnPartitionReader::nextBlock()
+{
+    if (m_nextRow >= m_lastRow) {
+        return false;
+    }
+    int rowCount = std::min<size_t>(m_blockRows, m_lastRow - m_nextRow);
+    for (size_t i = 0; i < m_columns.size(); i++) {
+        cols[i] = m_columns[i].getSlot(m_nextRow);
+    }
+    setRowCount(rowCount);
+    resetIndex();
+    m_nextRow += rowCount;
+    return true;
+}
+
+ColumnPartitionWriter::ColumnPartitionWriter(const SizedColumnTypes &types, int rowsPerBlock)
+    : BlockStreamWriter(types, rowsPerBlock)
+{
+    for (size_t i = 0; i < types.getColumnCount(); i++) {
+        m_output.push_back(Column(types.getColumnType(i), 0));
+    }
+}
+
+void ColumnPartitionWriter::consumeBlock(std::vector<Column> &columns, int rowCount)
+{
+    for (size_t i = 0; i < columns.size(); i++) {
+        m_output[i].append(columns[i], 0, rowCount);
+    }
+}
+
+TransformRunner::TransformRunner(TransformFunctionFactory &factory, const SizedColumnTypes &inputTypes,
+                                 const ParamReader &params)
+    : m_params(params), m_phases(1)
+{
+    HarnessServerInterface srvInterface(params);
+    m_phases[0].factory = &factory;
+    m_phases[0].inputTypes = inputTypes;
+    factory.getReturnType(srvInterface, inputTypes, m_phases[0].outputTypes);
+}
+
+// Every phase reads what the phase before it returns, as in MultiPhaseTransformFunctionFactory::getReturnType().
+TransformRunner::TransformRunner(MultiPhaseTransformFunctionFactory &factory, const SizedColumnTypes &inputTypes,
+                                 const ParamReader &params)
+    : m_params(params)
+{
+    HarnessServerInterface srvInterface(params);
+    std::vector<TransformFunctionPhase *> phases;
+    factory.getPhases(srvInterface, phases);
+    SizedColumnTypes phaseInputTypes = inputTypes;
+    for (size_t i = 0; i < phases.size(); i++) {
+        m_phases.push_back(Phase());
+        m_phases.back().phase = phases[i];
+        m_phases.back().inputTypes = phaseInputTypes;
+        phases[i]->getReturnType(srvInterface, phaseInputTypes, m_phases.back().outputTypes);
+        phaseInputTypes = m_phases.back().outputTypes;
+    }
+    if (m_phases.empty()) {
+        vt_report_error(0, "A multi-phase transform needs at least one phase");
+    }
+}
+
+// Reorders the rows so that the rows with the same values of the key columns are consecutive,
+// the partitions in the order their first row comes in. partitionStarts gets the first row of every
+// partition, then the row count.
+static void partitionRows(std::vector<Column> &rows, const std::vector<size_t> &keys,
+                          std::vector<size_t> &partitionStarts)
+{
+    size_t rowCount = rows.empty() ? 0 : rows[0].size();
+    partitionStarts.clear();
+    if (keys.empty()) {
+        if (rowCount > 0) {
+            partitionStarts.push_back(0);
+        }
+        partitionStarts.push_back(rowCount);
+        return;
+    }
+
+    std::unordered_map<std::string, size_t> partitionIndex;
+    std::vector<std::vector<size_t> > partitions;
+    if (rowCount > 0) {
+        std::vector<Column *> columns;
+        for (size_t i = 0; i < rows.size(); i++) {
+            columns.push_back(&rows[i]);
+        }
+        ColumnReader reader(columns, 0, rowCount);
+        std::string key;
+        size_t row = 0;
+        do {
+            key.clear();
+            for (size_t i = 0; i < keys.size(); i++) {
+                GroupKey::append(key, reader, keys[i]);
+            }
+            std::pair<std::unordered_map<std::string, size_t>::iterator, bool> inserted =
+                    partitionIndex.insert(std::make_pair(key, partitions.size()));
+            if (inserted.second) {
+                partitions.push_back(std::vector<size_t>());
+            }
+            partitions[inserted.first->second].push_back(row++);
+        } while (reader.next());
+    }
+
+    std::vector<Column> sorted;
+    for (size_t i = 0; i < rows.size(); i++) {
+        sorted.push_back(Column(rows[i].getType(), 0));
+    }
+    for (size_t p = 0; p < partitions.size(); p++) {
+        partitionStarts.push_back(sorted.empty() ? 0 : sorted[0].size());
+        for (size_t r = 0; r < partitions[p].size(); r++) {
+            for (size_t i = 0; i < rows.size(); i++) {
+                sorted[i].append(rows[i], partitions[p][r], 1);
+            }
+        }
+    }
+    partitionStarts.push_back(rowCount);
+    rows.swap(sorted);
+}
+
+void TransformRunner::run(const std::vector<Column> &input, const std::vector<size_t> &partitionBy,
+                          std::vector<Column> &output, int blockRows)
+{
+    std::vector<Column> rows(input);
+    std::vector<size_t> partitionStarts;
+    partitionRows(rows, partitionBy, partitionStarts);
+    runPhases(rows, partitionStarts, output, blockRows);
+}
+
+void TransformRunner::runSegmented(const std::vector<Column> &input, size_t segmentCount,
+                                   std::vector<Column> &output, int blockRows)
+{
+    std::vector<Column> rows(input);
+    size_t rowCount = rows.empty() ? 0 : rows[0].size();
+    std::vector<size_t> partitionStarts;
+    for (size_t s = 0; s < segmentCount; s++) {
+        size_t first = rowCount * s / segmentCount;
+        // An empty segment has no partition.
+        if (first < rowCount * (s + 1) / segmentCount) {
+            partitionStarts.push_back(first);
+        }
+    }
+    partitionStarts.push_back(rowCount);
+    runPhases(rows, partitionStarts, output, blockRows);
+}
+
+void TransformRunner::runPhases(std::vector<Column> &rows, std::vector<size_t> &partitionStarts,
+                                std::vector<Column> &output, int blockRows)
+{
+    if (blockRows <= 0 || rows.size() != m_phases[0].inputTypes.getColumnCount()) {
+        vt_report_error(0, "The input needs %zu columns", m_phases[0].inputTypes.getColumnCount());
+    }
+    for (size_t p = 0; p < m_phases.size(); p++) {
+        if (p > 0) {
+            std::vector<size_t> partitionBy;
+            m_phases[p].inputTypes.getPartitionByColumns(partitionBy);
+            partitionRows(rows, partitionBy, partitionStarts);
+        }
+        std::vector<Column> phaseOutput;
+        runPhase(m_phases[p], rows, partitionStarts, phaseOutput, blockRows);
+        rows.swap(phaseOutput);
+    }
+    output.swap(rows);
+}
+
+// One function object for all the partitions, as the server has one per thread.
+void TransformRunner::runPhase(const Phase &phase, std::vector<Column> &rows,
+                               const std::vector<size_t> &partitionStarts, std::vector<Column> &output,
+                               int blockRows)
+{
+    HarnessServerInterface srvInterface(m_params);
+    TransformFunction *function = phase.factory != NULL ? phase.factory->createTransformFunction(srvInterface)
+                                                        : phase.phase->createTransformFunction(srvInterface);
+    function->setup(srvInterface, phase.inputTypes);
+    ColumnPartitionWriter writer(phase.outputTypes, blockRows);
+    for (size_t i = 0; i + 1 < partitionStarts.size(); i++) {
+        ColumnPartitionReader reader(phase.inputTypes, rows, partitionStarts[i], partitionStarts[i + 1], blockRows);
+        function->processPartition(srvInterface, reader, writer);
+    }
+    writer.flush();
+    function->destroy(srvInterface, phase.inputTypes);
+    function->~TransformFunction();
+    output.swap(writer.getColumns());
+}
+
+} // namespace UDxHarness
+
+bool StreamWriter::getWriteableBlock()
+{
+    return static_cast<UDxHarness::BlockStreamWriter *>(this)->flush();
+}
+
+bool PartitionWriter::getWriteableBlock()
+{
+    vt_report_error(0, "UDxHarness only runs UDxs that write to a StreamWriter or a ColumnPartitionWriter");
+    return false;
+}
+
+bool PartitionReader::readNextBlock()
+{
+    return static_cast<UDxHarness::ColumnPartitionReader *>(this)->nextBlock();
+}
+
+// ColumnPartitionReader points the columns at the rows of every block itself.
+void PartitionReader::setupColsAndStrides()
+{
+}
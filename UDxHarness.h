@@ -0,0 +1,315 @@
+#ifndef UDX_HARNESS_H
+#define UDX_HARNESS_H
+
+#include "Vertica.h"
+#include <deque>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+using namespace Vertica;
+
+/*
+ * An in-process stand-in for the parts of the Vertica server that drive a
+ * UDx, so the UDxs of this repository can be unit tested and benchmarked on
+ * a plain Linux box. Link UDxHarness.cpp and the UDx sources with the
+ * program, the factories are reachable through the get<Factory>() functions
+ * that RegisterFactory() defines.
+ *
+ *   HarnessServerInterface - no catalog and no file system, the log goes to
+ *                            stderr, the allocator counts its allocations.
+ *   Column                 - values laid out in fixed-size slots the way the
+ *                            server hands them to a UDx, strings included.
+ *   ColumnReader           - a BlockReader over a run of rows of columns.
+ *   TupleAggs, TupleRows   - IntermediateAggs over one aggregate state and
+ *                            MultipleIntermediateAggs over several of them.
+ *   AggregateRunner        - initAggregate -> aggregateArrs -> combine ->
+ *                            terminate, over N worker threads with a final
+ *                            combine tree, reporting rows/sec, ns/row and
+ *                            allocation counts.
+ *   BlockStreamWriter      - a StreamWriter over in-memory blocks, for the
+ *                            UDParsers.
+ *   HarnessParams          - a ParamReader that owns its values, the
+ *                            USING PARAMETERS of a call.
+ *   ColumnPartitionReader  - a PartitionReader over a run of rows of columns,
+ *                            handed to the UDx a block at a time.
+ *   ColumnPartitionWriter  - a PartitionWriter that appends every block the
+ *                            UDx writes to whole columns.
+ *   TransformRunner        - setup -> processPartition -> destroy of a
+ *                            TransformFunction over every partition of its
+ *                            input, or of every phase of a multi-phase one
+ *                            with the rows partitioned between the phases.
+ *
+ * getAllocationCount() counts the calls to operator new of the whole
+ * process, UDxHarness.cpp replaces the global operator.
+ */
+namespace UDxHarness {
+
+size_t getAllocationCount();
+
+double now();
+
+// Frees everything it allocated when it is destroyed.
+class HarnessAllocator : public VTAllocator
+{
+public:
+    HarnessAllocator() : m_allocationCount(0) { }
+    virtual ~HarnessAllocator();
+    virtual void *alloc(size_t size);
+    size_t getAllocationCount() const { return m_allocationCount; }
+
+private:
+    std::vector<void *> m_blocks;
+    size_t m_allocationCount;
+};
+
+class HarnessServerInterface : public ServerInterface
+{
+public:
+    HarnessServerInterface(const ParamReader &params = ParamReader());
+
+    HarnessAllocator &getAllocator() { return m_allocator; }
+
+    // Nothing below is available outside of the server.
+    virtual const UDFileSystem *getFileSystem(const char *path) { return NULL; }
+    virtual void listTables(const RelationDescription &lookup, std::vector<Oid> &tables,
+                            bool errorIfNotFound) { }
+    virtual void listProjections(const RelationDescription &lookup, std::vector<Oid> &projections,
+                                 bool errorIfNotFound) { }
+    virtual void listTableProjections(const RelationDescription &baseTable, std::vector<Oid> &projections,
+                                      bool errorIfNotFound) { }
+    virtual void listDerivedTables(const RelationDescription &baseTable, std::vector<Oid> &tables,
+                                   bool errorIfNotFound) { }
+    virtual bool describeTable(RelationDescription &baseTable, bool errorIfNotFound) { return false; }
+    virtual bool describeProjection(RelationDescription &proj, bool errorIfNotFound) { return false; }
+    virtual bool describeFunction(FunctionDescription &func, bool errorIfNotFound) { return false; }
+    virtual bool describeType(TypeDescription &type, bool errorIfNotFound) { return false; }
+    virtual bool describeBlob(const BlobIdentifier &blobId, BlobDescription &blobDescription,
+                              bool errorIfNotFound) { return false; }
+    virtual std::vector<BlobDescription> listBlobs(BlobIdentifier::Namespace nsp)
+    { return std::vector<BlobDescription>(); }
+
+private:
+    HarnessAllocator m_allocator;
+};
+
+// One column of values, each in a slot of getStride() bytes.
+class Column
+{
+public:
+    Column(const VerticaType &type, size_t rows);
+
+    static Column floats(const std::vector<vfloat> &values);
+    static Column ints(const std::vector<vint> &values);
+    static Column varchars(const std::vector<std::string> &values, int maxLength);
+
+    const VerticaType &getType() const { return m_type; }
+    size_t size() const { return m_rows; }
+    int getStride() const { return m_stride; }
+    char *getSlot(size_t row) { return &m_data[row * m_stride]; }
+    const char *getSlot(size_t row) const { return &m_data[row * m_stride]; }
+
+    vfloat getFloat(size_t row) const { return *reinterpret_cast<const vfloat *>(getSlot(row)); }
+    vint getInt(size_t row) const { return *reinterpret_cast<const vint *>(getSlot(row)); }
+    bool isNullString(size_t row) const;
+    std::string getString(size_t row) const;
+
+    void setFloat(size_t row, vfloat value) { *reinterpret_cast<vfloat *>(getSlot(row)) = value; }
+    void setInt(size_t row, vint value) { *reinterpret_cast<vint *>(getSlot(row)) = value; }
+    void setString(size_t row, const std::string &value);
+    void setNullString(size_t row);
+
+    // Appends rowCount rows of a column of the same type, starting at firstRow.
+    void append(const Column &other, size_t firstRow, size_t rowCount);
+
+private:
+    VerticaType m_type;
+    size_t m_rows;
+    int m_stride;
+    std::vector<char> m_data;
+};
+
+class ColumnReader : public BlockReader
+{
+public:
+    ColumnReader(std::vector<Column *> &columns, size_t firstRow, int rowCount);
+};
+
+// Where every intermediate column starts in an aggregate state, and the state size.
+struct TupleLayout {
+    explicit TupleLayout(const SizedColumnTypes &types);
+    SizedColumnTypes types;
+    std::vector<int> offsets;
+    int size;
+};
+
+class TupleAggs : public IntermediateAggs
+{
+public:
+    TupleAggs(const TupleLayout &layout, char *tuple);
+
+    // Points the columns at another state of the same layout.
+    void setTuple(char *tuple);
+
+private:
+    const TupleLayout &m_layout;
+};
+
+// count states of the layout, stored one after the other from the first one.
+class TupleRows : public MultipleIntermediateAggs
+{
+public:
+    TupleRows(const TupleLayout &layout, char *firstTuple, int count);
+};
+
+class AggregateRunner
+{
+public:
+    // The server hands the rows to aggregateArrs() in blocks of this size.
+    static const int DEFAULT_BLOCK_ROWS = 1024;
+
+    struct Stats {
+        Stats() : rows(0), aggregateSeconds(0), combineSeconds(0), terminateSeconds(0),
+                  allocations(0), udxAllocations(0) { }
+        vint rows;
+        double aggregateSeconds;
+        double combineSeconds;
+        double terminateSeconds;
+        size_t allocations;    // operator new calls during the run.
+        size_t udxAllocations; // VTAllocator calls during the run.
+
+        double getSeconds() const { return aggregateSeconds + combineSeconds + terminateSeconds; }
+        double getRowsPerSecond() const { return rows / getSeconds(); }
+        double getNanosecondsPerRow() const { return getSeconds() * 1e9 / rows; }
+    };
+
+    AggregateRunner(AggregateFunctionFactory &factory, const SizedColumnTypes &argTypes,
+                    const ParamReader &params = ParamReader());
+
+    // The type of the terminate() output.
+    const VerticaType &getReturnType() const { return m_returnType; }
+
+    // Aggregates the input (one argument column) as groups of groupSize consecutive rows, the way
+    // the server feeds a sorted GROUP BY. The rows are split into threadCount slices aggregated at
+    // the same time, a group that spans several slices has one state per slice, the states are
+    // combined two by two, then every group is terminated into one row of output.
+    Stats run(Column &input, size_t groupSize, int threadCount, Column &output,
+              int blockRows = DEFAULT_BLOCK_ROWS);
+
+private:
+    void aggregateSlice(Column &input, size_t firstRow, size_t lastRow, size_t groupSize,
+                        int blockRows, std::vector<char> &tuples, size_t &udxAllocations);
+
+    AggregateFunctionFactory &m_factory;
+    SizedColumnTypes m_argTypes;
+    ParamReader m_params;
+    TupleLayout m_layout;
+    VerticaType m_returnType;
+};
+
+// Hands every full block of rows to consumeBlock(), then starts over at the top of the block.
+// Call flush() once the UDx is done to consume the last, partial block.
+class BlockStreamWriter : public StreamWriter
+{
+public:
+    BlockStreamWriter(const SizedColumnTypes &types, int rowsPerBlock);
+    virtual ~BlockStreamWriter() { }
+
+    bool flush();
+
+protected:
+    virtual void consumeBlock(std::vector<Column> &columns, int rowCount) = 0;
+
+private:
+    std::vector<Column> m_columns;
+};
+
+// Keep it alive for as long as the ServerInterfaces that read it, they point at its values.
+class HarnessParams : public ParamReader
+{
+public:
+    void addInt(const std::string &name, vint value);
+    void addBool(const std::string &name, bool value);
+
+private:
+    std::deque<vint> m_values;
+};
+
+// Reads the rows [firstRow, lastRow) of the columns, blockRows at a time.
+class ColumnPartitionReader : public PartitionReader
+{
+public:
+    ColumnPartitionReader(const SizedColumnTypes &types, std::vector<Column> &columns,
+                          size_t firstRow, size_t lastRow, int blockRows);
+
+    bool nextBlock();
+
+private:
+    std::vector<Column> &m_columns;
+    size_t m_nextRow;
+    size_t m_lastRow;
+    int m_blockRows;
+};
+
+// The rows written through every partition, in the order they were written. The UDx writes to a
+// PartitionWriter, the blocks are handed out the way BlockStreamWriter does.
+class ColumnPartitionWriter : public BlockStreamWriter
+{
+public:
+    ColumnPartitionWriter(const SizedColumnTypes &types, int rowsPerBlock);
+
+    // Only holds the last, partial block once flush() was called.
+    std::vector<Column> &getColumns() { return m_output; }
+
+protected:
+    virtual void consumeBlock(std::vector<Column> &columns, int rowCount);
+
+private:
+    std::vector<Column> m_output;
+};
+
+class TransformRunner
+{
+public:
+    static const int DEFAULT_BLOCK_ROWS = 1024;
+
+    TransformRunner(TransformFunctionFactory &factory, const SizedColumnTypes &inputTypes,
+                    const ParamReader &params = ParamReader());
+    TransformRunner(MultiPhaseTransformFunctionFactory &factory, const SizedColumnTypes &inputTypes,
+                    const ParamReader &params = ParamReader());
+
+    // The output of the last phase.
+    const SizedColumnTypes &getReturnTypes() const { return m_phases.back().outputTypes; }
+
+    // Runs the input OVER (PARTITION BY the given columns), no column is OVER (). The rows of a
+    // partition keep their input order, as if ORDER BY tied on everything else. The output holds
+    // the rows of every partition, one partition after the other.
+    void run(const std::vector<Column> &input, const std::vector<size_t> &partitionBy,
+             std::vector<Column> &output, int blockRows = DEFAULT_BLOCK_ROWS);
+
+    // Runs the input OVER (PARTITION BEST): the first phase gets segmentCount slices of the rows,
+    // one partition per node, the next phases PARTITION BY the columns the phase before declared.
+    void runSegmented(const std::vector<Column> &input, size_t segmentCount, std::vector<Column> &output,
+                      int blockRows = DEFAULT_BLOCK_ROWS);
+
+private:
+    struct Phase {
+        Phase() : factory(NULL), phase(NULL) { }
+        TransformFunctionFactory *factory;
+        TransformFunctionPhase *phase;
+        SizedColumnTypes inputTypes;
+        SizedColumnTypes outputTypes;
+    };
+
+    void runPhases(std::vector<Column> &rows, std::vector<size_t> &partitionStarts,
+                   std::vector<Column> &output, int blockRows);
+    void runPhase(const Phase &phase, std::vector<Column> &rows, const std::vector<size_t> &partitionStarts,
+                  std::vector<Column> &output, int blockRows);
+
+    ParamReader m_params;
+    std::vector<Phase> m_phases;
+};
+
+} // namespace UDxHarness
+
+#endif
@@ -0,0 +1 @@
+g++ -I sdk/include -I . -O2 -Wall -Wno-unused-value -pthread -o FactParserBench FactParserBench.cpp UDxHarness.cpp sdk/include/Vertica.cpp && ./FactParserBench "$@"
@@ -0,0 +1 @@
+g++ -I sdk/include -I . -O2 -Wall -Wno-unused-value -pthread -o SumWithNullBench SumWithNullBench.cpp UDxHarness.cpp SumWithNull.cpp CubeMeasure.cpp sdk/include/Vertica.cpp && ./SumWithNullBench "$@"
@@ -0,0 +1 @@
+g++ -I sdk/include -I . -O2 -Wall -Wno-unused-value -pthread -o TransformCheck TransformCheck.cpp UDxHarness.cpp PctOfTotal.cpp PercentageCube.cpp TopK.cpp DictEncode.cpp sdk/include/Vertica.cpp && ./TransformCheck "$@"
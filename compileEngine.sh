@@ -0,0 +1 @@
+g++ -g -O2 -Wall -o CubeEngine CubeEngine.cpp
@@ -1 +1,8 @@
-g++ -I sdk/include -g -Wall -Wno-unused-value -shared -fPIC -o SumWithNull.so SumWithNull.cpp sdk/include/Vertica.cpp
+g++ -I sdk/include -g -O2 -Wall -Wno-unused-value -shared -fPIC -o SumWithNull.so SumWithNull.cpp sdk/include/Vertica.cpp
+g++ -I sdk/include -g -O2 -Wall -Wno-unused-value -shared -fPIC -o CubeMeasure.so CubeMeasure.cpp sdk/include/Vertica.cpp
+g++ -I sdk/include -g -O2 -Wall -Wno-unused-value -shared -fPIC -o PctOfTotal.so PctOfTotal.cpp sdk/include/Vertica.cpp
+g++ -I sdk/include -g -O2 -Wall -Wno-unused-value -shared -fPIC -o PercentageCube.so PercentageCube.cpp sdk/include/Vertica.cpp
+g++ -I sdk/include -g -O2 -Wall -Wno-unused-value -shared -fPIC -o TopK.so TopK.cpp sdk/include/Vertica.cpp
+g++ -I sdk/include -g -O2 -Wall -Wno-unused-value -shared -fPIC -o FactGenerator.so FactGenerator.cpp sdk/include/Vertica.cpp
+g++ -I sdk/include -g -O2 -Wall -Wno-unused-value -shared -fPIC -o FactParser.so FactParser.cpp sdk/include/Vertica.cpp
+g++ -I sdk/include -g -O2 -Wall -Wno-unused-value -shared -fPIC -o DictEncode.so DictEncode.cpp sdk/include/Vertica.cpp
@@ -1,2 +1,19 @@
 CREATE LIBRARY SumWithNull AS '/home/dbadmin/percentage-cube/SumWithNull.so';
 CREATE AGGREGATE FUNCTION sumnull AS LANGUAGE 'C++' NAME 'SumWithNullFactory' LIBRARY SumWithNull;
+CREATE AGGREGATE FUNCTION sumnull AS LANGUAGE 'C++' NAME 'SumWithNullIntegerFactory' LIBRARY SumWithNull;
+CREATE AGGREGATE FUNCTION sumnull AS LANGUAGE 'C++' NAME 'SumWithNullNumericFactory' LIBRARY SumWithNull;
+CREATE AGGREGATE FUNCTION sumnull_exact AS LANGUAGE 'C++' NAME 'SumWithNullExactFactory' LIBRARY SumWithNull;
+CREATE LIBRARY CubeMeasure AS '/home/dbadmin/percentage-cube/CubeMeasure.so';
+CREATE AGGREGATE FUNCTION cube_measure AS LANGUAGE 'C++' NAME 'CubeMeasureFactory' LIBRARY CubeMeasure;
+CREATE LIBRARY PctOfTotal AS '/home/dbadmin/percentage-cube/PctOfTotal.so';
+CREATE TRANSFORM FUNCTION pct_of_total AS LANGUAGE 'C++' NAME 'PctOfTotalFactory' LIBRARY PctOfTotal;
+CREATE LIBRARY PercentageCube AS '/home/dbadmin/percentage-cube/PercentageCube.so';
+CREATE TRANSFORM FUNCTION percentage_cube AS LANGUAGE 'C++' NAME 'PercentageCubeFactory' LIBRARY PercentageCube;
+CREATE LIBRARY TopK AS '/home/dbadmin/percentage-cube/TopK.so';
+CREATE TRANSFORM FUNCTION top_k AS LANGUAGE 'C++' NAME 'TopKFactory' LIBRARY TopK;
+CREATE LIBRARY FactGenerator AS '/home/dbadmin/percentage-cube/FactGenerator.so';
+CREATE SOURCE fact_generator AS LANGUAGE 'C++' NAME 'FactGeneratorFactory' LIBRARY FactGenerator;
+CREATE LIBRARY FactParser AS '/home/dbadmin/percentage-cube/FactParser.so';
+CREATE PARSER fact_parser AS LANGUAGE 'C++' NAME 'FactParserFactory' LIBRARY FactParser;
+CREATE LIBRARY DictEncode AS '/home/dbadmin/percentage-cube/DictEncode.so';
+CREATE TRANSFORM FUNCTION dict_encode AS LANGUAGE 'C++' NAME 'DictEncodeFactory' LIBRARY DictEncode;
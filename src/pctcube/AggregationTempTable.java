@@ -1,6 +1,7 @@
 package pctcube;
 
 import java.util.ArrayList;
+import java.util.Collections;
 import java.util.List;
 
 import pctcube.database.Table;
@@ -40,7 +41,31 @@ public class AggregationTempTable extends Table {
         return true;
     }
 
+    public List<Integer> getSelectionFlags() {
+        return Collections.unmodifiableList(m_selectionFlags);
+    }
+
+    public int getNumOfSelectedDimensions() {
+        int retval = 0;
+        for (int flag : m_selectionFlags) {
+            if (flag > 0) {
+                retval++;
+            }
+        }
+        return retval;
+    }
+
+    // Estimated number of groups in this table, used to pick the smallest parent to derive a table from.
+    public long getEstimatedRowCount() {
+        return m_estimatedRowCount;
+    }
+
+    public void setEstimatedRowCount(long value) {
+        m_estimatedRowCount = value;
+    }
+
     private List<Integer> m_selectionFlags;
+    private long m_estimatedRowCount = Long.MAX_VALUE;
 
     protected static final String TEMP_TABLE_PREFIX = "TEMP_AGG_";
 }
@@ -2,5 +2,7 @@ package pctcube;
 
 public enum EvaluationMethod {
     GROUPBY,
-    OLAP
+    OLAP,
+    UDTF,
+    LATTICE
 }
@@ -21,6 +21,10 @@ public class FactTableBuilder {
     private String m_insertQuery;
     private String m_cubeParameter;
     private String m_projectionDDL;
+    // Generate the rows in the database with the FactGenerator UDSource instead of inserting them over JDBC.
+    private boolean m_generateInDatabase = false;
+    private long m_seed = 0;
+    private double m_skew = 0.0;
 
     public FactTableBuilder(String name, int dimensionCount) {
         if (dimensionCount <= 0) {
@@ -64,18 +68,66 @@ public class FactTableBuilder {
         return m_projectionDDL;
     }
 
+    public FactTableBuilder setGenerateInDatabase(boolean generateInDatabase) {
+        m_generateInDatabase = generateInDatabase;
+        return this;
+    }
+
+    public boolean generatesInDatabase() {
+        return m_generateInDatabase;
+    }
+
+    // Only used when the data is generated in the database.
+    public FactTableBuilder setSeed(long seed) {
+        m_seed = seed;
+        return this;
+    }
+
+    // The Zipf exponent of the dimension values, 0 for uniform values.
+    // Only used when the data is generated in the database.
+    public FactTableBuilder setSkew(double skew) {
+        if (skew < 0) {
+            throw new IllegalArgumentException("Skew should not be negative.");
+        }
+        m_skew = skew;
+        return this;
+    }
+
+    public String getCopyQuery(int rowCount, int nullIn100, int[] cardinalities) {
+        checkCardinalities(cardinalities);
+        List<String> cardinalityStrings = new ArrayList<>();
+        for (int cardinality : cardinalities) {
+            cardinalityStrings.add(String.valueOf(cardinality));
+        }
+        StringBuilder copyQueryBuilder = new StringBuilder("COPY ");
+        copyQueryBuilder.append(m_table.getTableName());
+        copyQueryBuilder.append(" WITH SOURCE fact_generator(rows=").append(rowCount);
+        copyQueryBuilder.append(", cardinalities='").append(String.join(",", cardinalityStrings)).append("'");
+        copyQueryBuilder.append(", nullpct=").append(nullIn100);
+        copyQueryBuilder.append(", seed=").append(m_seed);
+        if (m_skew > 0) {
+            copyQueryBuilder.append(", skew=").append(m_skew);
+        }
+        copyQueryBuilder.append(") DELIMITER '|' NULL '' DIRECT;");
+        return copyQueryBuilder.toString();
+    }
+
     public void populateData(int rowCount,
             int nullIn100,
             int[] cardinalities,
             DbConnection conn) throws SQLException {
+        if (m_generateInDatabase) {
+            checkCardinalities(cardinalities);
+            conn.execute("TRUNCATE TABLE " + m_table.getTableName() + ";");
+            conn.execute(getCopyQuery(rowCount, nullIn100, cardinalities));
+            return;
+        }
         if (conn.getConnection() == null) {
             return;
         }
         List<Column> columns = m_table.getColumns();
         Random rand = new Random();
-        if (cardinalities.length != columns.size() - 1) {
-            throw new RuntimeException("Not enough cardinalities are specified.");
-        }
+        checkCardinalities(cardinalities);
         PreparedStatement insertStmt = conn.getConnection().prepareStatement(m_insertQuery);
         Statement stmt = conn.getConnection().createStatement();
         stmt.execute("TRUNCATE TABLE " + m_table.getTableName());
@@ -114,4 +166,10 @@ public class FactTableBuilder {
         }
         populateData(rowCount, nullIn100, cardinalities, conn);
     }
+
+    private void checkCardinalities(int[] cardinalities) {
+        if (cardinalities.length != m_table.getColumns().size() - 1) {
+            throw new RuntimeException("Not enough cardinalities are specified.");
+        }
+    }
 }
@@ -1,5 +1,7 @@
 package pctcube;
 
+import java.util.List;
+
 import pctcube.database.Column;
 import pctcube.database.DataType;
 import pctcube.database.Table;
@@ -11,10 +13,61 @@ public class OLAPCubeTableFactory {
         for (Column dimension : cube.getDimensions()) {
             retval.addColumn(new Column(dimension));
         }
+        Column cuboidId = new Column(CUBOID_ID_COLUMN, DataType.INTEGER).setNullable(false);
         Column count = new Column("cnt", DataType.INTEGER).setNullable(false);
-        Column measure = new Column(cube.getMeasure()).setNullable(false);
+        retval.addColumn(cuboidId);
         retval.addColumn(count);
-        retval.addColumn(measure);
+        // A sum is NULL if the group has no value (SUM) or a NULL value (SUMNULL).
+        for (Column measure : cube.getMeasures()) {
+            retval.addColumn(getSumColumn(measure).setNullable(true));
+        }
+        // A cube maintained incrementally can have its facts retracted (PercentageCube.evaluateIncrementallyOn()),
+        // which can take the last NULL or the last value out of a group. So its sums skip the NULLs, and the NULLs
+        // are counted apart. PercentageCubeAssembler gives a sum its NULL back from the counts.
+        if (cube.isIncremental()) {
+            for (Column measure : cube.getMeasures()) {
+                retval.addColumn(getNullCountColumn(measure));
+            }
+        }
+        // Every cuboid gets its own partition, so selecting a cuboid by its id prunes all the others.
+        // Vertica caps the number of partitions of a table, beyond that the cuboids share the storage.
+        if (cube.getDimensions().size() <= MAX_PARTITIONED_DIMENSION_COUNT) {
+            retval.setPartitionColumn(cuboidId);
+        }
+        return retval;
+    }
+
+    // The cuboid_id of the groups of a cuboid, as GROUPING_ID() over all the dimensions computes it:
+    // one bit per dimension, the first dimension is the most significant bit, and a bit is set if
+    // the dimension is rolled up ("ALL"). The base cuboid is 0, the grand total 2^n - 1.
+    public static int getCuboidId(List<Integer> selectionFlags) {
+        int retval = 0;
+        for (int flag : selectionFlags) {
+            retval = (retval << 1) | (flag == 0 ? 1 : 0);
+        }
         return retval;
     }
+
+    // The column the sums of a measure are stored in. A DECIMAL(p, s) sum gets SUM_EXTRA_DIGITS more digits
+    // of precision, the way sumnull() widens it, so the sum of many rows does not overflow.
+    public static Column getSumColumn(Column measure) {
+        if (! measure.getDataType().hasPrecisionAndScale()) {
+            return new Column(measure);
+        }
+        int precision = Math.min(measure.getPrecision() + SUM_EXTRA_DIGITS, MAX_PRECISION);
+        return new Column(measure.getColumnName(), measure.getDataType(), precision, measure.getScale());
+    }
+
+    // The number of NULL values of a measure in a group.
+    public static Column getNullCountColumn(Column measure) {
+        return new Column(measure.getColumnName() + NULL_COUNT_SUFFIX, DataType.INTEGER).setNullable(false);
+    }
+
+    public static final String CUBOID_ID_COLUMN = "cuboid_id";
+    public static final String NULL_COUNT_SUFFIX = "_nulls";
+
+    private static final int SUM_EXTRA_DIGITS = 19;
+    private static final int MAX_PRECISION = 1024;
+    // 2^10 cuboids, Vertica's default MaxPartitionCount is 1024.
+    private static final int MAX_PARTITIONED_DIMENSION_COUNT = 10;
 }
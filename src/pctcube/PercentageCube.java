@@ -8,6 +8,7 @@ import java.util.logging.Logger;
 import pctcube.database.Column;
 import pctcube.database.Database;
 import pctcube.database.Table;
+import pctcube.database.TempTableCleanupAction;
 import pctcube.database.query.QuerySet;
 
 public final class PercentageCube extends QuerySet {
@@ -22,29 +23,89 @@ public final class PercentageCube extends QuerySet {
 
     public void evaluate() {
         clear();
+        if (m_encode) {
+            accept(new PercentageCubeEncodeAction());
+        }
         accept(new PercentageCubeCreateAction());
         if (m_evaluationMethod == EvaluationMethod.GROUPBY) {
             accept(new PercentageCubeAggregateAction());
         }
+        else if (m_evaluationMethod == EvaluationMethod.LATTICE) {
+            accept(new PercentageCubeLatticeAction());
+        }
         accept(new PercentageCubeAssembler());
         accept(new PercentageCubeTopKFilter());
+        if (m_evaluationMethod == EvaluationMethod.LATTICE) {
+            dropTempTables();
+        }
     }
 
     public void evaluateIncrementallyOn(Table deltaFactTable) {
+        evaluateIncrementallyOn(deltaFactTable, null);
+    }
+
+    // The sign column of the delta (+1 or -1) tells the facts it adds from the facts it retracts, a corrected
+    // fact is retracted and added again. Retractions need an incremental (incremental=true) GROUPBY cube.
+    public void evaluateIncrementallyOn(Table deltaFactTable, String signColumnName) {
         for (Column dimension : m_dimensions) {
-            if (! deltaFactTable.getColumnByName(dimension.getColumnName()).equals(dimension)) {
+            Column sourceDimension = m_sourceFactTable.getColumnByName(dimension.getColumnName());
+            if (! deltaFactTable.getColumnByName(dimension.getColumnName()).equals(sourceDimension)) {
                 throw new IllegalArgumentException("Invalid delta fact table.");
             }
         }
+        Column signColumn = null;
+        if (signColumnName != null) {
+            signColumn = deltaFactTable.getColumnByName(signColumnName);
+            if (signColumn == null || ! m_incremental || m_evaluationMethod != EvaluationMethod.GROUPBY) {
+                throw new IllegalArgumentException("Invalid sign column.");
+            }
+        }
+        if (m_evaluationMethod == EvaluationMethod.GROUPBY && getPruningStrategy() != PruningStrategy.NONE) {
+            throw new IllegalArgumentException("A pruned cube cannot take a delta, it needs incremental=true.");
+        }
 
         clear();
+        if (m_encode) {
+            // The delta is encoded with the same dictionaries, extended with its new values.
+            PercentageCubeEncodeAction encodeAction = new PercentageCubeEncodeAction(deltaFactTable, signColumn);
+            accept(encodeAction);
+            deltaFactTable = encodeAction.getEncodedFactTable();
+        }
+        if (m_evaluationMethod == EvaluationMethod.GROUPBY && m_pctCubeTable != null) {
+            // The percentage cube built by evaluate() is kept, only the totals the delta touches are
+            // deleted and reassembled, their denominators have changed. The other rows stay as they are.
+            PercentageCubeAggregateAction aggregateAction =
+                    new PercentageCubeAggregateAction(deltaFactTable, signColumn);
+            accept(aggregateAction);
+            accept(new PercentageCubeDeltaMergeAction(signColumn != null));
+            accept(new PercentageCubeAssembler(aggregateAction.getOLAPCubeTable()));
+            accept(new PercentageCubeTopKFilter());
+            dropTempTables();
+            return;
+        }
         accept(new PercentageCubeCreateAction());
         if (m_evaluationMethod == EvaluationMethod.GROUPBY) {
-            accept(new PercentageCubeAggregateAction(deltaFactTable));
-            accept(new PercentageCubeDeltaMergeAction());
+            if (m_olapCubeTable == null) {
+                // The OLAP cube was built by another run.
+                m_olapCubeTable = OLAPCubeTableFactory.getTable(this);
+            }
+            accept(new PercentageCubeAggregateAction(deltaFactTable, signColumn));
+            accept(new PercentageCubeDeltaMergeAction(signColumn != null));
+        }
+        else if (m_evaluationMethod == EvaluationMethod.LATTICE) {
+            accept(new PercentageCubeLatticeAction());
         }
         accept(new PercentageCubeAssembler());
         accept(new PercentageCubeTopKFilter());
+        dropTempTables();
+    }
+
+    // The lattice method materializes every cuboid as a temp table, and an incremental evaluation aggregates
+    // the delta into one. Drop them once the cube is assembled.
+    private void dropTempTables() {
+        TempTableCleanupAction tempTableCleanupAction = new TempTableCleanupAction();
+        m_database.accept(tempTableCleanupAction);
+        addAllQueries(tempTableCleanupAction.getQueries());
     }
 
     public PercentageCube(Database db, String[] args) {
@@ -55,15 +116,30 @@ public final class PercentageCube extends QuerySet {
         return m_factTable;
     }
 
+    // The fact table as given, getFactTable() is its encoded copy if the dimensions are encoded.
+    public Table getSourceFactTable() {
+        return m_sourceFactTable;
+    }
+
     public List<Column> getDimensions() {
         return Collections.unmodifiableList(m_dimensions);
     }
 
+    public List<Column> getMeasures() {
+        return Collections.unmodifiableList(m_measures);
+    }
+
+    // The first measure, the one the top k filter ranks the groups by.
     public Column getMeasure() {
-        return m_measure;
+        return m_measures.get(0);
     }
 
+    // The OLAP cube drops the groups failing the row count threshold, unless it is incremental: the deltas are
+    // merged into all of its groups, a pruned group would get the counts and sums of the delta alone.
     public PruningStrategy getPruningStrategy() {
+        if (m_incremental || m_rowCount <= 0) {
+            return PruningStrategy.NONE;
+        }
         return m_pruningStrategy;
     }
 
@@ -76,6 +152,22 @@ public final class PercentageCube extends QuerySet {
         return m_topk;
     }
 
+    // The estimated number of distinct values of the i-th dimension.
+    public long getEstimatedCardinality(int dimensionIndex) {
+        if (m_dimensionCardinalities.isEmpty()) {
+            return DEFAULT_DIMENSION_CARDINALITY;
+        }
+        return m_dimensionCardinalities.get(dimensionIndex);
+    }
+
+    // Whether the assembler keeps only the top k rows of every total itself, so that the full percentage cube
+    // is never written and pct_cube_topk is the percentage cube table. Only the join-based assemblers
+    // (GROUPBY and LATTICE) can, the other methods filter the full cube afterwards.
+    public boolean isTopKPushedDown() {
+        return m_topkPushdown && m_topk > 0 &&
+               (m_evaluationMethod == EvaluationMethod.GROUPBY || m_evaluationMethod == EvaluationMethod.LATTICE);
+    }
+
     public int getRowCountThreshold() {
         return m_rowCount;
     }
@@ -96,24 +188,58 @@ public final class PercentageCube extends QuerySet {
         return m_olapCubeTable;
     }
 
+    public boolean isCanonical() {
+        return m_canonical;
+    }
+
     public boolean usesUDF() {
         return m_useUDF;
     }
 
+    public boolean usesFusedUDF() {
+        return m_useFusedUDF;
+    }
+
+    public boolean usesExactUDF() {
+        return m_useExactUDF;
+    }
+
+    // The aggregate function that sums the measure.
+    public String getSumFunctionName() {
+        if (m_useExactUDF) {
+            return "SUMNULL_EXACT";
+        }
+        return m_useUDF ? "SUMNULL" : "SUM";
+    }
+
+    public boolean isEncoded() {
+        return m_encode;
+    }
+
     protected Database m_database;
     protected Table m_factTable;
+    protected Table m_sourceFactTable;
     protected Table m_pctCubeTable;
     protected Table m_olapCubeTable;
 
     protected List<Column> m_dimensions = new ArrayList<>();
-    protected Column m_measure;
+    protected List<Column> m_measures = new ArrayList<>();
+    protected List<Long> m_dimensionCardinalities = new ArrayList<>(); // empty means unknown.
     protected PruningStrategy m_pruningStrategy = PruningStrategy.NONE;
     protected EvaluationMethod m_evaluationMethod = EvaluationMethod.GROUPBY;
     protected int m_topk = 0;
+    protected boolean m_topkPushdown = false; // whether rank the rows in the assembler instead of a second pass
     protected int m_rowCount = 0; // row count, zero means no threshold applied.
     protected boolean m_incremental = false;
+    protected boolean m_canonical = false; // whether compute each (total-by set, break-down-by set) pair only once
     protected boolean m_useUDF = false; // whether use the user-defined aggregate function sumnull()
     // sumnull() will return null if any of the values being summed is null.
+    protected boolean m_useFusedUDF = false; // whether use cube_measure(), which computes count and sumnull() in one pass
+    // whether use sumnull_exact(), a sumnull() that gives the same bits whatever the degree of parallelism
+    // (until the first delta merge, see PercentageCubeInitializer)
+    protected boolean m_useExactUDF = false;
+    protected boolean m_encode = false; // whether the VARCHAR dimensions are replaced by dictionary codes
 
+    protected static final long DEFAULT_DIMENSION_CARDINALITY = 10;
     protected static final Logger m_logger = Logger.getLogger(PercentageCube.class.getName());
 }
@@ -1,14 +1,20 @@
 package pctcube;
 
+import java.util.ArrayList;
+import java.util.List;
+
 import pctcube.PercentageCube.PercentageCubeVisitor;
 import pctcube.database.Column;
 import pctcube.database.Table;
 import pctcube.database.query.CreateTableQuerySet;
 import pctcube.database.query.QuerySet;
+import pctcube.utils.CombinationGenerator;
 
 public class PercentageCubeAggregateAction implements PercentageCubeVisitor {
 
     private Table m_deltaFactTable = null;
+    private Column m_signColumn = null;
+    private Table m_olapCubeTable = null;
 
     public PercentageCubeAggregateAction() {
 
@@ -18,10 +24,15 @@ public class PercentageCubeAggregateAction implements PercentageCubeVisitor {
         m_deltaFactTable = deltaFactTable;
     }
 
+    // Every fact row of the delta is weighted by its sign, -1 retracts a fact that was added earlier.
+    public PercentageCubeAggregateAction(Table deltaFactTable, Column signColumn) {
+        m_deltaFactTable = deltaFactTable;
+        m_signColumn = signColumn;
+    }
+
     // Evaluate all the aggregations that can be re-used during cube evaluation.
     @Override
     public void visit(PercentageCube cube) {
-        StringBuilder aggregationQueryBuilder = new StringBuilder();
         CreateTableQuerySet createTableQuerySet = new CreateTableQuerySet();
         createTableQuerySet.setAddDropIfExists(true);
         boolean delta = m_deltaFactTable != null;
@@ -29,7 +40,9 @@ public class PercentageCubeAggregateAction implements PercentageCubeVisitor {
         Table factTable = delta ? m_deltaFactTable : cube.getFactTable();
         Table olapCubeTable = OLAPCubeTableFactory.getTable(cube);
         if (delta) {
+            // Dropped once it has been merged and the touched totals are reassembled.
             olapCubeTable.setTableName(olapCubeTable.getTableName() + "_delta");
+            olapCubeTable.setTempTable(true);
         }
         else {
             // If this is not a delta OLAP cube table, associate it with the percentage cube, it will be used later.
@@ -37,7 +50,31 @@ public class PercentageCubeAggregateAction implements PercentageCubeVisitor {
         }
         olapCubeTable.accept(createTableQuerySet);
         cube.getDatabase().addOrReplaceTable(olapCubeTable);
+        m_olapCubeTable = olapCubeTable;
+
+        // Groups failing the row count threshold never make it into the percentage cube, so they need not
+        // be kept in the OLAP cube either. A delta OLAP cube needs all of its groups, though, because they
+        // are merged with other counts later. So does an incremental cube (PercentageCube.getPruningStrategy()),
+        // and a pruned one cannot take a delta.
+        PruningStrategy pruning = delta ? PruningStrategy.NONE : cube.getPruningStrategy();
+        cube.addAllQueries(createTableQuerySet.getQueries());
+        if (pruning == PruningStrategy.CASCADE) {
+            addCascadeAggregationQueries(cube, factTable, olapCubeTable);
+        }
+        else {
+            cube.addQuery(getCubeAggregationQuery(cube, factTable, olapCubeTable, pruning == PruningStrategy.DIRECT));
+        }
+    }
+
+    // The OLAP cube table the action has filled, olap_cube_delta for a delta.
+    public Table getOLAPCubeTable() {
+        return m_olapCubeTable;
+    }
 
+    // Aggregate all the cuboids at once with GROUP BY CUBE(), DIRECT pruning drops the small groups with HAVING.
+    // GROUPING_ID() tags every group with its cuboid_id (OLAPCubeTableFactory.getCuboidId()).
+    private String getCubeAggregationQuery(PercentageCube cube, Table factTable, Table olapCubeTable, boolean prune) {
+        StringBuilder aggregationQueryBuilder = new StringBuilder();
         StringBuilder dimensionList = new StringBuilder();
         for (Column dimension : cube.getDimensions()) {
             dimensionList.append(dimension.getQuotedColumnName()).append(", ");
@@ -45,22 +82,208 @@ public class PercentageCubeAggregateAction implements PercentageCubeVisitor {
         dimensionList.setLength(dimensionList.length() - 2);
 
         aggregationQueryBuilder.append("INSERT INTO ").append(olapCubeTable.getTableName()).append("\n");
-        aggregationQueryBuilder.append(QuerySet.getIndentationString(1));
-        aggregationQueryBuilder.append("SELECT ").append(dimensionList.toString());
-        aggregationQueryBuilder.append(", COUNT(*), ");
-        if (cube.usesUDF()) {
-            aggregationQueryBuilder.append("SUMNULL(");
+        // CUBE_MEASURE() cannot count the NULLs apart, an incremental cube aggregates with SUMNULL().
+        if (cube.usesFusedUDF() && ! cube.isIncremental()) {
+            appendFusedAggregation(aggregationQueryBuilder, cube, factTable, dimensionList.toString(), prune);
         }
         else {
-            aggregationQueryBuilder.append("SUM(");
+            aggregationQueryBuilder.append(QuerySet.getIndentationString(1));
+            aggregationQueryBuilder.append("SELECT ").append(dimensionList.toString());
+            aggregationQueryBuilder.append(", GROUPING_ID(").append(dimensionList.toString()).append(")");
+            aggregationQueryBuilder.append(", ").append(cube.isIncremental() ? getIncrementalAggregateList(cube)
+                                                                             : "COUNT(*), " + getSumList(cube));
+            aggregationQueryBuilder.append("\n").append(QuerySet.getIndentationString(1));
+            aggregationQueryBuilder.append("FROM ").append(factTable.getTableName()).append("\n");
+            aggregationQueryBuilder.append(QuerySet.getIndentationString(1));
+            aggregationQueryBuilder.append("GROUP BY CUBE(").append(dimensionList.toString()).append(")");
+            if (prune) {
+                aggregationQueryBuilder.append("\n").append(QuerySet.getIndentationString(1));
+                aggregationQueryBuilder.append("HAVING COUNT(*) > ").append(cube.getRowCountThreshold());
+            }
+            aggregationQueryBuilder.append(";");
+        }
+        return aggregationQueryBuilder.toString();
+    }
+
+    // The sums of all the measures, "SUM(m1), SUM(m2), ...".
+    private static String getSumList(PercentageCube cube) {
+        List<String> sums = new ArrayList<>();
+        for (Column measure : cube.getMeasures()) {
+            sums.add(cube.getSumFunctionName() + "(" + measure.getQuotedColumnName() + ")");
         }
-        aggregationQueryBuilder.append(cube.getMeasure().getQuotedColumnName());
-        aggregationQueryBuilder.append(")\n").append(QuerySet.getIndentationString(1));
-        aggregationQueryBuilder.append("FROM ").append(factTable.getTableName()).append("\n");
-        aggregationQueryBuilder.append(QuerySet.getIndentationString(1));
-        aggregationQueryBuilder.append("GROUP BY CUBE(").append(dimensionList.toString()).append(");");
+        return String.join(", ", sums);
+    }
 
-        cube.addAllQueries(createTableQuerySet.getQueries());
-        cube.addQuery(aggregationQueryBuilder.toString());
+    // The count, the sums without the NULLs and the NULL counts of an incremental cube (OLAPCubeTableFactory).
+    // With a sign column, every row adds its sign to the counts and its value times its sign to the sums.
+    private String getIncrementalAggregateList(PercentageCube cube) {
+        String sign = m_signColumn == null ? null : m_signColumn.getQuotedColumnName();
+        List<String> aggregates = new ArrayList<>();
+        aggregates.add(sign == null ? "COUNT(*)" : "SUM(" + sign + ")");
+        for (Column measure : cube.getMeasures()) {
+            String value = "COALESCE(" + measure.getQuotedColumnName() + ", 0)";
+            if (sign != null) {
+                value += " * " + sign;
+            }
+            aggregates.add(cube.getSumFunctionName() + "(" + value + ")");
+        }
+        for (Column measure : cube.getMeasures()) {
+            String measureName = measure.getQuotedColumnName();
+            if (sign == null) {
+                aggregates.add(String.format("COUNT(*) - COUNT(%s)", measureName));
+            }
+            else {
+                aggregates.add(String.format("SUM(CASE WHEN %s IS NULL THEN %s ELSE 0 END)", measureName, sign));
+            }
+        }
+        return String.join(", ", aggregates);
+    }
+
+    // CUBE_MEASURE() computes COUNT(*) and SUMNULL() with one aggregate state and returns them
+    // packed as "<count>|<sum>" (the sum is empty if it is NULL). Split it back into cnt and the measure.
+    // Every measure gets its own CUBE_MEASURE() call, cnt is taken from the first one.
+    private void appendFusedAggregation(StringBuilder queryBuilder, PercentageCube cube,
+                                        Table factTable, String dimensionList, boolean prune) {
+        List<String> fusedValues = new ArrayList<>();
+        List<String> fusedSums = new ArrayList<>();
+        List<Column> measures = cube.getMeasures();
+        for (int i = 0; i < measures.size(); i++) {
+            String fusedColumn = i == 0 ? FUSED_COLUMN : FUSED_COLUMN + i;
+            fusedValues.add("CUBE_MEASURE(" + measures.get(i).getQuotedColumnName() + ") AS " + fusedColumn);
+            fusedSums.add("NULLIF(SPLIT_PART(" + fusedColumn + ", '|', 2), '')::FLOAT");
+        }
+        queryBuilder.append(QuerySet.getIndentationString(1));
+        queryBuilder.append("SELECT ").append(dimensionList).append(", ").append(CUBOID_ID);
+        queryBuilder.append(", SPLIT_PART(").append(FUSED_COLUMN).append(", '|', 1)::INTEGER");
+        queryBuilder.append(", ").append(String.join(", ", fusedSums)).append("\n");
+        queryBuilder.append(QuerySet.getIndentationString(1));
+        queryBuilder.append("FROM (SELECT ").append(dimensionList);
+        queryBuilder.append(", GROUPING_ID(").append(dimensionList).append(") AS ").append(CUBOID_ID);
+        queryBuilder.append(", ").append(String.join(", ", fusedValues)).append("\n");
+        queryBuilder.append(QuerySet.getIndentationString(2));
+        queryBuilder.append("FROM ").append(factTable.getTableName()).append("\n");
+        queryBuilder.append(QuerySet.getIndentationString(2));
+        queryBuilder.append("GROUP BY CUBE(").append(dimensionList).append(")) fused");
+        if (prune) {
+            queryBuilder.append("\n").append(QuerySet.getIndentationString(1));
+            queryBuilder.append("WHERE SPLIT_PART(").append(FUSED_COLUMN).append(", '|', 1)::INTEGER > ");
+            queryBuilder.append(cube.getRowCountThreshold());
+        }
+        queryBuilder.append(";");
+    }
+
+    // CASCADE pruning aggregates the cuboids one by one, from the coarsest to the finest. The row count of a group
+    // can only go down when a dimension is added (apriori property), so a fact row only needs to be aggregated into
+    // a cuboid if it falls into a group that passed the threshold in every parent cuboid (one dimension fewer).
+    // Rows failing in any parent are filtered out before the aggregation with semi-joins on the OLAP cube itself.
+    // The semi-joins match the keys with <=>, a NULL dimension value is a group of its own like with the other
+    // pruning strategies.
+    // The cuboids are the same as DIRECT's, only the cost differs: the grand total and the single-dimension cuboids
+    // have no parent to filter with and are aggregated in one pass, then every other cuboid takes a scan of the fact
+    // table with one semi-join per parent, 2^d - d - 1 scans against the one GROUP BY CUBE() pass of DIRECT.
+    // CASCADE only pays off when the semi-joins drop most of the fact rows before the finer cuboids are grouped,
+    // that is a threshold that most groups of the two-dimension cuboids fail already (high-cardinality dimensions,
+    // few dimensions). Otherwise DIRECT is the cheaper one.
+    private void addCascadeAggregationQueries(PercentageCube cube, Table factTable, Table olapCubeTable) {
+        List<Column> dimensions = cube.getDimensions();
+        cube.addQuery(getTopCuboidsAggregationQuery(cube, factTable, olapCubeTable));
+
+        CombinationGenerator<Column> dimensionSelector = new CombinationGenerator<>(dimensions);
+        for (int numOfSelectedDimensions = 2;
+                numOfSelectedDimensions <= dimensions.size();
+                numOfSelectedDimensions++) {
+
+            dimensionSelector.setNumOfElementsToSelect(numOfSelectedDimensions);
+            for (List<Column> selection : dimensionSelector) {
+                List<Integer> selectionFlags = dimensionSelector.getCurrentSelectionFlags();
+                List<String> selectedDimensionNames = new ArrayList<>();
+                // The values for all the dimensions. If a dimension is not selected, use NULL.
+                List<String> dimensionValues = new ArrayList<>();
+                for (int i = 0; i < selectionFlags.size(); i++) {
+                    String columnName = dimensions.get(i).getQuotedColumnName();
+                    if (selectionFlags.get(i) == 0) {
+                        dimensionValues.add("NULL");
+                    }
+                    else {
+                        selectedDimensionNames.add(columnName);
+                        dimensionValues.add(columnName);
+                    }
+                }
+
+                StringBuilder queryBuilder = new StringBuilder();
+                queryBuilder.append("INSERT INTO ").append(olapCubeTable.getTableName()).append("\n");
+                queryBuilder.append(QuerySet.getIndentationString(1));
+                queryBuilder.append("SELECT ").append(String.join(", ", dimensionValues));
+                queryBuilder.append(", ").append(OLAPCubeTableFactory.getCuboidId(selectionFlags));
+                queryBuilder.append(", COUNT(*), ").append(getSumList(cube)).append("\n");
+                queryBuilder.append(QuerySet.getIndentationString(1));
+                queryBuilder.append("FROM ").append(factTable.getTableName()).append(" f");
+                List<String> semiJoins = new ArrayList<>();
+                for (int excluded = 0; excluded < selection.size(); excluded++) {
+                    semiJoins.add(getParentSemiJoin(dimensions, selection, excluded, olapCubeTable));
+                }
+                queryBuilder.append("\n").append(QuerySet.getIndentationString(1)).append("WHERE ");
+                queryBuilder.append(String.join(" AND\n" + QuerySet.getIndentationString(2), semiJoins));
+                queryBuilder.append("\n").append(QuerySet.getIndentationString(1));
+                queryBuilder.append("GROUP BY ").append(String.join(", ", selectedDimensionNames));
+                queryBuilder.append("\n").append(QuerySet.getIndentationString(1));
+                queryBuilder.append("HAVING COUNT(*) > ").append(cube.getRowCountThreshold()).append(";");
+                cube.addQuery(queryBuilder.toString());
+            }
+        }
+    }
+
+    // The grand total and the single-dimension cuboids of CASCADE pruning, in one pass with GROUPING SETS.
+    // The only parent of a single-dimension cuboid is the grand total, which does not filter any row.
+    private String getTopCuboidsAggregationQuery(PercentageCube cube, Table factTable, Table olapCubeTable) {
+        List<String> dimensionNames = new ArrayList<>();
+        List<String> groupingSets = new ArrayList<>();
+        groupingSets.add("()");
+        for (Column dimension : cube.getDimensions()) {
+            dimensionNames.add(dimension.getQuotedColumnName());
+            groupingSets.add("(" + dimension.getQuotedColumnName() + ")");
+        }
+        String dimensionList = String.join(", ", dimensionNames);
+        StringBuilder queryBuilder = new StringBuilder();
+        queryBuilder.append("INSERT INTO ").append(olapCubeTable.getTableName()).append("\n");
+        queryBuilder.append(QuerySet.getIndentationString(1));
+        queryBuilder.append("SELECT ").append(dimensionList).append(", GROUPING_ID(").append(dimensionList);
+        queryBuilder.append("), COUNT(*), ").append(getSumList(cube)).append("\n");
+        queryBuilder.append(QuerySet.getIndentationString(1));
+        queryBuilder.append("FROM ").append(factTable.getTableName()).append("\n");
+        queryBuilder.append(QuerySet.getIndentationString(1));
+        queryBuilder.append("GROUP BY GROUPING SETS(").append(String.join(", ", groupingSets)).append(")\n");
+        queryBuilder.append(QuerySet.getIndentationString(1));
+        queryBuilder.append("HAVING COUNT(*) > ").append(cube.getRowCountThreshold()).append(";");
+        return queryBuilder.toString();
     }
+
+    // The fact row (f) falls into a group of the parent cuboid without the excluded dimension that passed the
+    // threshold. IN would never match a NULL key, so the keys are compared with <=> in a correlated EXISTS.
+    private String getParentSemiJoin(List<Column> dimensions, List<Column> selection,
+                                     int excluded, Table olapCubeTable) {
+        List<String> keyPredicates = new ArrayList<>();
+        List<Integer> parentSelectionFlags = new ArrayList<>();
+        for (Column dimension : dimensions) {
+            int index = selection.indexOf(dimension);
+            if (index < 0 || index == excluded) {
+                parentSelectionFlags.add(0);
+            }
+            else {
+                keyPredicates.add(String.format("p.%1$s <=> f.%1$s", dimension.getQuotedColumnName()));
+                parentSelectionFlags.add(1);
+            }
+        }
+        StringBuilder builder = new StringBuilder("EXISTS (SELECT 1 FROM ");
+        builder.append(olapCubeTable.getTableName()).append(" p WHERE p.").append(CUBOID_ID).append(" = ");
+        builder.append(OLAPCubeTableFactory.getCuboidId(parentSelectionFlags));
+        for (String keyPredicate : keyPredicates) {
+            builder.append(" AND ").append(keyPredicate);
+        }
+        builder.append(")");
+        return builder.toString();
+    }
+
+    private static final String FUSED_COLUMN = "cube_measure";
+    private static final String CUBOID_ID = OLAPCubeTableFactory.CUBOID_ID_COLUMN;
 }
@@ -1,28 +1,322 @@
 package pctcube;
 
 import java.util.ArrayList;
+import java.util.Collections;
+import java.util.LinkedHashSet;
 import java.util.List;
+import java.util.Set;
 
 import pctcube.PercentageCube.PercentageCubeVisitor;
 import pctcube.database.Column;
+import pctcube.database.Table;
 import pctcube.database.query.QuerySet;
 import pctcube.utils.CombinationGenerator;
 import pctcube.utils.PermutationGenerator;
 
 public class PercentageCubeAssembler implements PercentageCubeVisitor {
 
+    private Table m_deltaOLAPCubeTable = null;
+
+    public PercentageCubeAssembler() {
+
+    }
+
+    // Only reassemble the totals the delta OLAP cube (PercentageCubeAggregateAction) has groups in,
+    // the OLAP cube has already been merged with it (PercentageCubeDeltaMergeAction). GROUPBY only.
+    public PercentageCubeAssembler(Table deltaOLAPCubeTable) {
+        m_deltaOLAPCubeTable = deltaOLAPCubeTable;
+    }
+
     @Override
     public void visit(PercentageCube cube) {
         if (cube.getEvaluationMethod() == EvaluationMethod.GROUPBY) {
             assembleGroupBy(cube);
         }
-        else {
+        else if (cube.getEvaluationMethod() == EvaluationMethod.OLAP) {
             assembleOLAP(cube);
         }
+        else if (cube.getEvaluationMethod() == EvaluationMethod.LATTICE) {
+            assembleLattice(cube);
+        }
+        else {
+            assembleUDTF(cube);
+        }
     }
 
+    // Every (total by, break down by) split divides by the groups of its total-by cuboid, and the same total-by
+    // cuboid is the denominator of many splits (all the orders of its keys, all the break-down-by sets).
+    // So the splits are enumerated per total-by cuboid, and each denominator is read from the OLAP cube as a
+    // materialized WITH clause shared by the UNION ALL of its splits. The grand total alone has
+    // sum(C(d, k) * k!) splits, so an INSERT takes at most DENOMINATOR_BATCH_SIZE of them: no statement grows
+    // past what the planner handles, and a streamed query set (QuerySet.setQuerySink()) only holds one batch.
+    // With a delta, the rows of the totals it touches are deleted first, and the denominator only keeps those
+    // totals. Every other total has the same groups and sums as before, its rows are left in place.
     private void assembleGroupBy(PercentageCube cube) {
 
+        String measureList = getMeasureList(cube);
+        List<Column> dimensions = cube.getDimensions();
+        CombinationGenerator<Column> dimensionSelector = new CombinationGenerator<>(dimensions);
+
+        // The grand total (the largest cuboid_id) first. The base cuboid (0) has no key left to break down by.
+        for (int totalCuboidId = (1 << dimensions.size()) - 1; totalCuboidId > 0; totalCuboidId--) {
+            // The total-by keys, in dimension order: the dimensions whose bit is not set.
+            List<Column> totalByKeys = new ArrayList<>();
+            for (int i = 0; i < dimensions.size(); i++) {
+                if ((totalCuboidId & (1 << (dimensions.size() - 1 - i))) == 0) {
+                    totalByKeys.add(dimensions.get(i));
+                }
+            }
+            List<String> keyNames = PercentageCubeSplit.getQuotedColumnNames(totalByKeys);
+            if (m_deltaOLAPCubeTable != null) {
+                addDeleteQuery(cube, getTotalByLabels(cube, totalByKeys), keyNames, totalCuboidId);
+            }
+            List<String> splitQueries = new ArrayList<>();
+
+            // Select the dimensions that are not "ALL"s, at least one more than the total-by keys.
+            for (int numOfSelectedDimensions = dimensions.size();
+                    numOfSelectedDimensions > totalByKeys.size();
+                    numOfSelectedDimensions--) {
+
+                dimensionSelector.setNumOfElementsToSelect(numOfSelectedDimensions);
+                for (List<Column> selection : dimensionSelector) {
+                    if (! selection.containsAll(totalByKeys)) {
+                        continue;
+                    }
+
+                    List<Integer> selectionFlags = dimensionSelector.getCurrentSelectionFlags();
+                    int individualCuboidId = OLAPCubeTableFactory.getCuboidId(selectionFlags);
+                    // The values for all the dimensions. If a dimension is not selected, use NULL.
+                    List<String> dimensionValues = new ArrayList<>();
+                    for (int i = 0; i < selectionFlags.size(); i++) {
+                        String columnName = dimensions.get(i).getQuotedColumnName();
+                        if (selectionFlags.get(i) == 0) {
+                            // not selected.
+                            dimensionValues.add("NULL");
+                        }
+                        else {
+                            // selected.
+                            dimensionValues.add("b." + columnName);
+                        }
+                    }
+
+                    for (PercentageCubeSplit split : PercentageCubeSplit.getSplits(cube, selection, totalByKeys)) {
+                        List<String> values = new ArrayList<>();
+                        // Assemble the strings in the "total by" and the "break down by" columns.
+                        values.add("'" + split.getTotalByLabel() + "'");
+                        values.add("'" + split.getBreakdownByLabel() + "'");
+                        // Add all the dimension values, add NULL if the dimension is not selected.
+                        values.addAll(dimensionValues);
+                        splitQueries.add(getGroupBySplitQuery(cube, split, values, measureList, individualCuboidId));
+                        if (splitQueries.size() == DENOMINATOR_BATCH_SIZE) {
+                            addDenominatorQuery(cube, totalCuboidId, keyNames, splitQueries, measureList);
+                        }
+                    }
+                }
+            }
+            if (! splitQueries.isEmpty()) {
+                addDenominatorQuery(cube, totalCuboidId, keyNames, splitQueries, measureList);
+            }
+        }
+    }
+
+    // The "total by" labels of the splits of a total-by cuboid: every order of its keys, or only the dimension
+    // order in canonical mode (PercentageCubeSplit.getSplits()).
+    private static Set<String> getTotalByLabels(PercentageCube cube, List<Column> totalByKeys) {
+        Set<String> retval = new LinkedHashSet<>();
+        if (cube.isCanonical()) {
+            retval.add("'" + String.join(",", PercentageCubeSplit.getQuotedColumnNames(totalByKeys)) + "'");
+            return retval;
+        }
+        for (List<Column> permutation : new PermutationGenerator<>(totalByKeys)) {
+            retval.add("'" + String.join(",", PercentageCubeSplit.getQuotedColumnNames(permutation)) + "'");
+        }
+        return retval;
+    }
+
+    // Total level aggregation (a) join individual level aggregation (b) (smaller table join larger table).
+    private String getGroupBySplitQuery(PercentageCube cube, PercentageCubeSplit split, List<String> values,
+                                        String measureList, int individualCuboidId) {
+        List<String> totalByColumnNames = split.getTotalByColumnNames();
+        List<String> breakdownByColumnNames = split.getBreakdownByColumnNames();
+        StringBuilder queryBuilder = new StringBuilder();
+        queryBuilder.append(DENOMINATOR_NAME).append(" a JOIN\n").append(QuerySet.getIndentationString(2));
+
+        // Individual level aggregation, group by both total-by keys and breakdown-by keys:
+        queryBuilder.append("(SELECT ");
+        queryBuilder.append(String.join(", ", totalByColumnNames));
+        if (totalByColumnNames.size() > 0) {
+            queryBuilder.append(", ");
+        }
+        queryBuilder.append(String.join(", ", breakdownByColumnNames));
+        queryBuilder.append(", cnt, ").append(measureList);
+        queryBuilder.append(" FROM ").append(cube.getOLAPCubeTable().getTableName());
+        queryBuilder.append(" WHERE ").append(getCuboidPredicate(cube, individualCuboidId));
+        queryBuilder.append(") b ON\n").append(QuerySet.getIndentationString(2));
+
+        // The cuboid_id tells a NULL key value from an "ALL", so a NULL is a total of its own.
+        if (totalByColumnNames.size() == 0) {
+            queryBuilder.append("1 = 1");
+        }
+        else {
+            for (int i = 0; i < totalByColumnNames.size(); i++) {
+                String totalByColumnName = totalByColumnNames.get(i);
+                queryBuilder.append(String.format("a.%s <=> b.%s", totalByColumnName, totalByColumnName));
+                if (i < totalByColumnNames.size() - 1) {
+                    queryBuilder.append(" AND ");
+                }
+            }
+        }
+        return getSplitQuery(cube, values, queryBuilder.toString(), totalByColumnNames);
+    }
+
+    // The INSERT of a batch of splits of a denominator, then the batch is emptied. With a delta, it comes after
+    // the DELETE of the totals the delta touches, and the denominator only keeps those totals.
+    private void addDenominatorQuery(PercentageCube cube, int totalCuboidId, List<String> keyNames,
+                                     List<String> splitQueries, String measureList) {
+        List<String> columnNames = new ArrayList<>(keyNames);
+        columnNames.add("cnt");
+        columnNames.add(measureList);
+        String denominatorPredicate = getCuboidPredicate(cube, totalCuboidId);
+        if (m_deltaOLAPCubeTable != null) {
+            if (keyNames.size() > 0) {
+                denominatorPredicate += " AND " + getTouchedPredicate(
+                        cube.getOLAPCubeTable().getTableName(), keyNames, totalCuboidId);
+            }
+        }
+
+        StringBuilder queryBuilder = new StringBuilder();
+        queryBuilder.append("INSERT INTO ");
+        queryBuilder.append(cube.getPercentageCubeTable().getTableName());
+        queryBuilder.append("\n").append(QuerySet.getIndentationString(1));
+        queryBuilder.append("WITH /*+ENABLE_WITH_CLAUSE_MATERIALIZATION*/ ").append(DENOMINATOR_NAME);
+        queryBuilder.append(" AS (SELECT ").append(String.join(", ", columnNames));
+        queryBuilder.append(" FROM ").append(cube.getOLAPCubeTable().getTableName());
+        queryBuilder.append(" WHERE ").append(denominatorPredicate).append(")\n");
+        queryBuilder.append(QuerySet.getIndentationString(1));
+        queryBuilder.append(String.join(" UNION ALL\n" + QuerySet.getIndentationString(1), splitQueries));
+        queryBuilder.append(";");
+        cube.addQuery(queryBuilder.toString());
+        splitQueries.clear();
+    }
+
+    // Delete the rows of the totals the delta touches from every split of a total-by cuboid. The grand total
+    // (no total-by key) is touched by any delta.
+    private void addDeleteQuery(PercentageCube cube, Set<String> labels, List<String> keyNames, int cuboidId) {
+        String tableName = cube.getPercentageCubeTable().getTableName();
+        StringBuilder queryBuilder = new StringBuilder("DELETE FROM ");
+        queryBuilder.append(tableName).append(" WHERE ");
+        queryBuilder.append(cube.getPercentageCubeTable().getColumns().get(0).getQuotedColumnName());
+        queryBuilder.append(" IN (").append(String.join(", ", labels)).append(")");
+        if (keyNames.size() > 0) {
+            queryBuilder.append(" AND\n").append(QuerySet.getIndentationString(1));
+            queryBuilder.append(getTouchedPredicate(tableName, keyNames, cuboidId));
+        }
+        queryBuilder.append(";");
+        cube.addQuery(queryBuilder.toString());
+    }
+
+    // The total-by key values of a row of the table are those of a group of the delta in the total-by cuboid.
+    // A NULL key value is a total of its own, so they are matched with <=>.
+    private String getTouchedPredicate(String tableName, List<String> keyNames, int cuboidId) {
+        StringBuilder builder = new StringBuilder("EXISTS (SELECT 1 FROM ");
+        builder.append(m_deltaOLAPCubeTable.getTableName()).append(" d WHERE d.");
+        builder.append(OLAPCubeTableFactory.CUBOID_ID_COLUMN).append(" = ").append(cuboidId);
+        for (String keyName : keyNames) {
+            builder.append(String.format(" AND d.%1$s <=> %2$s.%1$s", keyName, tableName));
+        }
+        builder.append(")");
+        return builder.toString();
+    }
+
+    // Selects the groups of a cuboid from the OLAP cube, which only reads the partition of the cuboid.
+    private static String getCuboidPredicate(PercentageCube cube, int cuboidId) {
+        StringBuilder builder = new StringBuilder();
+        if (cube.getRowCountThreshold() > 0) {
+            builder.append("cnt > ").append(cube.getRowCountThreshold()).append(" AND ");
+        }
+        builder.append(OLAPCubeTableFactory.CUBOID_ID_COLUMN).append(" = ").append(cuboidId);
+        return builder.toString();
+    }
+
+    // The SELECT of the rows of one split: the label and dimension values, then the percentage of every measure,
+    // the individual sum (b) over the total sum (a), from the join of the two. A NULL sum or a zero total gives a
+    // NULL percentage, like the PCT_OF_TOTAL and PERCENTAGE_CUBE UDxs do.
+    // With the top k pushed down (PercentageCube.isTopKPushedDown()), the rows are ranked by the percentage of
+    // the first measure within every total, and only the top k rows of each total are kept, the same topk=k
+    // the filter of the full cube computes (PercentageCubeTopKFilter).
+    private static String getSplitQuery(PercentageCube cube, List<String> values, String fromClause,
+                                        List<String> totalByColumnNames) {
+        List<Column> measures = cube.getMeasures();
+        List<String> percentages = new ArrayList<>();
+        for (Column measure : measures) {
+            String measureName = measure.getQuotedColumnName();
+            percentages.add(String.format("b.%s / NULLIF(a.%s, 0)", measureName, measureName));
+        }
+
+        StringBuilder queryBuilder = new StringBuilder("SELECT ");
+        if (! cube.isTopKPushedDown()) {
+            queryBuilder.append(String.join(", ", values));
+            for (int i = 0; i < measures.size(); i++) {
+                queryBuilder.append(", ").append(percentages.get(i));
+                queryBuilder.append(" AS ").append(measures.get(i).getQuotedColumnName());
+            }
+            queryBuilder.append(" FROM\n").append(QuerySet.getIndentationString(2)).append(fromClause);
+            return queryBuilder.toString();
+        }
+
+        List<String> columnNames = new ArrayList<>();
+        for (Column column : cube.getPercentageCubeTable().getColumns()) {
+            columnNames.add(column.getQuotedColumnName());
+        }
+        List<String> rankedValues = new ArrayList<>(values);
+        rankedValues.addAll(percentages);
+        for (int i = 0; i < rankedValues.size(); i++) {
+            rankedValues.set(i, rankedValues.get(i) + " AS " + columnNames.get(i));
+        }
+        List<String> partitionKeys = new ArrayList<>();
+        for (String totalByColumnName : totalByColumnNames) {
+            partitionKeys.add("b." + totalByColumnName);
+        }
+
+        queryBuilder.append(String.join(", ", columnNames)).append(" FROM\n");
+        queryBuilder.append(QuerySet.getIndentationString(2));
+        queryBuilder.append("(SELECT ").append(String.join(", ", rankedValues)).append(",\n");
+        queryBuilder.append(QuerySet.getIndentationString(3)).append("ROW_NUMBER() OVER (");
+        if (partitionKeys.size() > 0) {
+            queryBuilder.append("PARTITION BY ").append(String.join(", ", partitionKeys)).append(" ");
+        }
+        queryBuilder.append("ORDER BY ").append(percentages.get(0)).append(" DESC NULLS LAST) AS ");
+        queryBuilder.append(RANK_COLUMN);
+        queryBuilder.append(" FROM\n").append(QuerySet.getIndentationString(3));
+        queryBuilder.append(fromClause.replace("\n" + QuerySet.getIndentationString(2),
+                                               "\n" + QuerySet.getIndentationString(3)));
+        queryBuilder.append(") ranked\n").append(QuerySet.getIndentationString(2));
+        queryBuilder.append("WHERE ").append(RANK_COLUMN).append(" <= ").append(cube.getTopK());
+        return queryBuilder.toString();
+    }
+
+    // The sums of the measures in the OLAP cube. The sums of an incremental cube skip the NULLs
+    // (OLAPCubeTableFactory), they get their NULL back from the counts: SUMNULL() is NULL if the group
+    // has a NULL value, SUM() if it has no other value.
+    private static String getMeasureList(PercentageCube cube) {
+        List<String> measureNames = new ArrayList<>();
+        for (Column measure : cube.getMeasures()) {
+            String measureName = measure.getQuotedColumnName();
+            if (! cube.isIncremental()) {
+                measureNames.add(measureName);
+                continue;
+            }
+            String nullCountName = OLAPCubeTableFactory.getNullCountColumn(measure).getQuotedColumnName();
+            String condition = cube.usesUDF() ? nullCountName + " = 0" : "cnt > " + nullCountName;
+            measureNames.add(String.format("CASE WHEN %s THEN %s END AS %s", condition, measureName, measureName));
+        }
+        return String.join(", ", measureNames);
+    }
+
+    // The OLAP method works directly on the fact table. PCT_OF_TOTAL() partitions the rows by the total-by keys,
+    // orders them by the break-down-by keys, and emits one percentage row per break-down group in a single pass.
+    private void assembleOLAP(PercentageCube cube) {
+
         String measureName = cube.getMeasure().getQuotedColumnName();
         List<Column> dimensions = cube.getDimensions();
         CombinationGenerator<Column> dimensionSelector = new CombinationGenerator<>(dimensions);
@@ -36,137 +330,161 @@ public class PercentageCubeAssembler implements PercentageCubeVisitor {
             for (List<Column> selection : dimensionSelector) {
 
                 List<Integer> selectionFlags = dimensionSelector.getCurrentSelectionFlags();
-                List<String> unselectedDimensionNames = new ArrayList<>();
-                List<String> selectedDimensionNames = new ArrayList<>();
                 // The values for all the dimensions. If a dimension is not selected, use NULL.
                 List<String> dimensionValues = new ArrayList<>();
                 for (int i = 0; i < selectionFlags.size(); i++) {
-                    String columnName = dimensions.get(i).getQuotedColumnName();
                     if (selectionFlags.get(i) == 0) {
-                        // not selected.
-                        unselectedDimensionNames.add(columnName);
                         dimensionValues.add("NULL");
                     }
                     else {
-                        // selected.
-                        selectedDimensionNames.add(columnName);
-                        dimensionValues.add("b." + columnName);
+                        dimensionValues.add("p." + dimensions.get(i).getQuotedColumnName());
                     }
                 }
 
-                // Exhaust all the possible orders of the selected dimensions.
-                PermutationGenerator<Column> pgen = new PermutationGenerator<>(selection);
-                for (List<Column> permutation : pgen) {
+                for (PercentageCubeSplit split : PercentageCubeSplit.getSplits(cube, selection)) {
 
-                    // Total-by key count varies from 0 (global aggregation) to dimension size minus one.
-                    // This is because at least one dimension needs to be selected as the break-down-by key.
-                    for (int totalByKeyCount = 0; totalByKeyCount < selection.size(); totalByKeyCount++) {
+                    List<String> totalByColumnNames = split.getTotalByColumnNames();
+                    List<String> breakdownByColumnNames = split.getBreakdownByColumnNames();
 
-                        List<String> totalByColumnNames = new ArrayList<>();
-                        List<String> breakdownByColumnNames = new ArrayList<>();
-                        for (int i = 0; i < totalByKeyCount; i++) {
-                            totalByColumnNames.add(permutation.get(i).getQuotedColumnName());
-                        }
-                        for (int i = totalByKeyCount; i < permutation.size(); i++) {
-                            breakdownByColumnNames.add(permutation.get(i).getQuotedColumnName());
-                        }
+                    StringBuilder queryBuilder = new StringBuilder();
 
-                        StringBuilder queryBuilder = new StringBuilder();
+                    queryBuilder.append("INSERT INTO ");
+                    queryBuilder.append(cube.getPercentageCubeTable().getTableName());
+                    queryBuilder.append("\n").append(QuerySet.getIndentationString(1));
 
-                        queryBuilder.append("INSERT INTO ");
-                        queryBuilder.append(cube.getPercentageCubeTable().getTableName());
-                        queryBuilder.append("\n").append(QuerySet.getIndentationString(1));
+                    queryBuilder.append("SELECT '");
+                    queryBuilder.append(String.join(",", totalByColumnNames));
+                    queryBuilder.append("', '");
+                    queryBuilder.append(String.join(",", breakdownByColumnNames));
+                    queryBuilder.append("', ");
+                    queryBuilder.append(String.join(", ", dimensionValues));
+                    queryBuilder.append(", p.pct_of_total FROM\n").append(QuerySet.getIndentationString(2));
 
-                        queryBuilder.append("SELECT '");
-                        // Assemble the string in the "total by" column.
-                        queryBuilder.append(String.join(",", totalByColumnNames));
-                        queryBuilder.append("', '");
+                    queryBuilder.append("(SELECT PCT_OF_TOTAL(");
+                    queryBuilder.append(String.join(", ", totalByColumnNames));
+                    if (totalByColumnNames.size() > 0) {
+                        queryBuilder.append(", ");
+                    }
+                    queryBuilder.append(String.join(", ", breakdownByColumnNames));
+                    queryBuilder.append(", ").append(measureName);
+                    queryBuilder.append(" USING PARAMETERS rowcount=").append(cube.getRowCountThreshold());
+                    queryBuilder.append(", sumnull=").append(cube.usesUDF()).append(")\n");
+                    queryBuilder.append(QuerySet.getIndentationString(2)).append("OVER (");
+                    if (totalByColumnNames.size() > 0) {
+                        queryBuilder.append("PARTITION BY ").append(String.join(", ", totalByColumnNames));
+                        queryBuilder.append(" ");
+                    }
+                    queryBuilder.append("ORDER BY ").append(String.join(", ", breakdownByColumnNames));
+                    queryBuilder.append(") FROM ").append(cube.getFactTable().getTableName());
+                    queryBuilder.append(") p;");
+                    cube.addQuery(queryBuilder.toString());
+                }
+            }
+        }
+    }
 
-                        // Assemble the string in the "break down by" column.
-                        queryBuilder.append(String.join(",", breakdownByColumnNames));
-                        queryBuilder.append("', ");
+    // The lattice method has materialized every cuboid into its own AggregationTempTable (PercentageCubeLatticeAction),
+    // so the totals (a) and the individual groups (b) are read from the two cuboid tables directly. A cuboid table
+    // has no "ALL" rows, a NULL key value is a group (and a total) of its own, like in the other methods.
+    private void assembleLattice(PercentageCube cube) {
 
-                        // Add all the dimension values, add NULL if the dimension is not selected.
-                        queryBuilder.append(String.join(", ", dimensionValues));
-
-                        // Compute the percentage value.
-                        queryBuilder.append(", b.").append(measureName);
-                        queryBuilder.append(" / a.").append(measureName);
-                        queryBuilder.append(" AS ").append(measureName);
-
-                        queryBuilder.append(" FROM\n").append(QuerySet.getIndentationString(2));
-                        // Total level aggregation (a) join individual level aggregation (b) (smaller table join larger table)
-                        // Total level aggregation, group by total-by keys:
-                        queryBuilder.append("(SELECT ");
-                        queryBuilder.append(String.join(", ", totalByColumnNames));
-                        if (totalByColumnNames.size() > 0) {
-                            queryBuilder.append(", ");
-                        }
-                        queryBuilder.append("cnt, ").append(measureName);
-                        queryBuilder.append(" FROM ").append(cube.getOLAPCubeTable().getTableName());
-                        queryBuilder.append(" WHERE ");
-                        if (cube.getRowCountThreshold() > 0) {
-                            queryBuilder.append("cnt > ").append(cube.getRowCountThreshold());
-                            queryBuilder.append(" AND ");
-                        }
-                        queryBuilder.append(String.join(" IS NULL AND ", unselectedDimensionNames));
-                        if (unselectedDimensionNames.size() > 0) {
-                            queryBuilder.append(" IS NULL AND ");
-                        }
-                        queryBuilder.append(String.join(" IS NOT NULL AND ", totalByColumnNames));
-                        if (totalByColumnNames.size() > 0) {
-                            queryBuilder.append(" IS NOT NULL AND ");
-                        }
-                        queryBuilder.append(String.join(" IS NULL AND ", breakdownByColumnNames));
-                        queryBuilder.append(" IS NULL) a JOIN\n").append(QuerySet.getIndentationString(2));
-
-                        // Individual level aggregation, group by both total-by keys and breakdown-by keys:
-                        queryBuilder.append("(SELECT ");
-                        queryBuilder.append(String.join(", ", totalByColumnNames));
-                        if (totalByColumnNames.size() > 0) {
-                            queryBuilder.append(", ");
-                        }
-                        queryBuilder.append(String.join(", ", breakdownByColumnNames));
-                        queryBuilder.append(", cnt, ").append(measureName);
-                        queryBuilder.append(" FROM ").append(cube.getOLAPCubeTable().getTableName());
-                        queryBuilder.append(" WHERE ");
-                        if (cube.getRowCountThreshold() > 0) {
-                            queryBuilder.append("cnt > ").append(cube.getRowCountThreshold());
-                            queryBuilder.append(" AND ");
-                        }
-                        queryBuilder.append(String.join(" IS NULL AND ", unselectedDimensionNames));
-                        if (unselectedDimensionNames.size() > 0) {
-                            queryBuilder.append(" IS NULL AND ");
-                        }
-                        queryBuilder.append(String.join(" IS NOT NULL AND ", totalByColumnNames));
-                        if (totalByColumnNames.size() > 0) {
-                            queryBuilder.append(" IS NOT NULL AND ");
-                        }
-                        queryBuilder.append(String.join(" IS NOT NULL AND ", breakdownByColumnNames));
-                        queryBuilder.append(" IS NOT NULL) b ON\n").append(QuerySet.getIndentationString(2));
+        List<Column> dimensions = cube.getDimensions();
+        CombinationGenerator<Column> dimensionSelector = new CombinationGenerator<>(dimensions);
+        // Select the dimensions that are not "ALL"s.
 
-                        if (totalByColumnNames.size() == 0) {
-                            queryBuilder.append("1 = 1");
-                        }
-                        else {
-                            for (int i = 0; i < totalByColumnNames.size(); i++) {
-                                String totalByColumnName = totalByColumnNames.get(i);
-                                queryBuilder.append(String.format("a.%s = b.%s", totalByColumnName, totalByColumnName));
-                                if (i < totalByColumnNames.size() - 1) {
-                                    queryBuilder.append(" AND ");
-                                }
+        for (int numOfSelectedDimensions = cube.getDimensions().size();
+                numOfSelectedDimensions >= 1;
+                numOfSelectedDimensions--) {
+
+            dimensionSelector.setNumOfElementsToSelect(numOfSelectedDimensions);
+            for (List<Column> selection : dimensionSelector) {
+
+                List<Integer> selectionFlags = dimensionSelector.getCurrentSelectionFlags();
+                String individualTableName = AggregationTempTable.getAggregationTempTableName(selectionFlags);
+                // The values for all the dimensions. If a dimension is not selected, use NULL.
+                List<String> dimensionValues = new ArrayList<>();
+                for (int i = 0; i < selectionFlags.size(); i++) {
+                    if (selectionFlags.get(i) == 0) {
+                        dimensionValues.add("NULL");
+                    }
+                    else {
+                        dimensionValues.add("b." + dimensions.get(i).getQuotedColumnName());
+                    }
+                }
+
+                for (PercentageCubeSplit split : PercentageCubeSplit.getSplits(cube, selection)) {
+
+                    List<String> totalByColumnNames = split.getTotalByColumnNames();
+                    List<String> breakdownByColumnNames = split.getBreakdownByColumnNames();
+                    List<Integer> totalBySelectionFlags = new ArrayList<>(Collections.nCopies(dimensions.size(), 0));
+                    for (Column totalByColumn : split.getTotalByColumns()) {
+                        totalBySelectionFlags.set(dimensions.indexOf(totalByColumn), 1);
+                    }
+
+                    List<String> values = new ArrayList<>();
+                    values.add("'" + String.join(",", totalByColumnNames) + "'");
+                    values.add("'" + String.join(",", breakdownByColumnNames) + "'");
+                    values.addAll(dimensionValues);
+
+                    StringBuilder queryBuilder = new StringBuilder();
+                    queryBuilder.append(AggregationTempTable.getAggregationTempTableName(totalBySelectionFlags));
+                    queryBuilder.append(" a JOIN ").append(individualTableName).append(" b ON\n");
+                    queryBuilder.append(QuerySet.getIndentationString(2));
+                    if (totalByColumnNames.size() == 0) {
+                        queryBuilder.append("1 = 1");
+                    }
+                    else {
+                        for (int i = 0; i < totalByColumnNames.size(); i++) {
+                            String totalByColumnName = totalByColumnNames.get(i);
+                            queryBuilder.append(String.format("a.%s <=> b.%s", totalByColumnName, totalByColumnName));
+                            if (i < totalByColumnNames.size() - 1) {
+                                queryBuilder.append(" AND ");
                             }
                         }
-                        queryBuilder.append(";");
-                        cube.addQuery(queryBuilder.toString());
                     }
+
+                    if (cube.getRowCountThreshold() > 0) {
+                        queryBuilder.append(" WHERE a.cnt > ").append(cube.getRowCountThreshold());
+                        queryBuilder.append(" AND b.cnt > ").append(cube.getRowCountThreshold());
+                    }
+
+                    StringBuilder insertBuilder = new StringBuilder("INSERT INTO ");
+                    insertBuilder.append(cube.getPercentageCubeTable().getTableName());
+                    insertBuilder.append("\n").append(QuerySet.getIndentationString(1));
+                    insertBuilder.append(getSplitQuery(cube, values, queryBuilder.toString(), totalByColumnNames));
+                    insertBuilder.append(";");
+                    cube.addQuery(insertBuilder.toString());
                 }
             }
         }
     }
 
-    private void assembleOLAP(PercentageCube cube) {
+    // The multi-phase PERCENTAGE_CUBE() transform builds a partial cube on every node, merges it per cuboid
+    // and emits the pct_cube rows directly, so the whole cube takes one distributed scan of the fact table.
+    private void assembleUDTF(PercentageCube cube) {
+        List<String> dimensionNames = new ArrayList<>();
+        for (Column dimension : cube.getDimensions()) {
+            dimensionNames.add(dimension.getQuotedColumnName());
+        }
+
         StringBuilder queryBuilder = new StringBuilder();
+        queryBuilder.append("INSERT INTO ");
+        queryBuilder.append(cube.getPercentageCubeTable().getTableName());
+        queryBuilder.append("\n").append(QuerySet.getIndentationString(1));
+        queryBuilder.append("SELECT PERCENTAGE_CUBE(").append(String.join(", ", dimensionNames));
+        queryBuilder.append(", ").append(cube.getMeasure().getQuotedColumnName());
+        queryBuilder.append(" USING PARAMETERS rowcount=").append(cube.getRowCountThreshold());
+        queryBuilder.append(", sumnull=").append(cube.usesUDF());
+        if (cube.isCanonical()) {
+            queryBuilder.append(", canonical=true");
+        }
+        queryBuilder.append(") OVER (PARTITION BEST)\n");
+        queryBuilder.append(QuerySet.getIndentationString(1));
+        queryBuilder.append("FROM ").append(cube.getFactTable().getTableName()).append(";");
         cube.addQuery(queryBuilder.toString());
     }
+
+    static final int DENOMINATOR_BATCH_SIZE = 100;
+    private static final String DENOMINATOR_NAME = "denominator";
+    private static final String RANK_COLUMN = PercentageCubeTopKFilter.RANK_COLUMN;
 }
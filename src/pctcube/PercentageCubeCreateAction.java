@@ -1,8 +1,15 @@
 package pctcube;
 
+import java.util.ArrayList;
+import java.util.List;
+
 import pctcube.PercentageCube.PercentageCubeVisitor;
+import pctcube.database.Column;
+import pctcube.database.DataType;
 import pctcube.database.Table;
 import pctcube.database.query.CreateTableQuerySet;
+import pctcube.database.query.QuerySet;
+import pctcube.utils.CombinationGenerator;
 
 public class PercentageCubeCreateAction implements PercentageCubeVisitor {
 
@@ -10,6 +17,10 @@ public class PercentageCubeCreateAction implements PercentageCubeVisitor {
     public void visit(PercentageCube cube) {
         // Create table, drop the old one if it exists.
         Table pctCubeTable = PercentageCubeTableFactory.getTable(cube);
+        if (cube.isTopKPushedDown()) {
+            // Only the top k rows are ever written.
+            pctCubeTable.setTableName(PercentageCubeTopKFilter.TOPK_TABLE_NAME);
+        }
         cube.getDatabase().addOrReplaceTable(pctCubeTable);
         CreateTableQuerySet ct = new CreateTableQuerySet();
         ct.setAddDropIfExists(true);
@@ -17,5 +28,134 @@ public class PercentageCubeCreateAction implements PercentageCubeVisitor {
 
         cube.addAllQueries(ct.getQueries());
         cube.m_pctCubeTable = pctCubeTable;
+
+        if (cube.isCanonical()) {
+            createLabelLookup(cube, pctCubeTable);
+        }
+        if (cube.isEncoded()) {
+            createDecodedView(cube, pctCubeTable);
+        }
+    }
+
+    // The encoded dimensions of the cube hold dictionary codes, the view joins the dictionaries
+    // (PercentageCubeEncodeAction) to present their values instead. A NULL code ("ALL") stays NULL.
+    private void createDecodedView(PercentageCube cube, Table pctCubeTable) {
+        List<String> viewColumns = new ArrayList<>();
+        List<String> joins = new ArrayList<>();
+        List<Column> cubeColumns = pctCubeTable.getColumns();
+        List<Column> dimensions = cube.getDimensions();
+        for (int i = 0; i < cubeColumns.size(); i++) {
+            String columnName = cubeColumns.get(i).getQuotedColumnName();
+            int dimensionIndex = i - 2;
+            if (dimensionIndex < 0 || dimensionIndex >= dimensions.size()) {
+                viewColumns.add("c." + columnName);
+                continue;
+            }
+            Column sourceDimension = cube.getSourceFactTable().getColumnByName(
+                    dimensions.get(dimensionIndex).getColumnName());
+            if (! PercentageCubeEncodeAction.isEncoded(sourceDimension)) {
+                viewColumns.add("c." + columnName);
+                continue;
+            }
+            String alias = "e" + dimensionIndex;
+            viewColumns.add(alias + ".value AS " + columnName);
+            joins.add(String.format("LEFT JOIN %s %s ON c.%s = %s.code",
+                    PercentageCubeEncodeAction.getDictionaryTable(sourceDimension).getTableName(),
+                    alias, columnName, alias));
+        }
+
+        // Decode the permuted labels of a canonical cube too.
+        String source = cube.isCanonical() ? VIEW_NAME : pctCubeTable.getTableName();
+        cube.addQuery(String.format("DROP VIEW IF EXISTS %s;", DECODED_VIEW_NAME));
+        StringBuilder queryBuilder = new StringBuilder("CREATE VIEW ");
+        queryBuilder.append(DECODED_VIEW_NAME).append(" AS\n").append(QuerySet.getIndentationString(1));
+        queryBuilder.append("SELECT ").append(String.join(", ", viewColumns)).append("\n");
+        queryBuilder.append(QuerySet.getIndentationString(1));
+        queryBuilder.append("FROM ").append(source).append(" c");
+        for (String join : joins) {
+            queryBuilder.append("\n").append(QuerySet.getIndentationString(2)).append(join);
+        }
+        queryBuilder.append(";");
+        cube.addQuery(queryBuilder.toString());
+    }
+
+    // A canonical percentage cube only stores one order of the total-by keys and the break-down-by keys.
+    // The label table maps every permuted ("total by", "break down by") label to its canonical label,
+    // and the view joins it back so the cube can be queried with any of the permuted labels.
+    private void createLabelLookup(PercentageCube cube, Table pctCubeTable) {
+        Table labelTable = new Table(LABEL_TABLE_NAME);
+        labelTable.addColumn(new Column("total by", DataType.VARCHAR).setNullable(false));
+        labelTable.addColumn(new Column("break down by", DataType.VARCHAR).setNullable(false));
+        labelTable.addColumn(new Column("canonical total by", DataType.VARCHAR).setNullable(false));
+        labelTable.addColumn(new Column("canonical break down by", DataType.VARCHAR).setNullable(false));
+        cube.getDatabase().addOrReplaceTable(labelTable);
+        CreateTableQuerySet ct = new CreateTableQuerySet();
+        ct.setAddDropIfExists(true);
+        labelTable.accept(ct);
+        cube.addAllQueries(ct.getQueries());
+
+        // Generate the permuted splits the same way the non-canonical cube does. There are d * d! of them for
+        // the full cuboid alone, so they are inserted LABEL_BATCH_SIZE rows at a time: no single statement
+        // grows with the dimension count, and a query sink gets the batches as they are generated.
+        List<Column> dimensions = cube.getDimensions();
+        List<String> labelRows = new ArrayList<>();
+        CombinationGenerator<Column> dimensionSelector = new CombinationGenerator<>(dimensions);
+        for (int numOfSelectedDimensions = dimensions.size();
+                numOfSelectedDimensions >= 1;
+                numOfSelectedDimensions--) {
+
+            dimensionSelector.setNumOfElementsToSelect(numOfSelectedDimensions);
+            for (List<Column> selection : dimensionSelector) {
+                for (PercentageCubeSplit split : PercentageCubeSplit.getSplits(selection, false)) {
+                    PercentageCubeSplit canonicalSplit = split.getCanonicalSplit(dimensions);
+                    labelRows.add(String.format("SELECT '%s', '%s', '%s', '%s'",
+                            split.getTotalByLabel(), split.getBreakdownByLabel(),
+                            canonicalSplit.getTotalByLabel(), canonicalSplit.getBreakdownByLabel()));
+                    if (labelRows.size() == LABEL_BATCH_SIZE) {
+                        addLabelInsert(cube, labelTable, labelRows);
+                    }
+                }
+            }
+        }
+        if (! labelRows.isEmpty()) {
+            addLabelInsert(cube, labelTable, labelRows);
+        }
+
+        List<Column> cubeColumns = pctCubeTable.getColumns();
+        String totalByColumnName = cubeColumns.get(0).getQuotedColumnName();
+        String breakdownByColumnName = cubeColumns.get(1).getQuotedColumnName();
+        List<String> viewColumns = new ArrayList<>();
+        viewColumns.add("l." + totalByColumnName);
+        viewColumns.add("l." + breakdownByColumnName);
+        for (int i = 2; i < cubeColumns.size(); i++) {
+            viewColumns.add("c." + cubeColumns.get(i).getQuotedColumnName());
+        }
+        cube.addQuery(String.format("DROP VIEW IF EXISTS %s;", VIEW_NAME));
+        StringBuilder queryBuilder = new StringBuilder("CREATE VIEW ");
+        queryBuilder.append(VIEW_NAME).append(" AS\n");
+        queryBuilder.append(QuerySet.getIndentationString(1));
+        queryBuilder.append("SELECT ").append(String.join(", ", viewColumns)).append("\n");
+        queryBuilder.append(QuerySet.getIndentationString(1));
+        queryBuilder.append("FROM ").append(pctCubeTable.getTableName()).append(" c JOIN ");
+        queryBuilder.append(labelTable.getTableName()).append(" l ON\n");
+        queryBuilder.append(QuerySet.getIndentationString(1));
+        queryBuilder.append("c.").append(totalByColumnName).append(" = l.\"canonical total by\" AND ");
+        queryBuilder.append("c.").append(breakdownByColumnName).append(" = l.\"canonical break down by\";");
+        cube.addQuery(queryBuilder.toString());
+    }
+
+    // Inserts one batch of label rows and empties the batch.
+    private void addLabelInsert(PercentageCube cube, Table labelTable, List<String> labelRows) {
+        StringBuilder queryBuilder = new StringBuilder("INSERT INTO ");
+        queryBuilder.append(labelTable.getTableName()).append("\n").append(QuerySet.getIndentationString(1));
+        queryBuilder.append(String.join(" UNION ALL\n" + QuerySet.getIndentationString(1), labelRows));
+        queryBuilder.append(";");
+        cube.addQuery(queryBuilder.toString());
+        labelRows.clear();
     }
+
+    static final int LABEL_BATCH_SIZE = 1000;
+    private static final String LABEL_TABLE_NAME = "pct_cube_labels";
+    private static final String VIEW_NAME = "pct_cube_ordered";
+    private static final String DECODED_VIEW_NAME = "pct_cube_decoded";
 }
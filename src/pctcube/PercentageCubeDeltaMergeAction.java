@@ -8,8 +8,26 @@ import pctcube.database.Column;
 import pctcube.database.Table;
 import pctcube.database.query.QuerySet;
 
+/**
+ * Merges the OLAP cube of a delta (olap_cube_delta, PercentageCubeAggregateAction) into the OLAP cube in place.
+ * A MERGE adds the counts and the sums of the delta to the groups it touches and inserts the groups it creates,
+ * so the cost follows the size of the delta instead of rewriting every group of the cube.
+ * The delta OLAP cube is a temp table, the assembler still reads the totals it touches before it is dropped.
+ * A signed delta (PercentageCubeAggregateAction) subtracts its retracted facts the same way, and the groups
+ * it empties are deleted from the OLAP cube.
+ */
 public class PercentageCubeDeltaMergeAction implements PercentageCubeVisitor {
 
+    private boolean m_signed = false;
+
+    public PercentageCubeDeltaMergeAction() {
+
+    }
+
+    public PercentageCubeDeltaMergeAction(boolean signed) {
+        m_signed = signed;
+    }
+
     @Override
     public void visit(PercentageCube cube) {
         Table deltaOLAPCubeTable = cube.getDatabase().getTableByName("olap_cube_delta");
@@ -17,49 +35,72 @@ public class PercentageCubeDeltaMergeAction implements PercentageCubeVisitor {
         if (deltaOLAPCubeTable == null) {
             return;
         }
-        cube.addQuery(String.format("DROP TABLE IF EXISTS %s;", INTERMEDIATE_TEMP));
-        StringBuilder queryBuilder = new StringBuilder("ALTER TABLE ");
-        queryBuilder.append(olapCubeTable.getTableName()).append(" RENAME TO ");
-        queryBuilder.append(INTERMEDIATE_TEMP).append(";");
-        cube.addQuery(queryBuilder.toString());
 
-        queryBuilder.setLength(0);
-
-        // Merge
-        // The table schema will be [group by columns], cnt, m
-        String measure = cube.getMeasure().getQuotedColumnName();
-        List<Column> columns = olapCubeTable.getColumns();
-        List<String> dimensionList = new ArrayList<>();
-        for (int i = 0; i < columns.size() - 2; i++) {
-            dimensionList.add(columns.get(i).getQuotedColumnName());
+        // The table schema will be [group by columns], cuboid_id, cnt, m1, m2, ...
+        // The groups are matched on their cuboid_id too, a NULL dimension value is not an "ALL".
+        List<String> matchPredicates = new ArrayList<>();
+        matchPredicates.add(String.format("o.%1$s = d.%1$s", OLAPCubeTableFactory.CUBOID_ID_COLUMN));
+        for (Column dimension : cube.getDimensions()) {
+            matchPredicates.add(String.format("o.%1$s <=> d.%1$s", dimension.getQuotedColumnName()));
+        }
+        List<String> updates = new ArrayList<>();
+        updates.add("cnt = o.cnt + d.cnt");
+        for (Column measure : cube.getMeasures()) {
+            String measureName = measure.getQuotedColumnName();
+            updates.add(measureName + " = " + getMergedSum(cube, "o." + measureName, "d." + measureName));
         }
-        queryBuilder.append("SELECT ");
-        queryBuilder.append(String.join(", ", dimensionList));
-        // CNT
-        queryBuilder.append(", SUM(cnt) AS cnt, ");
-        // SUM(m)
-        if (cube.usesUDF()) {
-            queryBuilder.append("SUMNULL(");
+        if (cube.isIncremental()) {
+            for (Column measure : cube.getMeasures()) {
+                String nullCountName = OLAPCubeTableFactory.getNullCountColumn(measure).getQuotedColumnName();
+                updates.add(String.format("%1$s = o.%1$s + d.%1$s", nullCountName));
+            }
         }
-        else {
-            queryBuilder.append("SUM(");
+        List<String> columnNames = new ArrayList<>();
+        List<String> insertValues = new ArrayList<>();
+        for (Column column : olapCubeTable.getColumns()) {
+            columnNames.add(column.getQuotedColumnName());
+            insertValues.add("d." + column.getQuotedColumnName());
         }
-        queryBuilder.append(measure);
-        queryBuilder.append(") AS ").append(measure).append("\nINTO ").append(olapCubeTable.getTableName());
-        queryBuilder.append(" FROM (\n");
+
+        StringBuilder queryBuilder = new StringBuilder("MERGE INTO ");
+        queryBuilder.append(olapCubeTable.getTableName()).append(" o USING ");
+        queryBuilder.append(deltaOLAPCubeTable.getTableName()).append(" d\n");
         queryBuilder.append(QuerySet.getIndentationString(1));
-        queryBuilder.append("SELECT * FROM ").append(deltaOLAPCubeTable.getTableName());
-        queryBuilder.append("\n").append(QuerySet.getIndentationString(1));
-        queryBuilder.append(" UNION ALL\n");
+        queryBuilder.append("ON ").append(String.join(" AND ", matchPredicates)).append("\n");
         queryBuilder.append(QuerySet.getIndentationString(1));
-        queryBuilder.append("SELECT * FROM ").append(INTERMEDIATE_TEMP).append(") a\n");
-
-        queryBuilder.append("GROUP BY ").append(String.join(", ", dimensionList));
-        queryBuilder.append(";");
+        queryBuilder.append("WHEN MATCHED THEN UPDATE SET ").append(String.join(", ", updates)).append("\n");
+        queryBuilder.append(QuerySet.getIndentationString(1));
+        queryBuilder.append("WHEN NOT MATCHED THEN INSERT (").append(String.join(", ", columnNames));
+        queryBuilder.append(") VALUES (").append(String.join(", ", insertValues)).append(");");
         cube.addQuery(queryBuilder.toString());
-//        cube.addQuery(String.format("DROP TABLE %s;", INTERMEDIATE_TEMP));
-    }
 
-    private static final String INTERMEDIATE_TEMP = "INTERMEDIATE_TEMP";
+        // Only the groups of the delta can reach zero, the others are left alone.
+        if (m_signed) {
+            String tableName = olapCubeTable.getTableName();
+            List<String> deltaPredicates = new ArrayList<>();
+            deltaPredicates.add(String.format("d.%1$s = %2$s.%1$s", OLAPCubeTableFactory.CUBOID_ID_COLUMN, tableName));
+            for (Column dimension : cube.getDimensions()) {
+                deltaPredicates.add(String.format("d.%1$s <=> %2$s.%1$s", dimension.getQuotedColumnName(), tableName));
+            }
+            StringBuilder deleteBuilder = new StringBuilder("DELETE FROM ");
+            deleteBuilder.append(tableName).append(" WHERE cnt = 0 AND\n").append(QuerySet.getIndentationString(1));
+            deleteBuilder.append("EXISTS (SELECT 1 FROM ").append(deltaOLAPCubeTable.getTableName());
+            deleteBuilder.append(" d WHERE ");
+            deleteBuilder.append(String.join(" AND ", deltaPredicates)).append(");");
+            cube.addQuery(deleteBuilder.toString());
+        }
+    }
 
+    // The sum of a group after the merge, from its sum in the cube and its sum in the delta.
+    // SUMNULL() is NULL as soon as one of the values is, so a NULL on either side poisons the merged sum,
+    // and that is what + does. SUM() ignores the NULLs, it is only NULL if both sides are.
+    // SUMNULL_EXACT() only stores its rounded sum, so the + rounds a second time and the merged sum can differ
+    // from the sum of a full rebuild in the last bits (udf=exact, PercentageCubeInitializer).
+    // The sums of an incremental cube skip the NULLs and are never NULL themselves.
+    private static String getMergedSum(PercentageCube cube, String cubeSum, String deltaSum) {
+        if (cube.usesUDF() || cube.isIncremental()) {
+            return String.format("%s + %s", cubeSum, deltaSum);
+        }
+        return String.format("COALESCE(%1$s + %2$s, %1$s, %2$s)", cubeSum, deltaSum);
+    }
 }
@@ -0,0 +1,159 @@
+package pctcube;
+
+import java.util.ArrayList;
+import java.util.List;
+
+import pctcube.PercentageCube.PercentageCubeVisitor;
+import pctcube.database.Column;
+import pctcube.database.DataType;
+import pctcube.database.Table;
+import pctcube.database.query.CreateTableQuerySet;
+import pctcube.database.query.QuerySet;
+
+/**
+ * Dictionary-encodes the VARCHAR dimensions of the fact table (encode=true), so that the aggregation,
+ * the delta merge and the assembly group and join on INTEGER codes instead of strings.
+ * Every encoded dimension has a persistent dictionary table (code, value), extended with DICT_ENCODE()
+ * before the fact table is encoded. The codes never change once handed out, so an OLAP cube built on
+ * an earlier encoding can still be merged with a delta encoded later.
+ * The encoded copy of the fact table has the same column names, with INTEGER codes in the encoded
+ * dimensions. The codes are decoded back by the pct_cube_decoded view (PercentageCubeCreateAction).
+ */
+public class PercentageCubeEncodeAction implements PercentageCubeVisitor {
+
+    private Table m_deltaFactTable = null;
+    private Column m_signColumn = null;
+    private Table m_encodedFactTable = null;
+
+    public PercentageCubeEncodeAction() {
+
+    }
+
+    public PercentageCubeEncodeAction(Table deltaFactTable) {
+        m_deltaFactTable = deltaFactTable;
+    }
+
+    // The sign column of the delta is copied along with the measures.
+    public PercentageCubeEncodeAction(Table deltaFactTable, Column signColumn) {
+        m_deltaFactTable = deltaFactTable;
+        m_signColumn = signColumn;
+    }
+
+    @Override
+    public void visit(PercentageCube cube) {
+        boolean delta = m_deltaFactTable != null;
+        Table sourceTable = delta ? m_deltaFactTable : cube.getSourceFactTable();
+        List<Column> sourceDimensions = new ArrayList<>();
+        for (Column dimension : cube.getDimensions()) {
+            sourceDimensions.add(sourceTable.getColumnByName(dimension.getColumnName()));
+        }
+
+        for (Column dimension : sourceDimensions) {
+            if (isEncoded(dimension)) {
+                addDictionaryQueries(cube, sourceTable, dimension);
+            }
+        }
+
+        List<Column> measures = new ArrayList<>(cube.getMeasures());
+        if (m_signColumn != null) {
+            measures.add(m_signColumn);
+        }
+        m_encodedFactTable = delta ? getEncodedTable(sourceTable, sourceDimensions, measures)
+                                   : cube.getFactTable();
+        cube.getDatabase().addOrReplaceTable(m_encodedFactTable);
+        CreateTableQuerySet ct = new CreateTableQuerySet();
+        ct.setAddDropIfExists(true);
+        m_encodedFactTable.accept(ct);
+        cube.addAllQueries(ct.getQueries());
+        cube.addQuery(getEncodingQuery(sourceTable, sourceDimensions, measures, m_encodedFactTable));
+    }
+
+    // The encoded copy of the fact table the action has filled.
+    public Table getEncodedFactTable() {
+        return m_encodedFactTable;
+    }
+
+    public static boolean isEncoded(Column dimension) {
+        return dimension.getDataType().isVariableLengthType();
+    }
+
+    public static Table getEncodedTable(Table factTable, List<Column> dimensions, List<Column> measures) {
+        Table retval = new Table(factTable.getTableName() + "_encoded");
+        for (Column dimension : dimensions) {
+            if (isEncoded(dimension)) {
+                retval.addColumn(new Column(dimension.getColumnName(), DataType.INTEGER));
+            }
+            else {
+                retval.addColumn(new Column(dimension));
+            }
+        }
+        for (Column measure : measures) {
+            retval.addColumn(new Column(measure));
+        }
+        return retval;
+    }
+
+    public static Table getDictionaryTable(Column dimension) {
+        Table retval = new Table("dict_" + dimension.getColumnName().replaceAll("[^a-zA-Z0-9_]", "_"));
+        retval.addColumn(new Column("code", DataType.INTEGER).setNullable(false));
+        Column value = new Column(dimension).setNullable(false);
+        value.setColumnName("value");
+        retval.addColumn(value);
+        return retval;
+    }
+
+    // Create the dictionary if it is not there yet, then add the values of the dimension it does not have.
+    private void addDictionaryQueries(PercentageCube cube, Table sourceTable, Column dimension) {
+        Table dictionaryTable = getDictionaryTable(dimension);
+        cube.getDatabase().addOrReplaceTable(dictionaryTable);
+        CreateTableQuerySet ct = new CreateTableQuerySet();
+        ct.setAddIfNotExists(true);
+        dictionaryTable.accept(ct);
+        cube.addAllQueries(ct.getQueries());
+
+        String dictionaryName = dictionaryTable.getTableName();
+        String columnName = dimension.getQuotedColumnName();
+        StringBuilder queryBuilder = new StringBuilder("INSERT INTO ");
+        queryBuilder.append(dictionaryName).append("\n").append(QuerySet.getIndentationString(1));
+        queryBuilder.append("SELECT DICT_ENCODE(code, value) OVER ()\n").append(QuerySet.getIndentationString(1));
+        queryBuilder.append("FROM (SELECT code, value FROM ").append(dictionaryName).append(" UNION ALL\n");
+        queryBuilder.append(QuerySet.getIndentationString(2));
+        queryBuilder.append("SELECT DISTINCT NULL, ").append(columnName);
+        queryBuilder.append(" FROM ").append(sourceTable.getTableName());
+        queryBuilder.append(" WHERE ").append(columnName).append(" IS NOT NULL) d;");
+        cube.addQuery(queryBuilder.toString());
+    }
+
+    // A NULL value never matches a dictionary entry, so it is encoded as a NULL code.
+    private String getEncodingQuery(Table sourceTable, List<Column> sourceDimensions,
+                                    List<Column> measures, Table encodedTable) {
+        List<String> values = new ArrayList<>();
+        List<String> joins = new ArrayList<>();
+        for (int i = 0; i < sourceDimensions.size(); i++) {
+            Column dimension = sourceDimensions.get(i);
+            String columnName = dimension.getQuotedColumnName();
+            if (! isEncoded(dimension)) {
+                values.add("f." + columnName);
+                continue;
+            }
+            String alias = "e" + i;
+            values.add(alias + ".code");
+            joins.add(String.format("LEFT JOIN %s %s ON f.%s = %s.value",
+                    getDictionaryTable(dimension).getTableName(), alias, columnName, alias));
+        }
+        for (Column measure : measures) {
+            values.add("f." + measure.getQuotedColumnName());
+        }
+
+        StringBuilder queryBuilder = new StringBuilder("INSERT INTO ");
+        queryBuilder.append(encodedTable.getTableName()).append("\n").append(QuerySet.getIndentationString(1));
+        queryBuilder.append("SELECT ").append(String.join(", ", values)).append("\n");
+        queryBuilder.append(QuerySet.getIndentationString(1));
+        queryBuilder.append("FROM ").append(sourceTable.getTableName()).append(" f");
+        for (String join : joins) {
+            queryBuilder.append("\n").append(QuerySet.getIndentationString(2)).append(join);
+        }
+        queryBuilder.append(";");
+        return queryBuilder.toString();
+    }
+}
@@ -1,10 +1,12 @@
 package pctcube;
 
+import java.util.ArrayList;
 import java.util.List;
 
 import pctcube.PercentageCube.PercentageCubeVisitor;
 import pctcube.database.Column;
 import pctcube.database.Database;
+import pctcube.database.Table;
 import pctcube.utils.ArgumentParser;
 
 public class PercentageCubeInitializer implements PercentageCubeVisitor {
@@ -42,9 +44,19 @@ public class PercentageCubeInitializer implements PercentageCubeVisitor {
             Errors.INVALID_PERCENTAGE_CUBE_ARGS.throwIt(PercentageCube.m_logger, "dimensions");
         }
 
-        // Measure column
-        cube.m_measure = cube.m_factTable.getColumnByName(parser.getArgumentValue("measure"));
-        if (cube.m_measure == null) {
+        // Measure list, all the measures are aggregated in the same pass over the fact table.
+        List<String> measureNames = parser.getArgumentValues("measure");
+        if (measureNames == null) {
+            Errors.INVALID_PERCENTAGE_CUBE_ARGS.throwIt(PercentageCube.m_logger, "measure");
+        }
+        for (String measureName : measureNames) {
+            Column measure = cube.m_factTable.getColumnByName(measureName);
+            if (measure == null || cube.m_measures.contains(measure)) {
+                Errors.INVALID_PERCENTAGE_CUBE_ARGS.throwIt(PercentageCube.m_logger, "measure");
+            }
+            cube.m_measures.add(measure);
+        }
+        if (cube.m_measures.size() == 0) {
             Errors.INVALID_PERCENTAGE_CUBE_ARGS.throwIt(PercentageCube.m_logger, "measure");
         }
 
@@ -57,12 +69,25 @@ public class PercentageCubeInitializer implements PercentageCubeVisitor {
             else if (method.equals("olap")) {
                 cube.m_evaluationMethod = EvaluationMethod.OLAP;
             }
+            else if (method.equals("udtf")) {
+                cube.m_evaluationMethod = EvaluationMethod.UDTF;
+            }
+            else if (method.equals("lattice")) {
+                cube.m_evaluationMethod = EvaluationMethod.LATTICE;
+            }
             else {
                 Errors.INVALID_PERCENTAGE_CUBE_ARGS.throwIt(PercentageCube.m_logger, "method");
             }
         }
+        // PCT_OF_TOTAL() and PERCENTAGE_CUBE() take a single measure.
+        if (cube.m_measures.size() > 1 && (cube.m_evaluationMethod == EvaluationMethod.OLAP ||
+                                           cube.m_evaluationMethod == EvaluationMethod.UDTF)) {
+            Errors.INVALID_PERCENTAGE_CUBE_ARGS.throwIt(PercentageCube.m_logger, "measure");
+        }
 
-        // pruning
+        // pruning, of the OLAP cube of a cube that is not incremental (PercentageCube.getPruningStrategy()).
+        // DIRECT and CASCADE keep the same groups, CASCADE trades the single CUBE() pass for a scan per cuboid
+        // (PercentageCubeAggregateAction).
         String pruning = parser.getArgumentValue("pruning");
         if (pruning != null) {
             if (pruning.equals("none")) {
@@ -79,7 +104,8 @@ public class PercentageCubeInitializer implements PercentageCubeVisitor {
             }
         }
 
-        // topk
+        // topk, keep the k rows with the largest percentage (of the first measure) of every total, that is every
+        // ("total by", "break down by", total-by key values). The same on every path (PercentageCubeTopKFilter).
         String topk = parser.getArgumentValue("topk");
         if (topk != null) {
             try {
@@ -90,6 +116,9 @@ public class PercentageCubeInitializer implements PercentageCubeVisitor {
             }
         }
 
+        // topk pushdown, the assembler ranks the rows of every total with ROW_NUMBER() and only writes the top k.
+        cube.m_topkPushdown = Boolean.valueOf(parser.getArgumentValue("topkpushdown"));
+
         // row count threshold
         String rowcount = parser.getArgumentValue("rowcount");
         if (rowcount != null) {
@@ -101,11 +130,68 @@ public class PercentageCubeInitializer implements PercentageCubeVisitor {
             }
         }
 
+        // estimated dimension cardinalities, used by the lattice planner to pick the smallest parents.
+        List<String> cardinalities = parser.getArgumentValues("cardinalities");
+        if (cardinalities != null) {
+            if (cardinalities.size() != cube.m_dimensions.size()) {
+                Errors.INVALID_PERCENTAGE_CUBE_ARGS.throwIt(PercentageCube.m_logger, "cardinalities");
+            }
+            try {
+                for (String cardinality : cardinalities) {
+                    long value = Long.valueOf(cardinality);
+                    if (value <= 0) {
+                        Errors.INVALID_PERCENTAGE_CUBE_ARGS.throwIt(PercentageCube.m_logger, "cardinalities");
+                    }
+                    cube.m_dimensionCardinalities.add(value);
+                }
+            }
+            catch (NumberFormatException e) {
+                Errors.INVALID_PERCENTAGE_CUBE_ARGS.throwIt(PercentageCube.m_logger, "cardinalities");
+            }
+        }
+
         // incremental
         cube.m_incremental = Boolean.valueOf(parser.getArgumentValue("incremental"));
 
-        // uses UDF
-        cube.m_useUDF = Boolean.valueOf(parser.getArgumentValue("udf"));
+        // canonical, only one order of the total-by keys and the break-down-by keys is computed.
+        cube.m_canonical = Boolean.valueOf(parser.getArgumentValue("canonical"));
+
+        // uses UDF, "fused" replaces COUNT(*) and sumnull() with a single cube_measure() call,
+        // "exact" replaces sumnull() with sumnull_exact(). Only a cube built in one evaluate() is exact: olap_cube
+        // keeps the rounded sums, and each delta merge (evaluateIncrementallyOn()) adds them with a FLOAT +,
+        // which rounds again, so the sums are no longer guaranteed to match the bits of a full rebuild.
+        String udf = parser.getArgumentValue("udf");
+        if (udf != null && udf.equals("fused")) {
+            cube.m_useUDF = true;
+            cube.m_useFusedUDF = true;
+        }
+        else if (udf != null && udf.equals("exact")) {
+            cube.m_useUDF = true;
+            cube.m_useExactUDF = true;
+        }
+        else {
+            cube.m_useUDF = Boolean.valueOf(udf);
+        }
+
+        // encode, the VARCHAR dimensions are replaced by INTEGER dictionary codes, and the cube is evaluated
+        // on the encoded copy of the fact table (see PercentageCubeEncodeAction).
+        cube.m_sourceFactTable = cube.m_factTable;
+        cube.m_encode = Boolean.valueOf(parser.getArgumentValue("encode"));
+        if (cube.m_encode) {
+            Table encodedFactTable = PercentageCubeEncodeAction.getEncodedTable(
+                    cube.m_factTable, cube.m_dimensions, cube.m_measures);
+            List<Column> encodedDimensions = new ArrayList<>();
+            for (Column dimension : cube.m_dimensions) {
+                encodedDimensions.add(encodedFactTable.getColumnByName(dimension.getColumnName()));
+            }
+            List<Column> encodedMeasures = new ArrayList<>();
+            for (Column measure : cube.m_measures) {
+                encodedMeasures.add(encodedFactTable.getColumnByName(measure.getColumnName()));
+            }
+            cube.m_factTable = encodedFactTable;
+            cube.m_dimensions = encodedDimensions;
+            cube.m_measures = encodedMeasures;
+        }
     }
 
     private final Database m_database;
@@ -0,0 +1,122 @@
+package pctcube;
+
+import java.util.ArrayList;
+import java.util.List;
+
+import pctcube.PercentageCube.PercentageCubeVisitor;
+import pctcube.database.Column;
+import pctcube.database.DataType;
+import pctcube.database.query.CreateTableQuerySet;
+import pctcube.database.query.QuerySet;
+import pctcube.utils.CombinationGenerator;
+
+/**
+ * Materialize every cuboid of the cube lattice into its own AggregationTempTable.
+ * The base cuboid (all the dimensions selected) is aggregated from the fact table, every other cuboid
+ * is rolled up from the already materialized parent with the smallest estimated row count (the smallest-parent
+ * heuristic of PipeHash). The assembler then joins these small tables instead of filtering the OLAP cube.
+ */
+public class PercentageCubeLatticeAction implements PercentageCubeVisitor {
+
+    @Override
+    public void visit(PercentageCube cube) {
+        List<Column> dimensions = cube.getDimensions();
+        CombinationGenerator<Column> dimensionSelector = new CombinationGenerator<>(dimensions);
+        List<AggregationTempTable> materializedTables = new ArrayList<>();
+
+        // Go down the lattice level by level, so all the parents of a cuboid are materialized before it.
+        for (int numOfSelectedDimensions = dimensions.size();
+                numOfSelectedDimensions >= 0;
+                numOfSelectedDimensions--) {
+
+            dimensionSelector.setNumOfElementsToSelect(numOfSelectedDimensions);
+            for (List<Column> selection : dimensionSelector) {
+                AggregationTempTable cuboidTable = getCuboidTable(cube, dimensionSelector.getCurrentSelectionFlags());
+                AggregationTempTable parentTable = getSmallestParent(cuboidTable, materializedTables);
+
+                CreateTableQuerySet createTableQuerySet = new CreateTableQuerySet().setAddDropIfExists(true);
+                cuboidTable.accept(createTableQuerySet);
+                cube.addAllQueries(createTableQuerySet.getQueries());
+                cube.addQuery(getAggregationQuery(cube, cuboidTable, parentTable, selection));
+
+                cube.getDatabase().addOrReplaceTable(cuboidTable);
+                materializedTables.add(cuboidTable);
+            }
+        }
+    }
+
+    private AggregationTempTable getCuboidTable(PercentageCube cube, List<Integer> selectionFlags) {
+        AggregationTempTable retval = new AggregationTempTable(selectionFlags);
+        List<Column> dimensions = cube.getDimensions();
+        long estimatedRowCount = 1;
+        for (int i = 0; i < selectionFlags.size(); i++) {
+            if (selectionFlags.get(i) > 0) {
+                retval.addColumn(new Column(dimensions.get(i)));
+                long cardinality = cube.getEstimatedCardinality(i);
+                estimatedRowCount = estimatedRowCount > Long.MAX_VALUE / cardinality ?
+                        Long.MAX_VALUE : estimatedRowCount * cardinality;
+            }
+        }
+        retval.addColumn(new Column("cnt", DataType.INTEGER).setNullable(false));
+        for (Column measure : cube.getMeasures()) {
+            retval.addColumn(OLAPCubeTableFactory.getSumColumn(measure));
+        }
+        retval.setEstimatedRowCount(estimatedRowCount);
+        return retval;
+    }
+
+    // Returns null if the table can only be computed from the fact table.
+    private AggregationTempTable getSmallestParent(AggregationTempTable table,
+                                                   List<AggregationTempTable> materializedTables) {
+        AggregationTempTable retval = null;
+        for (AggregationTempTable candidate : materializedTables) {
+            if (! table.canDeriveFrom(candidate)) {
+                continue;
+            }
+            if (retval == null || candidate.getEstimatedRowCount() < retval.getEstimatedRowCount()) {
+                retval = candidate;
+            }
+        }
+        return retval;
+    }
+
+    private String getAggregationQuery(PercentageCube cube, AggregationTempTable table,
+                                       AggregationTempTable parentTable, List<Column> selection) {
+        List<String> dimensionNames = new ArrayList<>();
+        for (Column dimension : selection) {
+            dimensionNames.add(dimension.getQuotedColumnName());
+        }
+        List<String> sums = new ArrayList<>();
+        for (Column measure : cube.getMeasures()) {
+            sums.add(cube.getSumFunctionName() + "(" + measure.getQuotedColumnName() + ")");
+        }
+
+        StringBuilder queryBuilder = new StringBuilder();
+        queryBuilder.append("INSERT INTO ").append(table.getTableName()).append("\n");
+        queryBuilder.append(QuerySet.getIndentationString(1)).append("SELECT ");
+        for (String dimensionName : dimensionNames) {
+            queryBuilder.append(dimensionName).append(", ");
+        }
+        if (parentTable == null) {
+            queryBuilder.append("COUNT(*), ");
+        }
+        else {
+            // Roll up the counts and the sums of the parent.
+            queryBuilder.append("SUM(cnt), ");
+        }
+        queryBuilder.append(String.join(", ", sums)).append("\n");
+        queryBuilder.append(QuerySet.getIndentationString(1)).append("FROM ");
+        if (parentTable == null) {
+            queryBuilder.append(cube.getFactTable().getTableName());
+        }
+        else {
+            queryBuilder.append(parentTable.getTableName());
+        }
+        if (dimensionNames.size() > 0) {
+            queryBuilder.append("\n").append(QuerySet.getIndentationString(1));
+            queryBuilder.append("GROUP BY ").append(String.join(", ", dimensionNames));
+        }
+        queryBuilder.append(";");
+        return queryBuilder.toString();
+    }
+}
@@ -0,0 +1,136 @@
+package pctcube;
+
+import java.util.ArrayList;
+import java.util.Collections;
+import java.util.List;
+
+import pctcube.database.Column;
+import pctcube.utils.CombinationGenerator;
+import pctcube.utils.PermutationGenerator;
+
+/**
+ * A split of the selected (not "ALL") dimensions of a cuboid into the total-by keys and the break-down-by keys.
+ * Every split is one set of rows in the percentage cube, labeled with the two key lists.
+ */
+public class PercentageCubeSplit {
+
+    public PercentageCubeSplit(List<Column> totalByColumns, List<Column> breakdownByColumns) {
+        m_totalByColumns = new ArrayList<>(totalByColumns);
+        m_breakdownByColumns = new ArrayList<>(breakdownByColumns);
+    }
+
+    /**
+     * Get all the splits of the selected dimensions.
+     * By default, every order of the selected dimensions is split at every position. The total-by key count
+     * varies from 0 (global aggregation) to the selection size minus one, because at least one dimension needs
+     * to be selected as the break-down-by key.
+     * In canonical mode, the orders that only differ within the total-by keys or within the break-down-by keys
+     * give the same percentages, so every (total-by set, break-down-by set) pair is split only once, with both
+     * key lists in the dimension order.
+     */
+    public static List<PercentageCubeSplit> getSplits(PercentageCube cube, List<Column> selection) {
+        return getSplits(selection, cube.isCanonical());
+    }
+
+    public static List<PercentageCubeSplit> getSplits(List<Column> selection, boolean canonical) {
+        List<PercentageCubeSplit> retval = new ArrayList<>();
+        if (canonical) {
+            CombinationGenerator<Column> totalBySelector = new CombinationGenerator<>(selection);
+            for (int totalByKeyCount = 0; totalByKeyCount < selection.size(); totalByKeyCount++) {
+                totalBySelector.setNumOfElementsToSelect(totalByKeyCount);
+                for (List<Column> totalByColumns : totalBySelector) {
+                    List<Column> breakdownByColumns = new ArrayList<>(selection);
+                    breakdownByColumns.removeAll(totalByColumns);
+                    retval.add(new PercentageCubeSplit(totalByColumns, breakdownByColumns));
+                }
+            }
+            return retval;
+        }
+
+        // Exhaust all the possible orders of the selected dimensions.
+        PermutationGenerator<Column> pgen = new PermutationGenerator<>(selection);
+        for (List<Column> permutation : pgen) {
+            for (int totalByKeyCount = 0; totalByKeyCount < selection.size(); totalByKeyCount++) {
+                retval.add(new PercentageCubeSplit(permutation.subList(0, totalByKeyCount),
+                                                   permutation.subList(totalByKeyCount, permutation.size())));
+            }
+        }
+        return retval;
+    }
+
+    /**
+     * Get the splits of the selected dimensions whose total-by keys are the given dimensions, the subset of
+     * getSplits(cube, selection) one total-by cuboid is the denominator of: every order of the total-by keys
+     * with every order of the other selected dimensions, or only the dimension order in canonical mode.
+     */
+    public static List<PercentageCubeSplit> getSplits(PercentageCube cube, List<Column> selection,
+                                                      List<Column> totalByColumns) {
+        List<Column> breakdownByColumns = new ArrayList<>(selection);
+        breakdownByColumns.removeAll(totalByColumns);
+        List<PercentageCubeSplit> retval = new ArrayList<>();
+        if (cube.isCanonical()) {
+            retval.add(new PercentageCubeSplit(totalByColumns, breakdownByColumns));
+            return retval;
+        }
+
+        PermutationGenerator<Column> breakdownByGenerator = new PermutationGenerator<>(breakdownByColumns);
+        for (List<Column> totalByPermutation : new PermutationGenerator<>(totalByColumns)) {
+            for (List<Column> breakdownByPermutation : breakdownByGenerator) {
+                retval.add(new PercentageCubeSplit(totalByPermutation, breakdownByPermutation));
+            }
+        }
+        return retval;
+    }
+
+    // The same split with both key lists in the order of the cube dimensions.
+    public PercentageCubeSplit getCanonicalSplit(List<Column> dimensions) {
+        List<Column> totalByColumns = new ArrayList<>();
+        List<Column> breakdownByColumns = new ArrayList<>();
+        for (Column dimension : dimensions) {
+            if (m_totalByColumns.contains(dimension)) {
+                totalByColumns.add(dimension);
+            }
+            else if (m_breakdownByColumns.contains(dimension)) {
+                breakdownByColumns.add(dimension);
+            }
+        }
+        return new PercentageCubeSplit(totalByColumns, breakdownByColumns);
+    }
+
+    public List<Column> getTotalByColumns() {
+        return Collections.unmodifiableList(m_totalByColumns);
+    }
+
+    public List<Column> getBreakdownByColumns() {
+        return Collections.unmodifiableList(m_breakdownByColumns);
+    }
+
+    public List<String> getTotalByColumnNames() {
+        return getQuotedColumnNames(m_totalByColumns);
+    }
+
+    public List<String> getBreakdownByColumnNames() {
+        return getQuotedColumnNames(m_breakdownByColumns);
+    }
+
+    // The string in the "total by" column.
+    public String getTotalByLabel() {
+        return String.join(",", getTotalByColumnNames());
+    }
+
+    // The string in the "break down by" column.
+    public String getBreakdownByLabel() {
+        return String.join(",", getBreakdownByColumnNames());
+    }
+
+    public static List<String> getQuotedColumnNames(List<Column> columns) {
+        List<String> retval = new ArrayList<>();
+        for (Column column : columns) {
+            retval.add(column.getQuotedColumnName());
+        }
+        return retval;
+    }
+
+    private final List<Column> m_totalByColumns;
+    private final List<Column> m_breakdownByColumns;
+}
@@ -13,10 +13,11 @@ public class PercentageCubeTableFactory {
         for (Column dimension : cube.getDimensions()) {
             retval.addColumn(new Column(dimension));
         }
-        Column measure = cube.getMeasure();
-        Column percentageMeasure = new Column(measure.getColumnName() + "%", DataType.FLOAT);
-        percentageMeasure.setNullable(false);
-        retval.addColumn(percentageMeasure);
+        // One percentage column per measure, in the order of the measure list. A percentage is NULL when
+        // its sum is NULL or its total is zero.
+        for (Column measure : cube.getMeasures()) {
+            retval.addColumn(new Column(measure.getColumnName() + "%", DataType.FLOAT));
+        }
         return retval;
     }
 
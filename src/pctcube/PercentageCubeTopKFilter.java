@@ -7,74 +7,105 @@ import pctcube.PercentageCube.PercentageCubeVisitor;
 import pctcube.database.Column;
 import pctcube.database.Table;
 import pctcube.database.query.CreateTableQuerySet;
-import pctcube.utils.CombinationGenerator;
-import pctcube.utils.PermutationGenerator;
 
 public class PercentageCubeTopKFilter implements PercentageCubeVisitor {
 
     @Override
     public void visit(PercentageCube cube) {
-        if (cube.getTopK() == 0) {
+        // The assembler has already kept the top k rows if it was pushed down.
+        if (cube.getTopK() == 0 || cube.isTopKPushedDown()) {
             return;
         }
 
         Table fullCubeTable = cube.getPercentageCubeTable();
-        List<Column> cubeColumns = fullCubeTable.getColumns();
-        String totalByColumnName = cubeColumns.get(0).getQuotedColumnName();
-        String breakdownByColumnName = cubeColumns.get(1).getQuotedColumnName();
-        String measureName = cubeColumns.get(cubeColumns.size() - 1).getQuotedColumnName();
-
         Table topKResult = PercentageCubeTableFactory.getTable(cube);
-        topKResult.setTableName("pct_cube_topk");
+        topKResult.setTableName(TOPK_TABLE_NAME);
         CreateTableQuerySet ct = new CreateTableQuerySet().setAddDropIfExists(true);
         topKResult.accept(ct);
         cube.addAllQueries(ct.getQueries());
 
-        // Select the dimensions that are not "ALL"s.
-        List<Column> dimensions = cube.getDimensions();
-        CombinationGenerator<Column> dimensionSelector = new CombinationGenerator<>(dimensions);
-        for (int numOfSelectedDimensions = cube.getDimensions().size();
-                numOfSelectedDimensions >= 1;
-                numOfSelectedDimensions--) {
-
-            dimensionSelector.setNumOfElementsToSelect(numOfSelectedDimensions);
-            for (List<Column> selection : dimensionSelector) {
-
-                // Exhaust all the possible orders of the selected dimensions.
-                PermutationGenerator<Column> pgen = new PermutationGenerator<>(selection);
-                for (List<Column> permutation : pgen) {
+        if (cube.usesUDF()) {
+            addTopKUDFQuery(cube, fullCubeTable, topKResult);
+        }
+        else {
+            addTopKQuery(cube, fullCubeTable, topKResult);
+        }
+    }
 
-                    // Total-by key count varies from 0 (global aggregation) to dimension size minus one.
-                    // This is because at least one dimension needs to be selected as the break-down-by key.
-                    for (int totalByKeyCount = 0; totalByKeyCount < selection.size(); totalByKeyCount++) {
+    /**
+     * topk=k keeps the k rows with the largest percentage of the first measure of every total, on every path:
+     * the rows are partitioned by ("total by", "break down by", total-by key values), like the denominators.
+     * The dimensions that are not total-by keys of a row are masked to NULL in the partition key.
+     * A NULL percentage ranks lowest, ties are broken arbitrarily.
+     * The pushed-down ranking (PercentageCubeAssembler, topkpushdown=true) partitions every split the same way.
+     */
+    private static List<String> getPartitionKeys(PercentageCube cube, Table fullCubeTable) {
+        List<Column> cubeColumns = fullCubeTable.getColumns();
+        String totalByColumnName = cubeColumns.get(0).getQuotedColumnName();
+        List<String> partitionKeys = new ArrayList<>();
+        partitionKeys.add(totalByColumnName);
+        partitionKeys.add(cubeColumns.get(1).getQuotedColumnName());
+        for (int i = 2; i < 2 + cube.getDimensions().size(); i++) {
+            String columnName = cubeColumns.get(i).getQuotedColumnName();
+            // The "total by" column is a comma-separated list of the quoted total-by column names.
+            String listEntry = ("," + columnName + ",").replace("'", "''");
+            partitionKeys.add("CASE WHEN POSITION('" + listEntry + "' IN ',' || "
+                    + totalByColumnName + " || ',') > 0 THEN " + columnName + " END");
+        }
+        return partitionKeys;
+    }
 
-                        List<String> totalByColumnNames = new ArrayList<>();
-                        List<String> breakdownByColumnNames = new ArrayList<>();
-                        for (int i = 0; i < totalByKeyCount; i++) {
-                            totalByColumnNames.add(permutation.get(i).getQuotedColumnName());
-                        }
-                        for (int i = totalByKeyCount; i < permutation.size(); i++) {
-                            breakdownByColumnNames.add(permutation.get(i).getQuotedColumnName());
-                        }
+    // Rank the rows of every total with ROW_NUMBER() in a single pass over the percentage cube.
+    private void addTopKQuery(PercentageCube cube, Table fullCubeTable, Table topKResult) {
+        List<Column> cubeColumns = fullCubeTable.getColumns();
+        List<String> columnNames = new ArrayList<>();
+        for (Column column : cubeColumns) {
+            columnNames.add(column.getQuotedColumnName());
+        }
+        String measureName = cubeColumns.get(2 + cube.getDimensions().size()).getQuotedColumnName();
 
-                        StringBuilder queryBuilder = new StringBuilder();
+        StringBuilder queryBuilder = new StringBuilder();
+        queryBuilder.append("INSERT INTO ").append(topKResult.getTableName());
+        queryBuilder.append("\n    SELECT ").append(String.join(", ", columnNames)).append(" FROM");
+        queryBuilder.append("\n        (SELECT ").append(String.join(", ", columnNames)).append(",");
+        queryBuilder.append("\n            ROW_NUMBER() OVER (PARTITION BY ");
+        queryBuilder.append(String.join(",\n                ", getPartitionKeys(cube, fullCubeTable)));
+        queryBuilder.append("\n                ORDER BY ").append(measureName).append(" DESC NULLS LAST) AS ");
+        queryBuilder.append(RANK_COLUMN);
+        queryBuilder.append("\n        FROM ").append(fullCubeTable.getTableName()).append(") ranked");
+        queryBuilder.append("\n    WHERE ").append(RANK_COLUMN).append(" <= ").append(cube.getTopK()).append(";");
+        cube.addQuery(queryBuilder.toString());
+    }
 
-                        queryBuilder.append("INSERT INTO ").append(topKResult.getTableName());
-                        queryBuilder.append("\nSELECT * FROM ").append(fullCubeTable.getTableName());
-                        queryBuilder.append("\nWHERE ").append(totalByColumnName).append(" = '");
-                        // Assemble the string in the "total by" column.
-                        queryBuilder.append(String.join(",", totalByColumnNames));
-                        queryBuilder.append("' AND ").append(breakdownByColumnName).append(" = '");
-                        // Assemble the string in the "break down by" column.
-                        queryBuilder.append(String.join(",", breakdownByColumnNames));
-                        queryBuilder.append("' ORDER BY ").append(measureName).append(" DESC LIMIT ");
-                        queryBuilder.append(cube.getTopK());
-                        queryBuilder.append(";");
-                        cube.addQuery(queryBuilder.toString());
-                    }
-                }
+    /**
+     * Use the TOP_K() transform UDx to rank every group in a single pass over the percentage cube.
+     * TOP_K() ranks by its last argument, so with several measures the first one is moved to the end,
+     * and the insert names the columns in that order.
+     */
+    private void addTopKUDFQuery(PercentageCube cube, Table fullCubeTable, Table topKResult) {
+        List<Column> cubeColumns = fullCubeTable.getColumns();
+        int dimensionCount = cube.getDimensions().size();
+        List<String> columnNames = new ArrayList<>();
+        for (int i = 0; i < cubeColumns.size(); i++) {
+            if (i != 2 + dimensionCount) {
+                columnNames.add(cubeColumns.get(i).getQuotedColumnName());
             }
         }
+        columnNames.add(cubeColumns.get(2 + dimensionCount).getQuotedColumnName());
 
+        StringBuilder queryBuilder = new StringBuilder();
+        queryBuilder.append("INSERT INTO ").append(topKResult.getTableName());
+        if (cube.getMeasures().size() > 1) {
+            queryBuilder.append(" (").append(String.join(", ", columnNames)).append(")");
+        }
+        queryBuilder.append("\n    SELECT TOP_K(").append(String.join(", ", columnNames));
+        queryBuilder.append(" USING PARAMETERS k=").append(cube.getTopK()).append(")");
+        queryBuilder.append("\n    OVER (PARTITION BY ");
+        queryBuilder.append(String.join(",\n        ", getPartitionKeys(cube, fullCubeTable))).append(")");
+        queryBuilder.append("\n    FROM ").append(fullCubeTable.getTableName()).append(";");
+        cube.addQuery(queryBuilder.toString());
     }
+
+    public static final String TOPK_TABLE_NAME = "pct_cube_topk";
+    public static final String RANK_COLUMN = "topk_rank";
 }
@@ -27,6 +27,8 @@ public class Config {
     private int m_dEnd = 5;
     private boolean m_datagen = true;
     private boolean m_offline = false;
+    private int m_parallelism = 1; // number of JDBC connections the query sets are executed over.
+    private boolean m_generateInDatabase = false; // generate the fact tables with the FactGenerator UDSource.
 
     public boolean needToGenerateData() {
         return m_datagen;
@@ -80,6 +82,14 @@ public class Config {
         return m_offline;
     }
 
+    public int getParallelism() {
+        return m_parallelism;
+    }
+
+    public boolean generatesDataInDatabase() {
+        return m_generateInDatabase;
+    }
+
     public static Config getConfigFromFile(String filePath) {
         File configFile = new File(filePath);
         Config config = null;
@@ -138,6 +148,17 @@ public class Config {
                             config.m_datagen = false;
                         }
                         break;
+                    case "generator":
+                        if (seg[1].trim().equals("copy")) {
+                            config.m_generateInDatabase = true;
+                        }
+                        else {
+                            config.m_generateInDatabase = false;
+                        }
+                        break;
+                    case "parallelism":
+                        config.m_parallelism = Math.max(1, Integer.parseInt(seg[1].trim()));
+                        break;
                     case "offline":
                         if (seg[1].trim().equals("true")) {
                             config.m_offline = true;
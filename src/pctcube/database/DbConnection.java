@@ -5,6 +5,8 @@ import java.sql.Connection;
 import java.sql.DriverManager;
 import java.sql.SQLException;
 import java.sql.Statement;
+import java.util.ArrayList;
+import java.util.List;
 
 import pctcube.database.query.QuerySet;
 
@@ -13,6 +15,9 @@ public class DbConnection {
     private final Connection m_connection;
     private Statement m_stmt = null;
     private PrintStream m_sqlStream;
+    // Extra connections and the executor used to run query sets over all the connections, if parallelism > 1.
+    private final List<Connection> m_extraConnections = new ArrayList<>();
+    private ParallelQuerySetExecutor m_executor = null;
 
     public DbConnection() throws ClassNotFoundException, SQLException {
         this(new Config());
@@ -23,6 +28,17 @@ public class DbConnection {
             Class.forName(Config.m_jdbcClassName);
             m_connection = DriverManager.getConnection(config.getDatabaseURL(), config.getUserName(), config.getPassword());
             m_stmt = m_connection.createStatement();
+            if (config.getParallelism() > 1) {
+                List<Connection> connections = new ArrayList<>();
+                connections.add(m_connection);
+                for (int i = 1; i < config.getParallelism(); i++) {
+                    Connection connection = DriverManager.getConnection(config.getDatabaseURL(),
+                            config.getUserName(), config.getPassword());
+                    m_extraConnections.add(connection);
+                    connections.add(connection);
+                }
+                m_executor = new ParallelQuerySetExecutor(connections, config.getSQLStream());
+            }
         }
         else {
             m_connection = null;
@@ -38,9 +54,16 @@ public class DbConnection {
         if (m_connection != null) {
             m_connection.close();
         }
+        for (Connection connection : m_extraConnections) {
+            connection.close();
+        }
     }
 
     public void executeQuerySet(QuerySet querySet) throws SQLException {
+        if (m_executor != null) {
+            m_executor.execute(querySet);
+            return;
+        }
         for (String query : querySet.getQueries()) {
             if (m_sqlStream != null) {
                 m_sqlStream.println(query);
@@ -52,6 +75,33 @@ public class DbConnection {
         }
     }
 
+    // Generate a query set (e.g. cube::evaluate) and execute every query as soon as it is generated.
+    // The queries are not kept, so the memory does not grow with the query set, and the first query runs
+    // before the last one is generated. The parallel executor schedules the queries as they are generated too.
+    public void executeQuerySet(QuerySet querySet, Runnable generator) throws SQLException {
+        if (m_executor != null) {
+            m_executor.execute(querySet, generator);
+            return;
+        }
+        querySet.setQuerySink(query -> {
+            try {
+                execute(query);
+            }
+            catch (SQLException e) {
+                throw new StreamedQueryException(e);
+            }
+        });
+        try {
+            generator.run();
+        }
+        catch (StreamedQueryException e) {
+            throw (SQLException) e.getCause();
+        }
+        finally {
+            querySet.setQuerySink(null);
+        }
+    }
+
     public void execute(String query) throws SQLException {
         if (m_sqlStream != null) {
             m_sqlStream.println(query);
@@ -61,4 +111,14 @@ public class DbConnection {
             m_stmt.execute(query);
         }
     }
+
+    // Carries the failure of a streamed query out of the generator, which cannot throw an SQLException.
+    private static final class StreamedQueryException extends RuntimeException {
+
+        StreamedQueryException(SQLException cause) {
+            super(cause);
+        }
+
+        private static final long serialVersionUID = 1L;
+    }
 }
@@ -0,0 +1,318 @@
+package pctcube.database;
+
+import java.io.PrintStream;
+import java.sql.Connection;
+import java.sql.SQLException;
+import java.sql.Statement;
+import java.util.ArrayList;
+import java.util.BitSet;
+import java.util.Collections;
+import java.util.HashMap;
+import java.util.List;
+import java.util.Map;
+import java.util.PriorityQueue;
+import java.util.Queue;
+import java.util.concurrent.ArrayBlockingQueue;
+import java.util.concurrent.BlockingQueue;
+import java.util.concurrent.CompletionService;
+import java.util.concurrent.ConcurrentHashMap;
+import java.util.concurrent.ExecutionException;
+import java.util.concurrent.ExecutorCompletionService;
+import java.util.concurrent.ExecutorService;
+import java.util.concurrent.Executors;
+import java.util.concurrent.Future;
+import java.util.logging.Level;
+import java.util.logging.Logger;
+
+import pctcube.database.query.QueryDependencyGraph;
+import pctcube.database.query.QuerySet;
+
+/**
+ * Execute the statements of a query set over a pool of JDBC connections.
+ * The order is given by the QueryDependencyGraph: a statement starts once all the statements it depends on
+ * have finished, so the DDL runs first, then the OLAP cube population, then the assembler inserts (all at once),
+ * then the top-k filter. Among the statements that are ready, the earlier ones are started first.
+ * The statements can be executed as the query set is generated, with execute(querySet, generator).
+ * If a statement fails, no new statement is started, the running ones are cancelled and the first error is thrown.
+ */
+public class ParallelQuerySetExecutor {
+
+    public static final class StatementTiming {
+
+        StatementTiming(int index, String query, long elapsedNanos) {
+            m_index = index;
+            m_query = query;
+            m_elapsedNanos = elapsedNanos;
+        }
+
+        public int getIndex() {
+            return m_index;
+        }
+
+        public String getQuery() {
+            return m_query;
+        }
+
+        public double getElapsedMillis() {
+            return m_elapsedNanos / 1e6;
+        }
+
+        private final int m_index;
+        private final String m_query;
+        private final long m_elapsedNanos;
+    }
+
+    public ParallelQuerySetExecutor(List<Connection> connections, PrintStream sqlStream) {
+        if (connections == null || connections.isEmpty()) {
+            throw new IllegalArgumentException("At least one connection is needed.");
+        }
+        m_connections = new ArrayList<>(connections);
+        m_sqlStream = sqlStream;
+    }
+
+    public void execute(QuerySet querySet) throws SQLException {
+        execute(querySet, null);
+    }
+
+    // Generate a query set (e.g. cube::evaluate) and execute its statements as they are generated
+    // (DbConnection.executeQuerySet()). A statement only depends on the statements before it, so it can be
+    // scheduled as soon as it is added. The generator is held back while more than MAX_QUEUED_PER_CONNECTION
+    // statements per connection wait to start, so the memory does not grow with the query set.
+    // If a statement fails, the generation is stopped too.
+    public void execute(QuerySet querySet, Runnable generator) throws SQLException {
+        m_timings.clear();
+        m_cancelled = false;
+        Execution execution = new Execution();
+        try {
+            if (generator == null) {
+                for (String query : querySet.getQueries()) {
+                    execution.addQuery(query);
+                }
+            }
+            else {
+                querySet.setQuerySink(execution::addQuery);
+                try {
+                    generator.run();
+                }
+                finally {
+                    querySet.setQuerySink(null);
+                }
+            }
+        }
+        catch (GenerationStoppedException e) {
+            // The failure is thrown below, once the running statements are done.
+        }
+        finally {
+            execution.finish();
+        }
+        execution.throwFailure();
+    }
+
+    // The scheduling state of one execute() call, only used by the calling thread.
+    // The statements are known by their index in the query set, a query is only kept until it is started.
+    private final class Execution {
+
+        Execution() {
+            m_idleConnections = new ArrayBlockingQueue<>(m_connections.size(), false, m_connections);
+            m_pool = Executors.newFixedThreadPool(m_connections.size());
+            m_completionService = new ExecutorCompletionService<>(m_pool);
+        }
+
+        void addQuery(String query) {
+            if (m_failure != null) {
+                throw new GenerationStoppedException();
+            }
+            int index = m_graph.addQuery(query);
+            int pendingDependencyCount = 0;
+            for (int dependency : m_graph.getDependencies(index)) {
+                if (! m_finished.get(dependency)) {
+                    pendingDependencyCount++;
+                    m_dependents.computeIfAbsent(dependency, k -> new ArrayList<>()).add(index);
+                }
+            }
+            m_queuedQueries.put(index, query);
+            if (pendingDependencyCount == 0) {
+                m_ready.add(index);
+            }
+            else {
+                m_pendingDependencyCounts.put(index, pendingDependencyCount);
+            }
+
+            try {
+                startReadyStatements();
+                Future<Integer> finished;
+                while ((finished = m_completionService.poll()) != null) {
+                    complete(finished);
+                    startReadyStatements();
+                }
+                // Every queued statement only waits for running or queued statements before it,
+                // so while one is queued, one is running.
+                while (m_failure == null && m_runningCount > 0 &&
+                        m_queuedQueries.size() > MAX_QUEUED_PER_CONNECTION * m_connections.size()) {
+                    complete(m_completionService.take());
+                    startReadyStatements();
+                }
+            }
+            catch (InterruptedException e) {
+                interrupted(e);
+            }
+            if (m_failure != null) {
+                throw new GenerationStoppedException();
+            }
+        }
+
+        // Run everything left, or wait for the cancelled statements after a failure.
+        void finish() {
+            try {
+                while (true) {
+                    startReadyStatements();
+                    if (m_runningCount == 0) {
+                        break;
+                    }
+                    complete(m_completionService.take());
+                }
+            }
+            catch (InterruptedException e) {
+                interrupted(e);
+            }
+            finally {
+                m_pool.shutdownNow();
+            }
+        }
+
+        void throwFailure() throws SQLException {
+            if (m_failure instanceof SQLException) {
+                throw (SQLException) m_failure;
+            }
+            if (m_failure != null) {
+                throw new SQLException(m_failure);
+            }
+        }
+
+        private void startReadyStatements() {
+            while (m_failure == null && ! m_ready.isEmpty() && m_runningCount < m_connections.size()) {
+                int index = m_ready.poll();
+                String query = m_queuedQueries.remove(index);
+                if (m_sqlStream != null) {
+                    m_sqlStream.println(query);
+                    m_sqlStream.println();
+                }
+                m_completionService.submit(() -> runStatement(index, query, m_idleConnections, m_runningStatements));
+                m_runningCount++;
+            }
+        }
+
+        private void complete(Future<Integer> finished) throws InterruptedException {
+            m_runningCount--;
+            try {
+                int index = finished.get();
+                m_finished.set(index);
+                List<Integer> dependents = m_dependents.remove(index);
+                if (dependents == null) {
+                    return;
+                }
+                for (int dependent : dependents) {
+                    int pendingDependencyCount = m_pendingDependencyCounts.get(dependent) - 1;
+                    if (pendingDependencyCount == 0) {
+                        m_pendingDependencyCounts.remove(dependent);
+                        m_ready.add(dependent);
+                    }
+                    else {
+                        m_pendingDependencyCounts.put(dependent, pendingDependencyCount);
+                    }
+                }
+            }
+            catch (ExecutionException e) {
+                if (m_failure == null) {
+                    m_failure = e.getCause();
+                    m_cancelled = true;
+                    cancelAll(m_runningStatements);
+                }
+            }
+        }
+
+        private void interrupted(InterruptedException e) {
+            Thread.currentThread().interrupt();
+            m_cancelled = true;
+            cancelAll(m_runningStatements);
+            if (m_failure == null) {
+                m_failure = e;
+            }
+        }
+
+        private final QueryDependencyGraph m_graph = new QueryDependencyGraph();
+        private final BitSet m_finished = new BitSet();
+        private final Map<Integer, List<Integer>> m_dependents = new HashMap<>();
+        private final Map<Integer, Integer> m_pendingDependencyCounts = new HashMap<>();
+        private final Map<Integer, String> m_queuedQueries = new HashMap<>();
+        private final Queue<Integer> m_ready = new PriorityQueue<>();
+        private final BlockingQueue<Connection> m_idleConnections;
+        private final Map<Integer, Statement> m_runningStatements = new ConcurrentHashMap<>();
+        private final ExecutorService m_pool;
+        private final CompletionService<Integer> m_completionService;
+        private int m_runningCount = 0;
+        private Throwable m_failure = null;
+    }
+
+    // Stops the generator of a query set once a statement has failed, the sink cannot throw an SQLException.
+    private static final class GenerationStoppedException extends RuntimeException {
+
+        private static final long serialVersionUID = 1L;
+    }
+
+    // Timings of the statements finished by the last execute() call, in the order they finished.
+    public List<StatementTiming> getStatementTimings() {
+        return Collections.unmodifiableList(new ArrayList<>(m_timings));
+    }
+
+    private int runStatement(int index, String query,
+                             BlockingQueue<Connection> idleConnections,
+                             Map<Integer, Statement> runningStatements) throws SQLException, InterruptedException {
+        Connection connection = idleConnections.take();
+        if (m_cancelled) {
+            idleConnections.put(connection);
+            return index;
+        }
+        try (Statement stmt = connection.createStatement()) {
+            runningStatements.put(index, stmt);
+            long start = System.nanoTime();
+            try {
+                // Check again, the failure may have happened before the statement could be cancelled.
+                if (m_cancelled) {
+                    return index;
+                }
+                stmt.execute(query);
+            }
+            finally {
+                runningStatements.remove(index);
+            }
+            StatementTiming timing = new StatementTiming(index, query, System.nanoTime() - start);
+            m_timings.add(timing);
+            m_logger.log(Level.FINE, m_traceMessage, new Object[] {index, timing.getElapsedMillis()});
+            return index;
+        }
+        finally {
+            idleConnections.put(connection);
+        }
+    }
+
+    private void cancelAll(Map<Integer, Statement> runningStatements) {
+        for (Statement stmt : runningStatements.values()) {
+            try {
+                stmt.cancel();
+            }
+            catch (SQLException e) {
+                m_logger.warning(e.toString());
+            }
+        }
+    }
+
+    private final List<Connection> m_connections;
+    private final PrintStream m_sqlStream;
+    private volatile boolean m_cancelled = false;
+    private final List<StatementTiming> m_timings = Collections.synchronizedList(new ArrayList<>());
+
+    private static final int MAX_QUEUED_PER_CONNECTION = 4;
+    private static final String m_traceMessage = "Statement {0} finished in {1} ms.";
+    private static final Logger m_logger = Logger.getLogger(ParallelQuerySetExecutor.class.getName());
+}
@@ -26,6 +26,9 @@ public class Table {
         for (Column c : copyFrom.m_columns.values()) {
             addColumn(new Column(c));
         }
+        if (copyFrom.m_partitionColumn != null) {
+            m_partitionColumn = getColumnByName(copyFrom.m_partitionColumn.getColumnName());
+        }
     }
 
     public void accept(TableVisitor...visitors) {
@@ -70,6 +73,15 @@ public class Table {
         m_temporary = value;
     }
 
+    // null if the table is not partitioned.
+    public Column getPartitionColumn() {
+        return m_partitionColumn;
+    }
+
+    public void setPartitionColumn(Column column) {
+        m_partitionColumn = column;
+    }
+
     @Override
     public String toString() {
         CreateTableQuerySet visitor = new CreateTableQuerySet();
@@ -80,4 +92,5 @@ public class Table {
     private String m_name;
     private final Map<String, Column> m_columns = new LinkedHashMap<>();
     private boolean m_temporary = false;
+    private Column m_partitionColumn = null;
 }
@@ -41,6 +41,9 @@ public final class CreateTableQuerySet extends QuerySet implements TableVisitor,
             addAllQueries(dropStmt.getQueries());
         }
         StringBuilder builder = new StringBuilder("CREATE TABLE ");
+        if (m_ifNotExists) {
+            builder.append("IF NOT EXISTS ");
+        }
         builder.append(table.getTableName()).append(" (\n");
         List<Column> columns = table.getColumns();
         for (int i = 0; i < columns.size(); i++) {
@@ -52,7 +55,11 @@ public final class CreateTableQuerySet extends QuerySet implements TableVisitor,
             }
             builder.append("\n");
         }
-        builder.append(");");
+        builder.append(")");
+        if (table.getPartitionColumn() != null) {
+            builder.append(" PARTITION BY ").append(table.getPartitionColumn().getQuotedColumnName());
+        }
+        builder.append(";");
         addQuery(builder.toString());
     }
 
@@ -61,5 +68,12 @@ public final class CreateTableQuerySet extends QuerySet implements TableVisitor,
         return this;
     }
 
+    // For the tables that persist across evaluations, only create them if they are not there yet.
+    public CreateTableQuerySet setAddIfNotExists(boolean value) {
+        m_ifNotExists = value;
+        return this;
+    }
+
     private boolean m_dropIfExists = false;
+    private boolean m_ifNotExists = false;
 }
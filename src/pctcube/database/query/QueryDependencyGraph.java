@@ -0,0 +1,120 @@
+package pctcube.database.query;
+
+import java.util.ArrayList;
+import java.util.Collections;
+import java.util.HashSet;
+import java.util.List;
+import java.util.Set;
+import java.util.regex.Matcher;
+import java.util.regex.Pattern;
+
+/**
+ * Infer the dependencies between the statements of a query set from the tables they touch.
+ * A statement depends on an earlier statement if they conflict on a table:
+ * <ul>
+ * <li>either one changes the table definition or rewrites it (CREATE, DROP, ALTER, DELETE, MERGE...), or</li>
+ * <li>one appends to the table (INSERT, COPY) while the other reads from it.</li>
+ * </ul>
+ * Statements that only append to the same table, like the assembler's INSERT INTO pct_cube, do not depend on
+ * each other and can run at the same time. A statement whose tables cannot be recognized depends on all the
+ * statements before it, and all the statements after it depend on it.
+ */
+public final class QueryDependencyGraph {
+
+    public QueryDependencyGraph() { }
+
+    public QueryDependencyGraph(List<String> queries) {
+        for (String query : queries) {
+            addQuery(query);
+        }
+    }
+
+    // Add the next statement, it can only depend on the statements before it, so a graph can be built while
+    // the query set is generated. Only the tables it touches are kept, not the query. Returns its index.
+    public int addQuery(String query) {
+        TableAccess access = new TableAccess(query);
+        List<Integer> dependencies = new ArrayList<>();
+        for (int j = 0; j < m_accesses.size(); j++) {
+            if (access.conflictsWith(m_accesses.get(j))) {
+                dependencies.add(j);
+            }
+        }
+        m_accesses.add(access);
+        m_dependencies.add(dependencies);
+        return m_dependencies.size() - 1;
+    }
+
+    public int size() {
+        return m_dependencies.size();
+    }
+
+    // The indices of the earlier statements that the i-th statement depends on.
+    public List<Integer> getDependencies(int i) {
+        return Collections.unmodifiableList(m_dependencies.get(i));
+    }
+
+    private static final class TableAccess {
+
+        TableAccess(String query) {
+            String normalized = query.trim();
+            Matcher matcher = PAT_APPEND.matcher(normalized);
+            if (matcher.lookingAt()) {
+                m_appends.add(matcher.group(1).toLowerCase());
+            }
+            matcher = PAT_EXCLUSIVE.matcher(normalized);
+            if (matcher.lookingAt()) {
+                m_exclusives.add(matcher.group(1).toLowerCase());
+            }
+            matcher = PAT_RENAME.matcher(normalized);
+            while (matcher.find()) {
+                m_exclusives.add(matcher.group(1).toLowerCase());
+            }
+            matcher = PAT_READ.matcher(normalized);
+            while (matcher.find()) {
+                m_reads.add(matcher.group(1).toLowerCase());
+            }
+            m_barrier = m_appends.isEmpty() && m_exclusives.isEmpty() && ! PAT_SELECT.matcher(normalized).lookingAt();
+        }
+
+        boolean conflictsWith(TableAccess other) {
+            if (m_barrier || other.m_barrier) {
+                return true;
+            }
+            return intersects(m_exclusives, other.m_reads, other.m_appends, other.m_exclusives)
+                    || intersects(other.m_exclusives, m_reads, m_appends)
+                    || intersects(m_appends, other.m_reads)
+                    || intersects(m_reads, other.m_appends);
+        }
+
+        @SafeVarargs
+        private static boolean intersects(Set<String> tables, Set<String>... others) {
+            for (Set<String> other : others) {
+                for (String table : tables) {
+                    if (other.contains(table)) {
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
+
+        private final Set<String> m_reads = new HashSet<>();
+        private final Set<String> m_appends = new HashSet<>();
+        private final Set<String> m_exclusives = new HashSet<>();
+        private final boolean m_barrier;
+    }
+
+    private final List<TableAccess> m_accesses = new ArrayList<>();
+    private final List<List<Integer>> m_dependencies = new ArrayList<>();
+
+    private static final String TABLE_NAME = "([A-Za-z_][\\w.$]*)";
+    private static final Pattern PAT_APPEND = Pattern.compile(
+            "(?i)(?:INSERT\\s+INTO|COPY)\\s+" + TABLE_NAME);
+    private static final Pattern PAT_EXCLUSIVE = Pattern.compile(
+            "(?i)(?:(?:CREATE|DROP|ALTER|TRUNCATE)\\s+(?:TABLE|VIEW|PROJECTION)\\s+(?:IF\\s+(?:NOT\\s+)?EXISTS\\s+)?"
+            + "|DELETE\\s+FROM\\s+|UPDATE\\s+|MERGE\\s+INTO\\s+)" + TABLE_NAME);
+    private static final Pattern PAT_RENAME = Pattern.compile("(?i)\\bRENAME\\s+TO\\s+" + TABLE_NAME);
+    private static final Pattern PAT_READ = Pattern.compile(
+            "(?i)\\b(?:FROM|JOIN|USING)\\s+(?!PARAMETERS\\b)" + TABLE_NAME);
+    private static final Pattern PAT_SELECT = Pattern.compile("(?i)SELECT\\b");
+}
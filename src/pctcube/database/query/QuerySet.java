@@ -3,12 +3,14 @@ package pctcube.database.query;
 import java.util.ArrayList;
 import java.util.Collections;
 import java.util.List;
+import java.util.function.Consumer;
 
 public abstract class QuerySet {
 
     private static final int INDENTATION_SIZE = 4;
 
     private List<String> m_queries = new ArrayList<>();
+    private Consumer<String> m_querySink = null;
 
     public static String getIndentationString(int level) {
         return String.join("", Collections.nCopies(level * INDENTATION_SIZE, " "));
@@ -22,12 +24,28 @@ public abstract class QuerySet {
         m_queries.clear();
     }
 
+    // Hand the queries to the sink as they are added instead of keeping them (DbConnection.executeQuerySet()),
+    // so that a large query set is never held all at once. Setting it back to null keeps the queries again.
+    public void setQuerySink(Consumer<String> querySink) {
+        m_querySink = querySink;
+    }
+
     public void addQuery(String query) {
+        if (m_querySink != null) {
+            m_querySink.accept(query);
+            return;
+        }
         m_queries.add(query);
     }
 
     public void addAllQueries(List<String> queries) {
-        m_queries.addAll(queries);
+        if (m_querySink == null) {
+            m_queries.addAll(queries);
+            return;
+        }
+        for (String query : queries) {
+            m_querySink.accept(query);
+        }
     }
 
     @Override
@@ -55,8 +55,11 @@ public class jPctCubeExpt0 {
     public jPctCubeExpt0(Config config, int dimensionCount) throws ClassNotFoundException, SQLException, FileNotFoundException {
         m_dimensionCount = dimensionCount;
         // Build the fact tables.
-        m_factTableOriginalBuilder = new FactTableBuilder(FACT_TABLE_ORIGINAL + m_dimensionCount, m_dimensionCount);
-        m_factTableDeltaBuilder = new FactTableBuilder(FACT_TABLE_DELTA + m_dimensionCount, m_dimensionCount);
+        m_factTableOriginalBuilder = new FactTableBuilder(FACT_TABLE_ORIGINAL + m_dimensionCount, m_dimensionCount)
+                .setGenerateInDatabase(config.generatesDataInDatabase());
+        m_factTableDeltaBuilder = new FactTableBuilder(FACT_TABLE_DELTA + m_dimensionCount, m_dimensionCount)
+                .setGenerateInDatabase(config.generatesDataInDatabase())
+                .setSeed(1); // the delta rows should not repeat the original rows.
         m_factTableFinalBuilder = new FactTableBuilder(FACT_TABLE_FINAL + m_dimensionCount, m_dimensionCount);
         m_factTableOriginal = m_factTableOriginalBuilder.getTable();
         m_factTableDelta = m_factTableDeltaBuilder.getTable();
@@ -105,8 +108,7 @@ public class jPctCubeExpt0 {
         printLog("Start building the orignal cube.");
         long startTime = System.currentTimeMillis();
 
-        m_cubeOriginal.evaluate();
-        m_connection.executeQuerySet(m_cubeOriginal);
+        m_connection.executeQuerySet(m_cubeOriginal, m_cubeOriginal::evaluate);
 
         long endTime = System.currentTimeMillis();
         double duration = (endTime - startTime) / 1000.0;
@@ -120,8 +122,7 @@ public class jPctCubeExpt0 {
         printLog("Build the incremental cube.");
         long startTime = System.currentTimeMillis();
 
-        m_cubeOriginal.evaluateIncrementallyOn(m_factTableDelta);
-        m_connection.executeQuerySet(m_cubeOriginal);
+        m_connection.executeQuerySet(m_cubeOriginal, () -> m_cubeOriginal.evaluateIncrementallyOn(m_factTableDelta));
 
         long endTime = System.currentTimeMillis();
         double duration = (endTime - startTime) / 1000.0;
@@ -136,8 +137,7 @@ public class jPctCubeExpt0 {
         printLog("Build the final cube from scratch");
         long startTime = System.currentTimeMillis();
 
-        m_cubeFinal.evaluate();
-        m_connection.executeQuerySet(m_cubeFinal);
+        m_connection.executeQuerySet(m_cubeFinal, m_cubeFinal::evaluate);
 
         long endTime = System.currentTimeMillis();
         double duration = (endTime - startTime) / 1000.0;
@@ -151,8 +151,7 @@ public class jPctCubeExpt0 {
         printLog("Build the orignal cube with topk=2");
         long startTime = System.currentTimeMillis();
 
-        m_cubeTopK.evaluate();
-        m_connection.executeQuerySet(m_cubeTopK);
+        m_connection.executeQuerySet(m_cubeTopK, m_cubeTopK::evaluate);
 
         long endTime = System.currentTimeMillis();
         double duration = (endTime - startTime) / 1000.0;
@@ -52,7 +52,8 @@ public class jPctCubeExpt1 {
     public jPctCubeExpt1(Config config, int nullPercentage) throws ClassNotFoundException, SQLException, FileNotFoundException {
         m_nullPercentage = nullPercentage;
         // Build the fact tables.
-        m_factTableBuilder = new FactTableBuilder(FACT_TABLE_PREFIX + m_nullPercentage, DIMENSION_COUNT);
+        m_factTableBuilder = new FactTableBuilder(FACT_TABLE_PREFIX + m_nullPercentage, DIMENSION_COUNT)
+                .setGenerateInDatabase(config.generatesDataInDatabase());
         m_factTable = m_factTableBuilder.getTable();
         // Add those tables to the program-maintained database catalog, so the query generator
         // can be aware of their existences.
@@ -92,8 +93,7 @@ public class jPctCubeExpt1 {
         printLog("Start building the cube.");
         long startTime = System.currentTimeMillis();
 
-        m_cube.evaluate();
-        m_connection.executeQuerySet(m_cube);
+        m_connection.executeQuerySet(m_cube, m_cube::evaluate);
 
         long endTime = System.currentTimeMillis();
         double duration = (endTime - startTime) / 1000.0;
@@ -51,7 +51,8 @@ public class jPctCubeExpt2 {
     public jPctCubeExpt2(Config config, int nullPercentage) throws ClassNotFoundException, SQLException, FileNotFoundException {
         m_dimensionCount = nullPercentage;
         // Build the fact tables.
-        m_factTableBuilder = new FactTableBuilder(FACT_TABLE_PREFIX + m_dimensionCount, m_dimensionCount);
+        m_factTableBuilder = new FactTableBuilder(FACT_TABLE_PREFIX + m_dimensionCount, m_dimensionCount)
+                .setGenerateInDatabase(config.generatesDataInDatabase());
         m_factTable = m_factTableBuilder.getTable();
         // Add those tables to the program-maintained database catalog, so the query generator
         // can be aware of their existences.
@@ -91,8 +92,7 @@ public class jPctCubeExpt2 {
         printLog("Start building the cube with thresdhold.");
         long startTime = System.currentTimeMillis();
 
-        m_cubeWithThreshold.evaluate();
-        m_connection.executeQuerySet(m_cubeWithThreshold);
+        m_connection.executeQuerySet(m_cubeWithThreshold, m_cubeWithThreshold::evaluate);
 
         long endTime = System.currentTimeMillis();
         double duration = (endTime - startTime) / 1000.0;
@@ -105,8 +105,7 @@ public class jPctCubeExpt2 {
         printLog("Start building the cube with top-k");
         long startTime = System.currentTimeMillis();
 
-        m_cubeWithTopK.evaluate();
-        m_connection.executeQuerySet(m_cubeWithTopK);
+        m_connection.executeQuerySet(m_cubeWithTopK, m_cubeWithTopK::evaluate);
 
         long endTime = System.currentTimeMillis();
         double duration = (endTime - startTime) / 1000.0;
@@ -59,8 +59,11 @@ public class jPctCubeExpt3 {
     public jPctCubeExpt3(Config config, int cardinality) throws ClassNotFoundException, SQLException, FileNotFoundException {
         m_cardinality = cardinality;
         // Build the fact tables.
-        m_factTableOriginalBuilder = new FactTableBuilder(FACT_TABLE_ORIGINAL + m_cardinality, DIMENSION_COUNT);
-        m_factTableDeltaBuilder = new FactTableBuilder(FACT_TABLE_DELTA + m_cardinality, DIMENSION_COUNT);
+        m_factTableOriginalBuilder = new FactTableBuilder(FACT_TABLE_ORIGINAL + m_cardinality, DIMENSION_COUNT)
+                .setGenerateInDatabase(config.generatesDataInDatabase());
+        m_factTableDeltaBuilder = new FactTableBuilder(FACT_TABLE_DELTA + m_cardinality, DIMENSION_COUNT)
+                .setGenerateInDatabase(config.generatesDataInDatabase())
+                .setSeed(1); // the delta rows should not repeat the original rows.
         m_factTableFinalBuilder = new FactTableBuilder(FACT_TABLE_FINAL + m_cardinality, DIMENSION_COUNT);
         m_factTableOriginal = m_factTableOriginalBuilder.getTable();
         m_factTableDelta = m_factTableDeltaBuilder.getTable();
@@ -39,7 +39,8 @@ public class jPctCubeExpt4 {
 
     public jPctCubeExpt4(Config config) throws ClassNotFoundException, SQLException, FileNotFoundException {
         // Build the fact tables.
-        m_factTableBuilder = new FactTableBuilder(FACT_TABLE, DIMENSION_COUNT);
+        m_factTableBuilder = new FactTableBuilder(FACT_TABLE, DIMENSION_COUNT)
+                .setGenerateInDatabase(config.generatesDataInDatabase());
         m_findvTableBuilder = new FactTableBuilder("Findv", DIMENSION_COUNT);
         m_ftotalTableBuilder = new FactTableBuilder("Ftotal", DIMENSION_COUNT);
         m_pctTableBuilder = new FactTableBuilder("pct", DIMENSION_COUNT);
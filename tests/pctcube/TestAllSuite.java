@@ -6,6 +6,7 @@ import org.junit.runners.Suite.SuiteClasses;
 
 import pctcube.database.TestColumn;
 import pctcube.database.TestDatabase;
+import pctcube.database.TestParallelQuerySetExecutor;
 import pctcube.database.TestTable;
 import pctcube.utils.TestArgumentParser;
 import pctcube.utils.TestCombinationGenerator;
@@ -15,9 +16,11 @@ import pctcube.utils.TestPermutationGenerator;
 
 @RunWith(Suite.class)
 @SuiteClasses({ TestPercentageCube.class,
+                TestFactTableBuilder.class,
                 TestArgumentParser.class,
                 TestColumn.class,
                 TestDatabase.class,
+                TestParallelQuerySetExecutor.class,
                 TestTable.class,
                 TestPermutationGenerator.class,
                 TestCombinationGenerator.class})
@@ -0,0 +1,30 @@
+package pctcube;
+
+import static org.junit.Assert.assertEquals;
+import static org.junit.Assert.fail;
+
+import org.junit.Test;
+
+public class TestFactTableBuilder {
+
+    @Test
+    public void testCopyQuery() {
+        FactTableBuilder builder = new FactTableBuilder("F", 3);
+        assertEquals("COPY F WITH SOURCE fact_generator(rows=1000, cardinalities='2,5,10', nullpct=5, seed=0)"
+                + " DELIMITER '|' NULL '' DIRECT;",
+                builder.getCopyQuery(1000, 5, new int[] {2, 5, 10}));
+
+        builder.setSeed(42).setSkew(1.5);
+        assertEquals("COPY F WITH SOURCE fact_generator(rows=1000, cardinalities='2,5,10', nullpct=0, seed=42, skew=1.5)"
+                + " DELIMITER '|' NULL '' DIRECT;",
+                builder.getCopyQuery(1000, 0, new int[] {2, 5, 10}));
+
+        try {
+            builder.getCopyQuery(1000, 0, new int[] {2, 5});
+            fail("Expected an exception, but nothing happened.");
+        }
+        catch (RuntimeException ex) {
+            assertEquals("Not enough cardinalities are specified.", ex.getMessage());
+        }
+    }
+}
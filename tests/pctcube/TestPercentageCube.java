@@ -1,11 +1,15 @@
 package pctcube;
 
 import static org.junit.Assert.assertEquals;
+import static org.junit.Assert.assertFalse;
 import static org.junit.Assert.assertTrue;
 import static org.junit.Assert.fail;
 
 import java.io.FileNotFoundException;
 import java.sql.SQLException;
+import java.util.ArrayList;
+import java.util.Arrays;
+import java.util.List;
 
 import org.junit.Test;
 
@@ -74,6 +78,11 @@ public class TestPercentageCube {
                 String.format(Errors.INVALID_PERCENTAGE_CUBE_ARGS.getMessage(), "measure"));
         verifyCubeInstantiationFails("table=T ;dimensions=col1,col2,col3; measure=abc;",
                 String.format(Errors.INVALID_PERCENTAGE_CUBE_ARGS.getMessage(), "measure"));
+        // cardinalities
+        verifyCubeInstantiationFails("table=T ;dimensions=col1,col2,col3; measure=measure; cardinalities=10,20;",
+                String.format(Errors.INVALID_PERCENTAGE_CUBE_ARGS.getMessage(), "cardinalities"));
+        verifyCubeInstantiationFails("table=T ;dimensions=col1,col2,col3; measure=measure; cardinalities=10,x,5;",
+                String.format(Errors.INVALID_PERCENTAGE_CUBE_ARGS.getMessage(), "cardinalities"));
 
         // need to test more arguments
     }
@@ -88,7 +97,7 @@ public class TestPercentageCube {
         expectedPctCubeTable.addColumn(m_col1);
         expectedPctCubeTable.addColumn(m_col2);
         expectedPctCubeTable.addColumn(m_col3);
-        expectedPctCubeTable.addColumn(new Column("measure%", DataType.FLOAT).setNullable(false));
+        expectedPctCubeTable.addColumn(new Column("measure%", DataType.FLOAT));
         assertEquals(expectedPctCubeTable.toString(),
                 PercentageCubeTableFactory.getTable(cube).toString());
     }
@@ -107,11 +116,624 @@ public class TestPercentageCube {
                              "    col1 INTEGER,\n" +
                              "    col2 VARCHAR(80),\n" +
                              "    col3 VARCHAR(80),\n" +
-                             "    \"measure%\" FLOAT NOT NULL\n" +
+                             "    \"measure%\" FLOAT\n" +
                              ");\n";
         assertEquals(expectedDDL, createStatementGen.toString());
     }
 
+    @Test
+    public void testNullPercentages() {
+        // A group of only NULL measures has a NULL sum, a zero total has no percentage: both give a NULL
+        // percentage, in the SQL path and in the PCT_OF_TOTAL and PERCENTAGE_CUBE UDxs alike.
+        PercentageCube cube = new PercentageCube(
+                m_database, new String[]{"table=T ;dimensions=col1,col2; measure=measure;"});
+        assertTrue(PercentageCubeTableFactory.getTable(cube).getColumnByName("measure%").isNullable());
+        cube.evaluate();
+        String queries = cube.toString();
+        assertTrue(queries.contains("b.measure / NULLIF(a.measure, 0) AS measure FROM\n"));
+        assertFalse(queries.contains("b.measure / a.measure"));
+    }
+
+    @Test
+    public void testFusedUDF() {
+        PercentageCube cube = new PercentageCube(m_database,
+                new String[]{"table=T ;dimensions=col1,col2,col3; measure=measure; udf=fused;"});
+        assertTrue(cube.usesUDF());
+        assertTrue(cube.usesFusedUDF());
+        cube.evaluate();
+        String queries = cube.toString();
+        assertTrue(queries.contains("CUBE_MEASURE(measure) AS cube_measure"));
+        assertTrue(queries.contains("GROUP BY CUBE(col1, col2, col3)) fused;"));
+        assertFalse(queries.contains("COUNT(*)"));
+    }
+
+    @Test
+    public void testExactUDF() {
+        PercentageCube cube = new PercentageCube(m_database,
+                new String[]{"table=T ;dimensions=col1,col2; measure=measure; udf=exact;"});
+        assertTrue(cube.usesUDF());
+        assertTrue(cube.usesExactUDF());
+        assertFalse(cube.usesFusedUDF());
+        cube.evaluate();
+        assertTrue(cube.toString().contains(
+                "SELECT col1, col2, GROUPING_ID(col1, col2), COUNT(*), SUMNULL_EXACT(measure)\n"));
+
+        Table delta = new Table("T_delta");
+        delta.addColumn(new Column(m_col1));
+        delta.addColumn(new Column(m_col2));
+        delta.addColumn(new Column(m_measure));
+        cube.evaluateIncrementallyOn(delta);
+        assertTrue(cube.toString().contains("WHEN MATCHED THEN UPDATE SET cnt = o.cnt + d.cnt, " +
+                                            "measure = o.measure + d.measure\n"));
+    }
+
+    @Test
+    public void testDecimalMeasure() {
+        Database database = new Database();
+        Table table = new Table("F");
+        table.addColumn(new Column("d", DataType.VARCHAR));
+        table.addColumn(new Column("amount", DataType.DECIMAL, 18, 2));
+        database.addTable(table);
+        PercentageCube cube = new PercentageCube(database,
+                new String[]{"table=F ;dimensions=d; measure=amount; udf=true;"});
+        cube.evaluate();
+        // The sums get 19 more digits of precision, the scale does not change.
+        assertTrue(cube.toString().contains("    amount DECIMAL(37,2)\n"));
+        assertTrue(cube.toString().contains("SELECT d, GROUPING_ID(d), COUNT(*), SUMNULL(amount)\n"));
+    }
+
+    @Test
+    public void testMultipleMeasures() {
+        Database database = new Database();
+        Table table = new Table("F");
+        table.addColumn(new Column("d1", DataType.VARCHAR));
+        table.addColumn(new Column("d2", DataType.VARCHAR));
+        table.addColumn(new Column("revenue", DataType.FLOAT));
+        table.addColumn(new Column("quantity", DataType.FLOAT));
+        database.addTable(table);
+        PercentageCube cube = new PercentageCube(database,
+                new String[]{"table=F ;dimensions=d1,d2; measure=revenue,quantity; topk=3;"});
+        assertEquals(2, cube.getMeasures().size());
+        cube.evaluate();
+        String queries = cube.toString();
+        // One pass over the fact table computes the sums of both measures.
+        assertTrue(queries.contains("SELECT d1, d2, GROUPING_ID(d1, d2), COUNT(*), SUM(revenue), SUM(quantity)\n"));
+        assertTrue(queries.contains("    \"revenue%\" FLOAT,\n    \"quantity%\" FLOAT\n"));
+        assertTrue(queries.contains("b.revenue / NULLIF(a.revenue, 0) AS revenue, b.quantity / NULLIF(a.quantity, 0) AS quantity FROM\n"));
+        assertTrue(queries.contains("cnt, revenue, quantity FROM olap_cube"));
+        // The top k groups are ranked by the first measure.
+        assertTrue(queries.contains("ORDER BY \"revenue%\" DESC NULLS LAST) AS topk_rank\n"));
+
+        verifyCubeInstantiationFails("table=T ;dimensions=col1,col2,col3; measure=measure,measure;",
+                String.format(Errors.INVALID_PERCENTAGE_CUBE_ARGS.getMessage(), "measure"));
+        verifyCubeInstantiationFails("table=T ;dimensions=col1,col2,col3; measure=measure,abc;",
+                String.format(Errors.INVALID_PERCENTAGE_CUBE_ARGS.getMessage(), "measure"));
+    }
+
+    @Test
+    public void testCuboidIds() {
+        assertEquals(0, OLAPCubeTableFactory.getCuboidId(Arrays.asList(1, 1, 1)));
+        assertEquals(5, OLAPCubeTableFactory.getCuboidId(Arrays.asList(0, 1, 0)));
+        assertEquals(7, OLAPCubeTableFactory.getCuboidId(Arrays.asList(0, 0, 0)));
+
+        PercentageCube cube = new PercentageCube(m_database,
+                new String[]{"table=T ;dimensions=col1,col2; measure=measure;"});
+        cube.evaluate();
+        String queries = cube.toString();
+        assertTrue(queries.contains("    cuboid_id INTEGER NOT NULL,\n" +
+                                    "    cnt INTEGER NOT NULL,\n" +
+                                    "    measure FLOAT\n" +
+                                    ") PARTITION BY cuboid_id;"));
+        // Both sides of the join read one cuboid partition each.
+        assertTrue(queries.contains("denominator AS (SELECT col2, cnt, measure FROM olap_cube WHERE cuboid_id = 2)\n"));
+        assertTrue(queries.contains("denominator a JOIN\n" +
+                                    "        (SELECT col2, col1, cnt, measure FROM olap_cube WHERE cuboid_id = 0) b ON\n" +
+                                    "        a.col2 <=> b.col2"));
+        assertFalse(queries.contains("IS NULL"));
+
+        // The delta is merged in place, per cuboid.
+        Table delta = new Table("T_delta");
+        delta.addColumn(new Column(m_col1));
+        delta.addColumn(new Column(m_col2));
+        delta.addColumn(new Column(m_measure));
+        cube.evaluateIncrementallyOn(delta);
+        queries = cube.toString();
+        assertTrue(queries.contains(
+                "MERGE INTO olap_cube o USING olap_cube_delta d\n" +
+                "    ON o.cuboid_id = d.cuboid_id AND o.col1 <=> d.col1 AND o.col2 <=> d.col2\n" +
+                "    WHEN MATCHED THEN UPDATE SET cnt = o.cnt + d.cnt, " +
+                "measure = COALESCE(o.measure + d.measure, o.measure, d.measure)\n" +
+                "    WHEN NOT MATCHED THEN INSERT (col1, col2, cuboid_id, cnt, measure) " +
+                "VALUES (d.col1, d.col2, d.cuboid_id, d.cnt, d.measure);"));
+        assertTrue(queries.contains("DROP TABLE olap_cube_delta CASCADE;"));
+        assertFalse(queries.contains("INTERMEDIATE_TEMP"));
+    }
+
+    @Test
+    public void testIncrementalTouchedTotals() {
+        PercentageCube cube = new PercentageCube(m_database,
+                new String[]{"table=T ;dimensions=col1,col2; measure=measure;"});
+        cube.evaluate();
+        Table delta = new Table("T_delta");
+        delta.addColumn(new Column(m_col1));
+        delta.addColumn(new Column(m_col2));
+        delta.addColumn(new Column(m_measure));
+        cube.evaluateIncrementallyOn(delta);
+        List<String> queries = cube.getQueries();
+        // pct_cube is kept, the rows of the totals in the delta are deleted and reassembled.
+        assertFalse(cube.toString().contains("CREATE TABLE pct_cube"));
+        assertTrue(queries.contains("DELETE FROM pct_cube WHERE \"total by\" IN ('');"));
+        assertTrue(queries.contains("DELETE FROM pct_cube WHERE \"total by\" IN ('col2') AND\n" +
+                "    EXISTS (SELECT 1 FROM olap_cube_delta d WHERE d.cuboid_id = 2 AND d.col2 <=> pct_cube.col2);"));
+        assertTrue(cube.toString().contains("denominator AS (SELECT col2, cnt, measure FROM olap_cube WHERE " +
+                "cuboid_id = 2 AND EXISTS (SELECT 1 FROM olap_cube_delta d " +
+                "WHERE d.cuboid_id = 2 AND d.col2 <=> olap_cube.col2))\n"));
+        // The delta OLAP cube is dropped once the touched totals are reassembled.
+        assertEquals("DROP TABLE olap_cube_delta CASCADE;", queries.get(queries.size() - 1));
+    }
+
+    @Test
+    public void testRetractions() {
+        PercentageCube cube = new PercentageCube(m_database,
+                new String[]{"table=T ;dimensions=col1,col2; measure=measure; udf=true; incremental=true;"});
+        cube.evaluate();
+        String queries = cube.toString();
+        // The sums skip the NULLs, the NULLs are counted apart.
+        assertTrue(queries.contains("    measure FLOAT,\n    measure_nulls INTEGER NOT NULL\n"));
+        assertTrue(queries.contains("SELECT col1, col2, GROUPING_ID(col1, col2), COUNT(*), " +
+                                    "SUMNULL(COALESCE(measure, 0)), COUNT(*) - COUNT(measure)\n"));
+        assertTrue(queries.contains("denominator AS (SELECT col2, cnt, " +
+                                    "CASE WHEN measure_nulls = 0 THEN measure END AS measure FROM olap_cube"));
+
+        Table delta = new Table("T_delta");
+        delta.addColumn(new Column(m_col1));
+        delta.addColumn(new Column(m_col2));
+        delta.addColumn(new Column(m_measure));
+        delta.addColumn(new Column("sign", DataType.INTEGER));
+        cube.evaluateIncrementallyOn(delta, "sign");
+        queries = cube.toString();
+        assertTrue(queries.contains("SELECT col1, col2, GROUPING_ID(col1, col2), SUM(sign), " +
+                                    "SUMNULL(COALESCE(measure, 0) * sign), " +
+                                    "SUM(CASE WHEN measure IS NULL THEN sign ELSE 0 END)\n"));
+        assertTrue(queries.contains("WHEN MATCHED THEN UPDATE SET cnt = o.cnt + d.cnt, " +
+                                    "measure = o.measure + d.measure, " +
+                                    "measure_nulls = o.measure_nulls + d.measure_nulls\n"));
+        // The groups left with no fact are dropped.
+        assertTrue(queries.contains("DELETE FROM olap_cube WHERE cnt = 0 AND\n" +
+                                    "    EXISTS (SELECT 1 FROM olap_cube_delta d WHERE d.cuboid_id = olap_cube.cuboid_id " +
+                                    "AND d.col1 <=> olap_cube.col1 AND d.col2 <=> olap_cube.col2);"));
+
+        try {
+            new PercentageCube(m_database, new String[]{"table=T ;dimensions=col1,col2; measure=measure;"})
+                    .evaluateIncrementallyOn(delta, "sign");
+            fail("Expected an exception, but nothing happened.");
+        }
+        catch (IllegalArgumentException ex) {
+            assertEquals("Invalid sign column.", ex.getMessage());
+        }
+    }
+
+    @Test
+    public void testStreamedQueries() {
+        PercentageCube cube = new PercentageCube(m_database,
+                new String[]{"table=T ;dimensions=col1,col2,col3; measure=measure; topk=2;"});
+        cube.evaluate();
+        List<String> queries = new ArrayList<>(cube.getQueries());
+
+        // With a sink, the same queries come out in the same order, and none of them is kept.
+        List<String> streamedQueries = new ArrayList<>();
+        cube.setQuerySink(streamedQueries::add);
+        cube.evaluate();
+        assertEquals(queries, streamedQueries);
+        assertTrue(cube.getQueries().isEmpty());
+
+        cube.setQuerySink(null);
+        cube.evaluate();
+        assertEquals(queries, cube.getQueries());
+    }
+
+    @Test
+    public void testSharedDenominators() {
+        PercentageCube cube = new PercentageCube(m_database,
+                new String[]{"table=T ;dimensions=col1,col2,col3; measure=measure; rowcount=5;"});
+        cube.evaluate();
+        // One INSERT per total-by cuboid: the grand total, 3 single keys and 3 pairs of keys.
+        List<String> inserts = new ArrayList<>();
+        for (String query : cube.getQueries()) {
+            if (query.startsWith("INSERT INTO pct_cube\n")) {
+                inserts.add(query);
+            }
+        }
+        assertEquals(1 + 3 + 3, inserts.size());
+        // The grand total is the denominator of the 3 + 6 + 6 splits with no total-by key.
+        assertEquals("INSERT INTO pct_cube\n" +
+                     "    WITH /*+ENABLE_WITH_CLAUSE_MATERIALIZATION*/ denominator AS " +
+                     "(SELECT cnt, measure FROM olap_cube WHERE cnt > 5 AND cuboid_id = 7)\n" +
+                     "    SELECT '', 'col1,col2,col3', b.col1, b.col2, b.col3, b.measure / NULLIF(a.measure, 0) AS measure FROM\n" +
+                     "        denominator a JOIN\n" +
+                     "        (SELECT col1, col2, col3, cnt, measure FROM olap_cube WHERE cnt > 5 AND cuboid_id = 0) b ON\n" +
+                     "        1 = 1 UNION ALL\n",
+                     inserts.get(0).substring(0, inserts.get(0).indexOf("UNION ALL\n") + 10));
+        assertEquals(15, inserts.get(0).split("UNION ALL").length);
+        // Both orders of a pair of total-by keys share its denominator, cuboid 4 is (col2, col3).
+        String pairInsert = inserts.get(3);
+        assertTrue(pairInsert.contains("denominator AS (SELECT col2, col3, cnt, measure FROM olap_cube " +
+                                       "WHERE cnt > 5 AND cuboid_id = 4)\n"));
+        assertTrue(pairInsert.contains("SELECT 'col2,col3', 'col1'"));
+        assertTrue(pairInsert.contains("SELECT 'col3,col2', 'col1'"));
+    }
+
+    @Test
+    public void testTopKPushdown() {
+        PercentageCube cube = new PercentageCube(m_database,
+                new String[]{"table=T ;dimensions=col1,col2; measure=measure; topk=2; topkpushdown=true;"});
+        assertTrue(cube.isTopKPushedDown());
+        cube.evaluate();
+        String queries = cube.toString();
+        // The full cube is never written.
+        assertEquals("pct_cube_topk", cube.getPercentageCubeTable().getTableName());
+        assertFalse(queries.contains("CREATE TABLE pct_cube ("));
+        assertFalse(queries.contains("INSERT INTO pct_cube\n"));
+        assertTrue(queries.contains(
+                "SELECT \"total by\", \"break down by\", col1, col2, \"measure%\" FROM\n" +
+                "        (SELECT 'col2' AS \"total by\", 'col1' AS \"break down by\", b.col1 AS col1, b.col2 AS col2, " +
+                "b.measure / NULLIF(a.measure, 0) AS \"measure%\",\n" +
+                "            ROW_NUMBER() OVER (PARTITION BY b.col2 ORDER BY b.measure / NULLIF(a.measure, 0) DESC NULLS LAST) AS topk_rank FROM\n" +
+                "            denominator a JOIN\n" +
+                "            (SELECT col2, col1, cnt, measure FROM olap_cube WHERE cuboid_id = 0) b ON\n" +
+                "            a.col2 <=> b.col2) ranked\n" +
+                "        WHERE topk_rank <= 2"));
+        assertTrue(queries.contains("ROW_NUMBER() OVER (ORDER BY b.measure / NULLIF(a.measure, 0) DESC NULLS LAST) AS topk_rank FROM\n"));
+
+        // The OLAP method cannot rank inside PCT_OF_TOTAL(), it filters the full cube afterwards.
+        cube = new PercentageCube(m_database,
+                new String[]{"table=T ;dimensions=col1,col2; measure=measure; topk=2; topkpushdown=true; method=olap;"});
+        assertFalse(cube.isTopKPushedDown());
+        cube.evaluate();
+        assertTrue(cube.toString().contains("INSERT INTO pct_cube_topk\n    SELECT "));
+    }
+
+    @Test
+    public void testTopKPathsAgree() {
+        // udf=false ranks with ROW_NUMBER(), udf=true with TOP_K(), both over the rows of every total.
+        PercentageCube cube = new PercentageCube(m_database,
+                new String[]{"table=T ;dimensions=col1,col2; measure=measure; topk=2;"});
+        cube.evaluate();
+        List<String> queries = cube.getQueries();
+        assertEquals("INSERT INTO pct_cube_topk\n" +
+                     "    SELECT \"total by\", \"break down by\", col1, col2, \"measure%\" FROM\n" +
+                     "        (SELECT \"total by\", \"break down by\", col1, col2, \"measure%\",\n" +
+                     "            ROW_NUMBER() OVER (PARTITION BY \"total by\",\n" +
+                     "                \"break down by\",\n" +
+                     "                CASE WHEN POSITION(',col1,' IN ',' || \"total by\" || ',') > 0 THEN col1 END,\n" +
+                     "                CASE WHEN POSITION(',col2,' IN ',' || \"total by\" || ',') > 0 THEN col2 END\n" +
+                     "                ORDER BY \"measure%\" DESC NULLS LAST) AS topk_rank\n" +
+                     "        FROM pct_cube) ranked\n" +
+                     "    WHERE topk_rank <= 2;",
+                     queries.get(queries.size() - 1));
+
+        PercentageCube udfCube = new PercentageCube(m_database,
+                new String[]{"table=T ;dimensions=col1,col2; measure=measure; udf=true; topk=2;"});
+        udfCube.evaluate();
+        List<String> udfQueries = udfCube.getQueries();
+        assertEquals(getPartitionKeys(queries.get(queries.size() - 1)),
+                     getPartitionKeys(udfQueries.get(udfQueries.size() - 1)));
+
+        // Pushed down, every split ranks the rows of each of its totals.
+        PercentageCube pushedCube = new PercentageCube(m_database,
+                new String[]{"table=T ;dimensions=col1,col2; measure=measure; topk=2; topkpushdown=true;"});
+        pushedCube.evaluate();
+        assertTrue(pushedCube.toString().contains("SELECT 'col2' AS \"total by\", 'col1' AS \"break down by\""));
+        assertTrue(pushedCube.toString().contains("ROW_NUMBER() OVER (PARTITION BY b.col2 ORDER BY"));
+    }
+
+    // The PARTITION BY keys of a top k query, with the whitespace between them dropped.
+    private static String getPartitionKeys(String query) {
+        int begin = query.indexOf("PARTITION BY ");
+        int end = query.indexOf(" END", query.lastIndexOf("CASE WHEN")) + 4;
+        return query.substring(begin, end).replaceAll("\\s*\\n\\s*", " ");
+    }
+
+    @Test
+    public void testOLAPMethod() {
+        PercentageCube cube = new PercentageCube(m_database,
+                new String[]{"table=T ;dimensions=col1,col2,col3; measure=measure; method=olap; rowcount=5;"});
+        cube.evaluate();
+        // DROP + CREATE pct_cube, then one query for every (total by, break down by) split of every permutation.
+        assertEquals(2 + 3 + 12 + 18, cube.getQueries().size());
+        String queries = cube.toString();
+        assertTrue(queries.contains(
+                "SELECT '', 'col1,col2,col3', p.col1, p.col2, p.col3, p.pct_of_total FROM\n" +
+                "        (SELECT PCT_OF_TOTAL(col1, col2, col3, measure USING PARAMETERS rowcount=5, sumnull=false)\n" +
+                "        OVER (ORDER BY col1, col2, col3) FROM T) p;"));
+        assertTrue(queries.contains("OVER (PARTITION BY col2 ORDER BY col3) FROM T) p;"));
+    }
+
+    @Test
+    public void testUDTFMethod() {
+        PercentageCube cube = new PercentageCube(m_database,
+                new String[]{"table=T ;dimensions=col1,col2,col3; measure=measure; method=udtf; udf=true;"});
+        cube.evaluate();
+        // DROP + CREATE pct_cube, then a single PERCENTAGE_CUBE() query.
+        assertEquals(3, cube.getQueries().size());
+        assertEquals("INSERT INTO pct_cube\n" +
+                     "    SELECT PERCENTAGE_CUBE(col1, col2, col3, measure USING PARAMETERS rowcount=0, sumnull=true)" +
+                     " OVER (PARTITION BEST)\n" +
+                     "    FROM T;",
+                     cube.getQueries().get(2));
+    }
+
+    @Test
+    public void testLatticeMethod() {
+        PercentageCube cube = new PercentageCube(m_database,
+                new String[]{"table=T ;dimensions=col1,col2; measure=measure; method=lattice; cardinalities=100,5;"});
+        cube.evaluate();
+        // DROP + CREATE pct_cube, DROP + CREATE + INSERT for each of the 4 cuboids,
+        // one query for every (total by, break down by) split, then DROP the 4 cuboid tables.
+        assertEquals(2 + 4 * 3 + 4 + 2 + 4, cube.getQueries().size());
+        String queries = cube.toString();
+        assertTrue(queries.contains("INSERT INTO TEMP_AGG_0_1\n" +
+                                    "    SELECT col1, col2, COUNT(*), SUM(measure)\n" +
+                                    "    FROM T\n" +
+                                    "    GROUP BY col1, col2;"));
+        // The grand total is rolled up from the smaller one of its two parents.
+        assertTrue(queries.contains("INSERT INTO TEMP_AGG\n" +
+                                    "    SELECT SUM(cnt), SUM(measure)\n" +
+                                    "    FROM TEMP_AGG_1;"));
+        assertTrue(queries.contains("SELECT 'col2', 'col1', b.col1, b.col2, b.measure / NULLIF(a.measure, 0) AS measure FROM\n" +
+                                    "        TEMP_AGG_1 a JOIN TEMP_AGG_0_1 b ON\n" +
+                                    "        a.col2 <=> b.col2;"));
+        assertTrue(queries.contains("DROP TABLE TEMP_AGG_0_1 CASCADE;"));
+        assertTrue(m_database.getTableByName("TEMP_AGG_0_1") == null);
+    }
+
+    @Test
+    public void testLatticeKeepsNullGroups() {
+        // A NULL col2 is a total of its own, and a NULL col1 a group of its own, in both methods: the lattice
+        // joins the same keys null-safely as the GROUPBY method, and leaves no group out.
+        PercentageCube lattice = new PercentageCube(m_database,
+                new String[]{"table=T ;dimensions=col1,col2; measure=measure; method=lattice; rowcount=2;"});
+        lattice.evaluate();
+        PercentageCube groupBy = new PercentageCube(m_database,
+                new String[]{"table=T ;dimensions=col1,col2; measure=measure; rowcount=2;"});
+        groupBy.evaluate();
+        for (PercentageCube cube : Arrays.asList(lattice, groupBy)) {
+            String queries = cube.toString();
+            assertTrue(queries.contains("SELECT 'col2', 'col1', b.col1, b.col2, b.measure / NULLIF(a.measure, 0)"));
+            assertTrue(queries.contains("a.col2 <=> b.col2"));
+            assertFalse(queries.contains("a.col2 = b.col2"));
+            assertFalse(queries.contains("IS NOT NULL"));
+        }
+        assertTrue(lattice.toString().contains("        TEMP_AGG_1 a JOIN TEMP_AGG_0_1 b ON\n" +
+                                               "        a.col2 <=> b.col2 WHERE a.cnt > 2 AND b.cnt > 2;"));
+    }
+
+    @Test
+    public void testDirectPruning() {
+        PercentageCube cube = new PercentageCube(m_database,
+                new String[]{"table=T ;dimensions=col1,col2; measure=measure; rowcount=5; pruning=direct;"});
+        cube.evaluate();
+        assertTrue(cube.toString().contains("    GROUP BY CUBE(col1, col2)\n    HAVING COUNT(*) > 5;"));
+
+        // Nothing to prune without a row count threshold.
+        cube = new PercentageCube(m_database,
+                new String[]{"table=T ;dimensions=col1,col2; measure=measure; pruning=direct;"});
+        cube.evaluate();
+        assertFalse(cube.toString().contains("HAVING"));
+    }
+
+    @Test
+    public void testCascadePruning() {
+        PercentageCube cube = new PercentageCube(m_database,
+                new String[]{"table=T ;dimensions=col1,col2; measure=measure; rowcount=5; pruning=cascade;"});
+        cube.evaluate();
+        String queries = cube.toString();
+        assertFalse(queries.contains("GROUP BY CUBE"));
+        // The cuboids are aggregated from the coarsest to the finest, the ones with no parent to filter with
+        // in a single pass.
+        assertTrue(queries.contains("INSERT INTO olap_cube\n" +
+                                    "    SELECT col1, col2, GROUPING_ID(col1, col2), COUNT(*), SUM(measure)\n" +
+                                    "    FROM T\n" +
+                                    "    GROUP BY GROUPING SETS((), (col1), (col2))\n" +
+                                    "    HAVING COUNT(*) > 5;"));
+        assertTrue(queries.contains("INSERT INTO olap_cube\n" +
+                                    "    SELECT col1, col2, 0, COUNT(*), SUM(measure)\n" +
+                                    "    FROM T f\n" +
+                                    "    WHERE EXISTS (SELECT 1 FROM olap_cube p WHERE p.cuboid_id = 2 AND p.col2 <=> f.col2) AND\n" +
+                                    "        EXISTS (SELECT 1 FROM olap_cube p WHERE p.cuboid_id = 1 AND p.col1 <=> f.col1)\n" +
+                                    "    GROUP BY col1, col2\n" +
+                                    "    HAVING COUNT(*) > 5;"));
+        assertTrue(queries.indexOf("GROUP BY GROUPING SETS") < queries.indexOf("GROUP BY col1, col2\n"));
+
+        // The delta would be merged into the groups left, and add up with nothing for the pruned ones.
+        Table delta = new Table("T_delta");
+        delta.addColumn(new Column(m_col1));
+        delta.addColumn(new Column(m_col2));
+        delta.addColumn(new Column(m_measure));
+        try {
+            cube.evaluateIncrementallyOn(delta);
+            fail("Expected an exception, but nothing happened.");
+        }
+        catch (IllegalArgumentException ex) {
+            assertEquals("A pruned cube cannot take a delta, it needs incremental=true.", ex.getMessage());
+        }
+        // An incremental cube keeps all of its groups to merge the deltas into.
+        cube = new PercentageCube(m_database, new String[]{"table=T ;dimensions=col1,col2; measure=measure; " +
+                                                           "rowcount=5; pruning=cascade; incremental=true;"});
+        assertEquals(PruningStrategy.NONE, cube.getPruningStrategy());
+        cube.evaluate();
+        assertTrue(cube.toString().contains("GROUP BY CUBE(col1, col2);"));
+        cube.evaluateIncrementallyOn(delta);
+    }
+
+    @Test
+    public void testCascadePruningKeepsNullGroups() {
+        // A NULL col2 is a group of its own in the cuboids of DIRECT pruning (GROUP BY CUBE ... HAVING),
+        // so CASCADE must not lose the fact rows with a NULL col2 in the finer cuboids.
+        PercentageCube direct = new PercentageCube(m_database,
+                new String[]{"table=T ;dimensions=col1,col2,col3; measure=measure; rowcount=5; pruning=direct;"});
+        direct.evaluate();
+        assertTrue(direct.toString().contains("GROUP BY CUBE(col1, col2, col3)\n    HAVING COUNT(*) > 5;"));
+
+        PercentageCube cascade = new PercentageCube(m_database,
+                new String[]{"table=T ;dimensions=col1,col2,col3; measure=measure; rowcount=5; pruning=cascade;"});
+        cascade.evaluate();
+        String queries = cascade.toString();
+        assertFalse(queries.contains(" IN (SELECT"));
+        // Every parent of (col1, col2, col3) is matched null-safely on all of its keys.
+        assertTrue(queries.contains("    WHERE EXISTS (SELECT 1 FROM olap_cube p WHERE p.cuboid_id = 4 " +
+                                    "AND p.col2 <=> f.col2 AND p.col3 <=> f.col3) AND\n" +
+                                    "        EXISTS (SELECT 1 FROM olap_cube p WHERE p.cuboid_id = 2 " +
+                                    "AND p.col1 <=> f.col1 AND p.col3 <=> f.col3) AND\n" +
+                                    "        EXISTS (SELECT 1 FROM olap_cube p WHERE p.cuboid_id = 1 " +
+                                    "AND p.col1 <=> f.col1 AND p.col2 <=> f.col2)\n" +
+                                    "    GROUP BY col1, col2, col3\n"));
+    }
+
+    @Test
+    public void testCanonicalSplits() {
+        PercentageCube cube = new PercentageCube(m_database,
+                new String[]{"table=T ;dimensions=col1,col2,col3; measure=measure; method=olap; canonical=true;"});
+        assertTrue(cube.isCanonical());
+        cube.evaluate();
+        // DROP + CREATE pct_cube, DROP + CREATE + INSERT pct_cube_labels, DROP + CREATE pct_cube_ordered,
+        // then one query for every (total-by set, break-down-by set) pair: 7 + 3 * 3 + 3.
+        assertEquals(2 + 3 + 2 + 7 + 9 + 3, cube.getQueries().size());
+        String queries = cube.toString();
+        assertTrue(queries.contains("SELECT 'col1,col3', 'col2', p.col1, p.col2, p.col3, p.pct_of_total FROM"));
+        assertFalse(queries.contains("SELECT 'col3,col1', 'col2', p.col1"));
+        // Every one of the 6 * 3 + 3 * 2 * 2 + 3 permuted labels maps to its canonical label.
+        String labels = cube.getQueries().get(4);
+        assertTrue(labels.startsWith("INSERT INTO pct_cube_labels\n"));
+        assertEquals(33, labels.split("SELECT ").length - 1);
+        assertTrue(labels.contains("SELECT 'col3,col1', 'col2', 'col1,col3', 'col2'"));
+        assertTrue(labels.contains("SELECT '', 'col3,col2,col1', '', 'col1,col2,col3'"));
+        assertEquals("CREATE VIEW pct_cube_ordered AS\n" +
+                     "    SELECT l.\"total by\", l.\"break down by\", c.col1, c.col2, c.col3, c.\"measure%\"\n" +
+                     "    FROM pct_cube c JOIN pct_cube_labels l ON\n" +
+                     "    c.\"total by\" = l.\"canonical total by\" AND c.\"break down by\" = l.\"canonical break down by\";",
+                     cube.getQueries().get(6));
+
+        List<Column> selection = new ArrayList<>();
+        selection.add(m_col1);
+        selection.add(m_col2);
+        selection.add(m_col3);
+        assertEquals(7, PercentageCubeSplit.getSplits(selection, true).size());
+        assertEquals(18, PercentageCubeSplit.getSplits(selection, false).size());
+    }
+
+    @Test
+    public void testCanonicalLabelBatches() {
+        Database database = new Database();
+        Table table = new Table("F");
+        for (int i = 1; i <= 5; i++) {
+            table.addColumn(new Column("d" + i, DataType.VARCHAR));
+        }
+        table.addColumn(new Column("measure", DataType.FLOAT));
+        database.addTable(table);
+        PercentageCube cube = new PercentageCube(database,
+                new String[]{"table=F ;dimensions=d1,d2,d3,d4,d5; measure=measure; method=olap; canonical=true;"});
+        cube.evaluate();
+        // The 5 * 1 + 10 * 2 * 2 + 10 * 3 * 6 + 5 * 4 * 24 + 5 * 120 permuted labels are split into batches.
+        List<Integer> batchSizes = new ArrayList<>();
+        for (String query : cube.getQueries()) {
+            if (query.startsWith("INSERT INTO pct_cube_labels\n")) {
+                batchSizes.add(query.split("SELECT ").length - 1);
+            }
+        }
+        assertEquals(Arrays.asList(PercentageCubeCreateAction.LABEL_BATCH_SIZE,
+                                   1305 - PercentageCubeCreateAction.LABEL_BATCH_SIZE), batchSizes);
+    }
+
+    @Test
+    public void testDenominatorBatches() {
+        Database database = new Database();
+        Table table = new Table("F");
+        for (int i = 1; i <= 5; i++) {
+            table.addColumn(new Column("d" + i, DataType.VARCHAR));
+        }
+        table.addColumn(new Column("measure", DataType.FLOAT));
+        database.addTable(table);
+        PercentageCube cube = new PercentageCube(database,
+                new String[]{"table=F ;dimensions=d1,d2,d3,d4,d5; measure=measure;"});
+        cube.evaluate();
+        // The 5 * 1 + 10 * 2 + 10 * 6 + 5 * 24 + 120 splits of the grand total are split into batches,
+        // each of them reads the denominator once.
+        List<Integer> batchSizes = new ArrayList<>();
+        for (String query : cube.getQueries()) {
+            if (query.contains("denominator AS (SELECT cnt, measure FROM olap_cube WHERE cuboid_id = 31)\n")) {
+                batchSizes.add(query.split(" UNION ALL\n").length);
+            }
+        }
+        int batchSize = PercentageCubeAssembler.DENOMINATOR_BATCH_SIZE;
+        assertEquals(Arrays.asList(batchSize, batchSize, batchSize, 325 - 3 * batchSize), batchSizes);
+    }
+
+    @Test
+    public void testTopKUDF() {
+        PercentageCube cube = new PercentageCube(m_database,
+                new String[]{"table=T ;dimensions=col1,col2; measure=measure; udf=true; topk=2;"});
+        cube.evaluate();
+        // A single query fills pct_cube_topk.
+        List<String> queries = cube.getQueries();
+        assertEquals("INSERT INTO pct_cube_topk\n" +
+                     "    SELECT TOP_K(\"total by\", \"break down by\", col1, col2, \"measure%\" USING PARAMETERS k=2)\n" +
+                     "    OVER (PARTITION BY \"total by\",\n" +
+                     "        \"break down by\",\n" +
+                     "        CASE WHEN POSITION(',col1,' IN ',' || \"total by\" || ',') > 0 THEN col1 END,\n" +
+                     "        CASE WHEN POSITION(',col2,' IN ',' || \"total by\" || ',') > 0 THEN col2 END)\n" +
+                     "    FROM pct_cube;",
+                     queries.get(queries.size() - 1));
+        for (int i = 0; i < queries.size() - 1; i++) {
+            assertFalse(queries.get(i).startsWith("INSERT INTO pct_cube_topk"));
+        }
+    }
+
+    @Test
+    public void testEncodedDimensions() {
+        PercentageCube cube = new PercentageCube(m_database,
+                new String[]{"table=T ;dimensions=col1,col2; measure=measure; encode=true;"});
+        assertTrue(cube.isEncoded());
+        assertEquals("T", cube.getSourceFactTable().getTableName());
+        assertEquals("T_encoded", cube.getFactTable().getTableName());
+        // Only the VARCHAR dimension is encoded.
+        assertEquals(DataType.INTEGER, cube.getDimensions().get(0).getDataType());
+        assertEquals(DataType.INTEGER, cube.getDimensions().get(1).getDataType());
+        assertTrue(PercentageCubeTableFactory.getTable(cube).toString().contains("    col2 INTEGER,\n"));
+
+        cube.evaluate();
+        String queries = cube.toString();
+        assertTrue(queries.contains("CREATE TABLE IF NOT EXISTS dict_col2 (\n" +
+                                    "    code INTEGER NOT NULL,\n" +
+                                    "    value VARCHAR(80) NOT NULL\n" +
+                                    ");"));
+        assertFalse(queries.contains("dict_col1"));
+        assertTrue(queries.contains("INSERT INTO dict_col2\n" +
+                                    "    SELECT DICT_ENCODE(code, value) OVER ()\n" +
+                                    "    FROM (SELECT code, value FROM dict_col2 UNION ALL\n" +
+                                    "        SELECT DISTINCT NULL, col2 FROM T WHERE col2 IS NOT NULL) d;"));
+        assertTrue(queries.contains("INSERT INTO T_encoded\n" +
+                                    "    SELECT f.col1, e1.code, f.measure\n" +
+                                    "    FROM T f\n" +
+                                    "        LEFT JOIN dict_col2 e1 ON f.col2 = e1.value;"));
+        assertTrue(queries.contains("FROM T_encoded\n    GROUP BY CUBE(col1, col2);"));
+        assertTrue(queries.contains("CREATE VIEW pct_cube_decoded AS\n" +
+                                    "    SELECT c.\"total by\", c.\"break down by\", c.col1, e1.value AS col2, c.\"measure%\"\n" +
+                                    "    FROM pct_cube c\n" +
+                                    "        LEFT JOIN dict_col2 e1 ON c.col2 = e1.code;"));
+
+        // The delta is checked against the source columns, and encoded with the same dictionaries.
+        Table delta = new Table("T_delta");
+        delta.addColumn(new Column(m_col1));
+        delta.addColumn(new Column(m_col2));
+        delta.addColumn(new Column(m_measure));
+        cube.evaluateIncrementallyOn(delta);
+        queries = cube.toString();
+        assertTrue(queries.contains("SELECT DISTINCT NULL, col2 FROM T_delta WHERE col2 IS NOT NULL) d;"));
+        assertTrue(queries.contains("INSERT INTO T_delta_encoded\n"));
+        assertTrue(queries.contains("FROM T_delta_encoded\n    GROUP BY CUBE(col1, col2);"));
+    }
+
     protected static final Database m_database = new Database();
     protected static final Table m_table = new Table("T");
     protected static final Column m_col1 = new Column("col1", DataType.INTEGER);
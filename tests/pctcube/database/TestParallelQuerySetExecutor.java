@@ -0,0 +1,256 @@
+package pctcube.database;
+
+import static org.junit.Assert.assertEquals;
+import static org.junit.Assert.assertFalse;
+import static org.junit.Assert.assertTrue;
+import static org.junit.Assert.fail;
+
+import java.lang.reflect.InvocationHandler;
+import java.lang.reflect.Proxy;
+import java.sql.Connection;
+import java.sql.SQLException;
+import java.sql.Statement;
+import java.util.ArrayList;
+import java.util.Arrays;
+import java.util.List;
+import java.util.Set;
+import java.util.concurrent.ConcurrentHashMap;
+import java.util.concurrent.CountDownLatch;
+import java.util.concurrent.TimeUnit;
+import java.util.concurrent.atomic.AtomicInteger;
+
+import org.junit.Test;
+
+import pctcube.PercentageCube;
+import pctcube.database.query.QueryDependencyGraph;
+import pctcube.database.query.QuerySet;
+
+public class TestParallelQuerySetExecutor {
+
+    // A JDBC stand-in: every statement records when it ran. The statements starting with the gated prefix wait
+    // until GATE_SIZE of them are running at once. A statement containing "SLOW" runs until it is cancelled, one
+    // containing "FAIL" throws once a SLOW statement is running. A cancelled statement throws.
+    private static class FakeDatabase {
+
+        FakeDatabase(String gatedPrefix) {
+            m_gatedPrefix = gatedPrefix;
+        }
+
+        Connection newConnection() {
+            InvocationHandler connectionHandler = (proxy, method, args) -> {
+                if (method.getName().equals("createStatement")) {
+                    return newStatement();
+                }
+                return null;
+            };
+            return (Connection) Proxy.newProxyInstance(Connection.class.getClassLoader(),
+                    new Class<?>[] {Connection.class}, connectionHandler);
+        }
+
+        private Statement newStatement() {
+            Thread[] executingThread = new Thread[1];
+            boolean[] cancelled = new boolean[1];
+            InvocationHandler statementHandler = (proxy, method, args) -> {
+                switch (method.getName()) {
+                case "execute":
+                    String query = (String) args[0];
+                    synchronized (cancelled) {
+                        if (cancelled[0]) {
+                            throw new SQLException("Cancelled: " + query);
+                        }
+                        executingThread[0] = Thread.currentThread();
+                    }
+                    int running = m_running.incrementAndGet();
+                    m_maxRunning.accumulateAndGet(running, Math::max);
+                    m_started.put(query, System.nanoTime());
+                    m_firstStarted.countDown();
+                    try {
+                        if (m_gatedPrefix != null && query.startsWith(m_gatedPrefix)) {
+                            m_gate.countDown();
+                            // Only a hang guard, the gate opens as soon as enough statements run at once.
+                            if (! m_gate.await(HANG_GUARD_SECONDS, TimeUnit.SECONDS)) {
+                                throw new SQLException("Not enough statements in flight: " + query);
+                            }
+                        }
+                        if (query.contains("SLOW")) {
+                            m_slowStarted.countDown();
+                            Thread.sleep(TimeUnit.SECONDS.toMillis(HANG_GUARD_SECONDS));
+                        }
+                        if (query.contains("FAIL")) {
+                            m_slowStarted.await(HANG_GUARD_SECONDS, TimeUnit.SECONDS);
+                            throw new SQLException("Failed: " + query);
+                        }
+                    }
+                    catch (InterruptedException e) {
+                        m_cancelled.add(query);
+                        throw new SQLException("Cancelled: " + query);
+                    }
+                    finally {
+                        m_running.decrementAndGet();
+                    }
+                    m_finished.put(query, System.nanoTime());
+                    return false;
+                case "cancel":
+                    synchronized (cancelled) {
+                        cancelled[0] = true;
+                        if (executingThread[0] != null) {
+                            executingThread[0].interrupt();
+                        }
+                    }
+                    return null;
+                default:
+                    return null;
+                }
+            };
+            return (Statement) Proxy.newProxyInstance(Statement.class.getClassLoader(),
+                    new Class<?>[] {Statement.class}, statementHandler);
+        }
+
+        private final String m_gatedPrefix;
+        final CountDownLatch m_gate = new CountDownLatch(GATE_SIZE);
+        final CountDownLatch m_slowStarted = new CountDownLatch(1);
+        final CountDownLatch m_firstStarted = new CountDownLatch(1);
+        final Set<String> m_cancelled = ConcurrentHashMap.newKeySet();
+        final AtomicInteger m_running = new AtomicInteger();
+        final AtomicInteger m_maxRunning = new AtomicInteger();
+        final ConcurrentHashMap<String, Long> m_started = new ConcurrentHashMap<>();
+        final ConcurrentHashMap<String, Long> m_finished = new ConcurrentHashMap<>();
+    }
+
+    private static final int GATE_SIZE = 4;
+    private static final long HANG_GUARD_SECONDS = 60;
+
+    private static ParallelQuerySetExecutor newExecutor(FakeDatabase database, int parallelism) {
+        List<Connection> connections = new ArrayList<>();
+        for (int i = 0; i < parallelism; i++) {
+            connections.add(database.newConnection());
+        }
+        return new ParallelQuerySetExecutor(connections, null);
+    }
+
+    private static QuerySet newQuerySet(List<String> queries) {
+        QuerySet retval = new QuerySet() { };
+        retval.addAllQueries(queries);
+        return retval;
+    }
+
+    @Test
+    public void testDependencyGraph() {
+        QueryDependencyGraph graph = new QueryDependencyGraph(Arrays.asList(
+                "DROP TABLE IF EXISTS pct_cube CASCADE;",
+                "CREATE TABLE pct_cube (\n    a INTEGER\n);",
+                "INSERT INTO olap_cube\n    SELECT a, COUNT(*), SUM(m) FROM T GROUP BY CUBE(a);",
+                "INSERT INTO pct_cube SELECT a FROM olap_cube;",
+                "INSERT INTO pct_cube SELECT b FROM olap_cube;",
+                "INSERT INTO pct_cube_topk SELECT TOP_K(a USING PARAMETERS k=2) OVER () FROM pct_cube;",
+                "ANALYZE_STATISTICS('pct_cube');",
+                "INSERT INTO T VALUES (1);"));
+        assertEquals(Arrays.asList(), graph.getDependencies(0));
+        assertEquals(Arrays.asList(0), graph.getDependencies(1));
+        assertEquals(Arrays.asList(), graph.getDependencies(2));
+        // The two inserts into pct_cube do not depend on each other.
+        assertEquals(Arrays.asList(0, 1, 2), graph.getDependencies(3));
+        assertEquals(Arrays.asList(0, 1, 2), graph.getDependencies(4));
+        assertEquals(Arrays.asList(0, 1, 3, 4), graph.getDependencies(5));
+        // Unknown statements are barriers.
+        assertEquals(Arrays.asList(0, 1, 2, 3, 4, 5), graph.getDependencies(6));
+        assertEquals(Arrays.asList(2, 6), graph.getDependencies(7));
+    }
+
+    @Test
+    public void testExecutePercentageCube() throws SQLException {
+        Database db = new Database();
+        Table table = new Table("T");
+        table.addColumn(new Column("col1", DataType.INTEGER));
+        table.addColumn(new Column("col2", DataType.VARCHAR));
+        table.addColumn(new Column("col3", DataType.VARCHAR));
+        table.addColumn(new Column("measure", DataType.FLOAT));
+        db.addTable(table);
+        PercentageCube cube = new PercentageCube(db,
+                new String[] {"table=T ;dimensions=col1,col2,col3; measure=measure; topk=2;"});
+        cube.evaluate();
+
+        // Every assembler insert waits for GATE_SIZE of them to run at once.
+        FakeDatabase database = new FakeDatabase("INSERT INTO " + cube.getPercentageCubeTable().getTableName() + "\n");
+        ParallelQuerySetExecutor executor = newExecutor(database, GATE_SIZE);
+        executor.execute(cube);
+
+        List<String> queries = cube.getQueries();
+        assertEquals(queries.size(), database.m_finished.size());
+        assertEquals(queries.size(), executor.getStatementTimings().size());
+        // Every statement started after the statements it depends on had finished.
+        QueryDependencyGraph graph = new QueryDependencyGraph(queries);
+        for (int i = 0; i < queries.size(); i++) {
+            for (int dependency : graph.getDependencies(i)) {
+                assertTrue(database.m_finished.get(queries.get(dependency)) <= database.m_started.get(queries.get(i)));
+            }
+        }
+        // The assembler inserts ran at the same time.
+        assertEquals(0, database.m_gate.getCount());
+        assertEquals(GATE_SIZE, database.m_maxRunning.get());
+    }
+
+    @Test
+    public void testStreamedExecution() throws SQLException {
+        List<String> queries = new ArrayList<>();
+        queries.add("CREATE TABLE a (\n    x INTEGER\n);");
+        for (int i = 0; i < 100; i++) {
+            queries.add("INSERT INTO a SELECT " + i + " FROM b;");
+        }
+        queries.add("SELECT COUNT(*) FROM a;");
+
+        FakeDatabase database = new FakeDatabase(null);
+        ParallelQuerySetExecutor executor = newExecutor(database, 2);
+        QuerySet querySet = newQuerySet(new ArrayList<>());
+        boolean[] startedWhileGenerating = new boolean[1];
+        executor.execute(querySet, () -> {
+            querySet.addQuery(queries.get(0));
+            // The first statement runs before the others are generated.
+            try {
+                startedWhileGenerating[0] = database.m_firstStarted.await(HANG_GUARD_SECONDS, TimeUnit.SECONDS);
+            }
+            catch (InterruptedException e) {
+                throw new IllegalStateException(e);
+            }
+            for (String query : queries.subList(1, queries.size())) {
+                querySet.addQuery(query);
+            }
+        });
+        assertTrue(startedWhileGenerating[0]);
+        assertTrue(querySet.getQueries().isEmpty());
+        assertEquals(queries.size(), database.m_finished.size());
+        // The dependencies hold across the generated statements.
+        String last = queries.get(queries.size() - 1);
+        for (String query : queries.subList(0, queries.size() - 1)) {
+            assertTrue(database.m_finished.get(query) <= database.m_started.get(last));
+        }
+        assertTrue(database.m_finished.get(queries.get(0)) <= database.m_started.get(queries.get(1)));
+    }
+
+    @Test
+    public void testFailFast() throws SQLException {
+        List<String> queries = new ArrayList<>();
+        queries.add("CREATE TABLE a (\n    x INTEGER\n);");
+        queries.add("INSERT INTO a SELECT 1 FROM SLOW;");
+        queries.add("INSERT INTO a SELECT 1 FROM FAIL;");
+        for (int i = 0; i < 10; i++) {
+            queries.add("INSERT INTO a SELECT " + i + " FROM b;");
+        }
+        queries.add("SELECT COUNT(*) FROM a;");
+
+        FakeDatabase database = new FakeDatabase(null);
+        ParallelQuerySetExecutor executor = newExecutor(database, 2);
+        try {
+            executor.execute(newQuerySet(queries));
+            fail("Expected an exception, but nothing happened.");
+        }
+        catch (SQLException ex) {
+            assertTrue(ex.getMessage().contains("FAIL"));
+        }
+        // The slow statement was cancelled, and nothing was started after the failure.
+        assertTrue(database.m_cancelled.contains(queries.get(1)));
+        assertFalse(database.m_finished.containsKey(queries.get(1)));
+        assertFalse(database.m_started.containsKey(queries.get(queries.size() - 1)));
+        assertEquals(0, database.m_running.get());
+    }
+}